@@ -0,0 +1,136 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef AK_TOOLBOX_ATOMIC_COMPACT_OPTIONAL_HEADER_GUARD_
+#define AK_TOOLBOX_ATOMIC_COMPACT_OPTIONAL_HEADER_GUARD_
+
+#include "compact_optional.hpp"
+#include <atomic>
+
+namespace ak_toolbox {
+namespace compact_optional_ns {
+
+// An optional value that can be read and set concurrently without locks.
+// The policy's storage_type is held in a std::atomic, and the empty value
+// doubles as the "not yet published" state, so no separate flag is needed.
+template <typename EVP>
+class atomic_compact_optional
+{
+public:
+  typedef compact_optional<EVP> optional_type;
+  typedef typename EVP::value_type value_type;
+  typedef typename EVP::storage_type storage_type;
+
+#ifndef AK_TOOLBOX_NO_ARVANCED_CXX11
+  static_assert(std::is_trivially_copyable<storage_type>::value && std::is_trivially_copyable<value_type>::value,
+                "atomic_compact_optional requires a policy with trivially copyable value and storage");
+#endif // AK_TOOLBOX_NO_ARVANCED_CXX11
+#if defined __cpp_lib_atomic_is_always_lock_free
+  static_assert(std::atomic<storage_type>::is_always_lock_free, "atomic_compact_optional requires a lock-free storage_type");
+#else
+  // without is_always_lock_free, only accept what fits in a pointer: wider
+  // types (e.g., 16 bytes on x86-64) can silently fall back to a lock
+  static_assert(sizeof(storage_type) <= sizeof(void*), "storage_type is too big to be lock-free");
+#endif
+
+private:
+  std::atomic<storage_type> value_;
+
+  static optional_type make_optional(const storage_type& s)
+  {
+    return EVP::is_empty_value(s) ? optional_type() : optional_type(EVP::access_value(s));
+  }
+
+public:
+  atomic_compact_optional() AK_TOOLBOX_NOEXCEPT : value_(EVP::empty_value()) {}
+  explicit atomic_compact_optional(const optional_type& o) AK_TOOLBOX_NOEXCEPT : value_(o.unsafe_raw_value()) {}
+
+  atomic_compact_optional(const atomic_compact_optional&) = delete;
+  atomic_compact_optional& operator=(const atomic_compact_optional&) = delete;
+
+  bool is_lock_free() const AK_TOOLBOX_NOEXCEPT { return value_.is_lock_free(); }
+
+  optional_type load(std::memory_order order = std::memory_order_acquire) const AK_TOOLBOX_NOEXCEPT
+  {
+    return make_optional(value_.load(order));
+  }
+
+  bool has_value(std::memory_order order = std::memory_order_acquire) const AK_TOOLBOX_NOEXCEPT
+  {
+    return !EVP::is_empty_value(value_.load(order));
+  }
+
+  void store(const optional_type& o, std::memory_order order = std::memory_order_release) AK_TOOLBOX_NOEXCEPT
+  {
+    value_.store(o.unsafe_raw_value(), order);
+  }
+
+  optional_type exchange(const optional_type& o, std::memory_order order = std::memory_order_acq_rel) AK_TOOLBOX_NOEXCEPT
+  {
+    return make_optional(value_.exchange(o.unsafe_raw_value(), order));
+  }
+
+  // makes the object empty; returns the previous state
+  optional_type reset(std::memory_order order = std::memory_order_acq_rel) AK_TOOLBOX_NOEXCEPT
+  {
+    return make_optional(value_.exchange(EVP::empty_value(), order));
+  }
+
+  // Stores v only if the object is empty. Returns true if v was stored; otherwise
+  // `current` is set to the value published by someone else. If v is the empty
+  // value, it is reported in the policy's collision mode, nothing is stored, and
+  // `current` is set to the present state.
+  bool try_publish(const value_type& v, optional_type& current)
+  {
+    const storage_type desired = EVP::store_value(v);
+    if (EVP::is_empty_value(desired)) // publishing the empty value is not a publication
+    {
+      detail_::report_collision<EVP>();
+      current = load();
+      return false;
+    }
+    storage_type expected = value_.load(std::memory_order_acquire);
+    // loop, because is_empty_value may accept more than one bit pattern (e.g., NaNs)
+    while (EVP::is_empty_value(expected))
+    {
+      if (value_.compare_exchange_weak(expected, desired, std::memory_order_acq_rel, std::memory_order_acquire))
+        return true;
+    }
+    current = make_optional(expected);
+    return false;
+  }
+
+  bool try_publish(const value_type& v)
+  {
+    optional_type ignored;
+    return try_publish(v, ignored);
+  }
+
+  // Returns the published value; if there is none, publishes f() first.
+  // When threads race, f may be called by more than one of them, but all
+  // of them return the same value: the one that was published first. If f()
+  // returns the empty value, it is returned without being published.
+  template <typename F>
+  value_type get_or_compute(F f)
+  {
+    optional_type current = load();
+    if (current.has_value())
+      return current.value();
+
+    value_type v = f();
+    if (try_publish(v, current) || !current.has_value())
+      return v;
+    return current.value();
+  }
+};
+
+} // namespace compact_optional_ns
+
+using compact_optional_ns::atomic_compact_optional;
+
+} // namespace ak_toolbox
+
+#endif //AK_TOOLBOX_ATOMIC_COMPACT_OPTIONAL_HEADER_GUARD_
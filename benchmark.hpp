@@ -0,0 +1,115 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Helpers shared by the benchmark programs. Every measurement is printed as
+// one CSV line:
+//
+//   build,suite,case,n,ns_per_op,bytes_per_element,extra
+//
+// so that results from different compilers and optimization levels can be
+// collected and compared by scripts. `build` identifies the compiler, the
+// language version and whether optimization was on; define
+// AK_TOOLBOX_BENCHMARK_BUILD to a string literal to replace it (for
+// instance, with the exact compiler flags). The meaning of `extra` depends
+// on the case; it is documented in each benchmark program.
+
+#ifndef AK_TOOLBOX_BENCHMARK_HEADER_GUARD_
+#define AK_TOOLBOX_BENCHMARK_HEADER_GUARD_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+namespace bench {
+
+// prevents the optimizer from discarding a computed value
+template <typename T>
+inline void do_not_optimize(const T& v)
+{
+#if defined __GNUC__ || defined __clang__
+  asm volatile("" : : "g"(&v) : "memory");
+#else
+  static volatile const void* sink;
+  sink = &v;
+#endif
+}
+
+#define AK_TOOLBOX_BENCHMARK_STR2_(X) #X
+#define AK_TOOLBOX_BENCHMARK_STR_(X) AK_TOOLBOX_BENCHMARK_STR2_(X)
+
+inline const char* build_id()
+{
+#if defined AK_TOOLBOX_BENCHMARK_BUILD
+  return AK_TOOLBOX_BENCHMARK_BUILD;
+#else
+  return
+#  if defined __clang__
+    "clang-" __clang_version__
+#  elif defined __GNUC__
+    "gcc-" __VERSION__
+#  else
+    "unknown"
+#  endif
+    "/c++" AK_TOOLBOX_BENCHMARK_STR_(__cplusplus)
+#  if defined __OPTIMIZE__
+    "/opt"
+#  else
+    "/noopt"
+#  endif
+    ;
+#endif
+}
+
+inline void print_header()
+{
+  std::printf("build,suite,case,n,ns_per_op,bytes_per_element,extra\n");
+}
+
+inline void report(const char* suite, const char* name, std::size_t n, double ns_per_op,
+                   double bytes_per_element, double extra = 0.0)
+{
+  std::printf("%s,%s,%s,%lu,%.3f,%.2f,%.3f\n", build_id(), suite, name, static_cast<unsigned long>(n),
+              ns_per_op, bytes_per_element, extra);
+  std::fflush(stdout);
+}
+
+// runs f() repeatedly until at least min_ms elapsed, returns ns per call divided by ops_per_call
+template <typename F>
+double time_ns(F f, std::size_t ops_per_call, double min_ms = 50.0)
+{
+  typedef std::chrono::steady_clock clock;
+  std::size_t calls = 0;
+  clock::time_point start = clock::now();
+  double elapsed_ns = 0.0;
+  do
+  {
+    f();
+    ++calls;
+    elapsed_ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count());
+  }
+  while (elapsed_ns < min_ms * 1e6);
+  return elapsed_ns / double(calls) / double(ops_per_call ? ops_per_call : 1);
+}
+
+// a small, fast, deterministic generator
+struct xorshift64
+{
+  std::uint64_t s;
+  explicit xorshift64(std::uint64_t seed = 88172645463325252ull) : s(seed) {}
+  std::uint64_t operator()() { s ^= s << 13; s ^= s >> 7; s ^= s << 17; return s; }
+};
+
+// largest element count to benchmark: first command-line argument, if given
+inline std::size_t max_elements(int argc, char** argv, std::size_t dflt)
+{
+  return argc > 1 ? static_cast<std::size_t>(std::strtoull(argv[1], 0, 10)) : dflt;
+}
+
+} // namespace bench
+
+#endif //AK_TOOLBOX_BENCHMARK_HEADER_GUARD_
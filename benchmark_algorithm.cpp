@@ -0,0 +1,89 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Null-aware sorting and partitioning of nullable columns (one in four
+// elements empty, random values), against the standard algorithms with
+// has_value()-based comparators and predicates. Sizes go from 1K elements up
+// to max_elements (default 1M; pass 50000000 for the large case). The time
+// to restore the unsorted input is included. `extra` is unused.
+// Usage: benchmark_algorithm [max_elements]
+
+#include "compact_optional_algorithm.hpp"
+#include "benchmark.hpp"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace ak_toolbox;
+
+struct branching_empty_first
+{
+  template <typename O>
+  bool operator()(const O& l, const O& r) const
+  {
+    if (!r.has_value()) return false;
+    if (!l.has_value()) return true;
+    return l.value() < r.value();
+  }
+};
+
+struct is_engaged
+{
+  template <typename O>
+  bool operator()(const O& o) const { return o.has_value(); }
+};
+
+template <typename O, typename F>
+void bench_case(const char* suite, const char* name, const std::vector<O>& input, F f)
+{
+  const std::size_t n = input.size();
+  std::vector<O> v (n);
+  double ns = bench::time_ns([&] {
+    std::copy(input.begin(), input.end(), v.begin());
+    f(v);
+    bench::do_not_optimize(v[0]);
+  }, n, 20.0);
+  bench::report(suite, name, n, ns, double(sizeof(O)));
+}
+
+template <typename EVP, typename Gen>
+void bench_policy(const char* suite, std::size_t n, Gen gen)
+{
+  typedef compact_optional<EVP> opt_t;
+  typedef std::vector<opt_t> vec_t;
+  vec_t input;
+  input.reserve(n);
+  bench::xorshift64 rnd;
+  for (std::size_t i = 0; i != n; ++i)
+  {
+    std::uint64_t x = rnd();
+    input.push_back(x % 4 == 0 ? opt_t() : opt_t(gen(x)));
+  }
+
+  bench_case(suite, "std_sort_branching", input, [](vec_t& v) { std::sort(v.begin(), v.end(), branching_empty_first()); });
+  bench_case(suite, "std_sort_empty_first_less", input, [](vec_t& v) { std::sort(v.begin(), v.end(), empty_first_less()); });
+  bench_case(suite, "radix_sort", input, [](vec_t& v) { radix_sort(v.data(), v.data() + v.size(), empties_first); });
+
+  bench_case(suite, "std_partition", input, [](vec_t& v) { std::partition(v.begin(), v.end(), is_engaged()); });
+  bench_case(suite, "partition_engaged", input, [](vec_t& v) { partition_engaged(v.begin(), v.end()); });
+  bench_case(suite, "std_stable_partition", input, [](vec_t& v) { std::stable_partition(v.begin(), v.end(), is_engaged()); });
+  bench_case(suite, "stable_partition_engaged", input, [](vec_t& v) { stable_partition_engaged(v.begin(), v.end()); });
+}
+
+enum class Dir { N, E, S, W };
+
+int main(int argc, char** argv)
+{
+  std::size_t max_n = bench::max_elements(argc, argv, 1000000);
+  bench::print_header();
+  for (std::size_t n = 1000; n <= max_n; n *= 10)
+  {
+    bench_policy< evp_int<int, -1> >("evp_int<int>", n, [](std::uint64_t x) { return int(x >> 33); });
+    bench_policy< evp_int<std::int64_t, -1> >("evp_int<int64_t>", n, [](std::uint64_t x) { return std::int64_t(x >> 2); });
+    bench_policy< evp_fp_nan<double> >("evp_fp_nan<double>", n, [](std::uint64_t x) { return double(std::int64_t(x)) / 1e6; });
+    bench_policy< evp_enum<Dir, -1> >("evp_enum<Dir>", n, [](std::uint64_t x) { return Dir(x % 4); });
+  }
+}
@@ -0,0 +1,154 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// compact_optional_array_map (dense and paged) compared with
+// std::unordered_map and std::vector<std::optional> for int values keyed by
+// small integers. Suite "dense": keys 0..n-1, three in four present; cases
+// are lookups of random keys and a sum over all present values. Suite
+// "sparse": runs of 64 consecutive keys placed at random over a range of
+// 1000n, which only the paged map and the hash map can afford; half of the
+// lookups miss. bytes_per_element is the memory per present key; ns_per_op
+// is per lookup or per present value. Key counts go from 1K up to
+// max_elements (default 1M).
+// Usage: benchmark_array_map [max_elements]
+
+#include "compact_optional_array_map.hpp"
+#include "benchmark.hpp"
+#include <climits>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+using namespace ak_toolbox;
+
+typedef evp_int<int, INT_MIN> evp_t;
+typedef compact_optional_array_map<evp_t> dense_map;
+typedef compact_optional_array_map<evp_t, array_map_paged> paged_map;
+typedef std::unordered_map<std::size_t, int> hash_map;
+
+double hash_map_bytes(const hash_map& m)
+{
+  // node: key, value, next pointer, cached hash, plus one bucket pointer per bucket
+  return double(m.size() * (sizeof(hash_map::value_type) + 2 * sizeof(void*)) + m.bucket_count() * sizeof(void*));
+}
+
+template <typename Map>
+void bench_array_map(const char* suite, const char* name, const std::vector<std::size_t>& keys,
+                     const std::vector<std::size_t>& probes)
+{
+  Map m;
+  for (std::size_t k : keys)
+    m.set(k, int(k));
+  const double bytes = double(m.memory_usage()) / double(m.size());
+
+  double ns = bench::time_ns([&] {
+    long long sum = 0;
+    for (std::size_t k : probes)
+    {
+      compact_optional<evp_t> v = m[k];
+      if (v.has_value())
+        sum += v.value();
+    }
+    bench::do_not_optimize(sum);
+  }, probes.size());
+  bench::report(suite, (std::string(name) + "_find").c_str(), m.size(), ns, bytes);
+
+  ns = bench::time_ns([&] {
+    long long sum = 0;
+    m.for_each([&](std::size_t, int v) { sum += v; });
+    bench::do_not_optimize(sum);
+  }, m.size());
+  bench::report(suite, (std::string(name) + "_sum").c_str(), m.size(), ns, bytes);
+}
+
+void bench_hash_map(const char* suite, const std::vector<std::size_t>& keys, const std::vector<std::size_t>& probes)
+{
+  hash_map m;
+  for (std::size_t k : keys)
+    m[k] = int(k);
+  const double bytes = hash_map_bytes(m) / double(m.size());
+
+  double ns = bench::time_ns([&] {
+    long long sum = 0;
+    for (std::size_t k : probes)
+    {
+      hash_map::const_iterator it = m.find(k);
+      if (it != m.end())
+        sum += it->second;
+    }
+    bench::do_not_optimize(sum);
+  }, probes.size());
+  bench::report(suite, "std_unordered_map_find", m.size(), ns, bytes);
+
+  ns = bench::time_ns([&] {
+    long long sum = 0;
+    for (const hash_map::value_type& e : m)
+      sum += e.second;
+    bench::do_not_optimize(sum);
+  }, m.size());
+  bench::report(suite, "std_unordered_map_sum", m.size(), ns, bytes);
+}
+
+void bench_vector_optional(const char* suite, std::size_t range, const std::vector<std::size_t>& keys,
+                           const std::vector<std::size_t>& probes)
+{
+  std::vector< std::optional<int> > m (range);
+  for (std::size_t k : keys)
+    m[k] = int(k);
+  const double bytes = double(m.size() * sizeof(m[0])) / double(keys.size());
+
+  double ns = bench::time_ns([&] {
+    long long sum = 0;
+    for (std::size_t k : probes)
+      if (k < m.size() && m[k])
+        sum += *m[k];
+    bench::do_not_optimize(sum);
+  }, probes.size());
+  bench::report(suite, "vector_std_optional_find", keys.size(), ns, bytes);
+
+  ns = bench::time_ns([&] {
+    long long sum = 0;
+    for (const std::optional<int>& o : m)
+      if (o)
+        sum += *o;
+    bench::do_not_optimize(sum);
+  }, keys.size());
+  bench::report(suite, "vector_std_optional_sum", keys.size(), ns, bytes);
+}
+
+int main(int argc, char** argv)
+{
+  std::size_t max_n = bench::max_elements(argc, argv, 1000000);
+  bench::print_header();
+  for (std::size_t n = 1000; n <= max_n; n *= 10)
+  {
+    bench::xorshift64 rnd;
+    std::vector<std::size_t> keys, probes (n);
+    for (std::size_t k = 0; k != n; ++k)
+      if (rnd() % 4 != 0)
+        keys.push_back(k);
+    for (std::size_t& p : probes)
+      p = rnd() % n;
+
+    bench_array_map<dense_map>("dense", "array_map_dense", keys, probes);
+    bench_array_map<paged_map>("dense", "array_map_paged", keys, probes);
+    bench_hash_map("dense", keys, probes);
+    bench_vector_optional("dense", n, keys, probes);
+
+    const std::size_t range = n * 1000;
+    keys.clear();
+    while (keys.size() < n)
+    {
+      const std::size_t run = rnd() % range;
+      for (std::size_t k = run; k != run + 64; ++k)
+        keys.push_back(k);
+    }
+    for (std::size_t i = 0; i != n; ++i)
+      probes[i] = i % 2 ? keys[rnd() % keys.size()] : rnd() % range; // half hits
+    bench_array_map<paged_map>("sparse", "array_map_paged", keys, probes);
+    bench_hash_map("sparse", keys, probes);
+  }
+}
@@ -0,0 +1,82 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// A lazily filled cache shared by several threads: atomic_compact_optional
+// slots against std::optional slots guarded by a mutex.
+// Usage: benchmark_atomic_compact_optional [slots]
+
+#include "atomic_compact_optional.hpp"
+#include "benchmark.hpp"
+#include <mutex>
+#include <thread>
+#include <optional>
+#include <vector>
+
+using namespace ak_toolbox;
+
+struct locked_slot
+{
+  std::mutex m;
+  std::optional<int> v;
+
+  template <typename F>
+  int get_or_compute(F f)
+  {
+    std::lock_guard<std::mutex> lock(m);
+    if (!v)
+      v = f();
+    return *v;
+  }
+
+  void reset()
+  {
+    std::lock_guard<std::mutex> lock(m);
+    v.reset();
+  }
+};
+
+int expensive(int k) { return (k * 2654435761u) >> 8; }
+
+// every thread looks up every slot `passes` times; slots are reset before each run
+template <typename Slot>
+double run(std::vector<Slot>& slots, unsigned threads, int passes)
+{
+  return bench::time_ns([&] {
+    for (std::size_t s = 0; s != slots.size(); ++s)
+      slots[s].reset();
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t != threads; ++t)
+      pool.emplace_back([&, t] {
+        long long sum = 0;
+        for (int p = 0; p != passes; ++p)
+          for (std::size_t i = 0; i != slots.size(); ++i)
+          {
+            std::size_t s = (i + t * 7919) % slots.size();
+            sum += slots[s].get_or_compute([s] { return expensive(int(s)); });
+          }
+        bench::do_not_optimize(sum);
+      });
+    for (std::thread& th : pool)
+      th.join();
+  }, slots.size() * threads * passes);
+}
+
+int main(int argc, char** argv)
+{
+  std::size_t n = bench::max_elements(argc, argv, 4096);
+  const int passes = 64;
+  bench::print_header();
+  unsigned hw = std::thread::hardware_concurrency();
+  for (unsigned threads = 1; threads <= (hw > 8 ? hw : 8); threads *= 2)
+  {
+    std::vector<atomic_compact_optional<evp_int<int, -1>>> a (n);
+    std::vector<locked_slot> l (n);
+    char name[64];
+    std::snprintf(name, sizeof(name), "get_or_compute@%u_threads", threads);
+    bench::report("atomic_compact_optional", name, n, run(a, threads, passes), double(sizeof(a[0])));
+    bench::report("mutex_std_optional", name, n, run(l, threads, passes), double(sizeof(l[0])));
+  }
+}
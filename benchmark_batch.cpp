@@ -0,0 +1,93 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Batch operations on arrays of compact_optional (one in four empty):
+// counting the empty objects with a has_value() loop, by counting the bits
+// of mask64 words (what count_engaged did before the counting kernels), and
+// with count_empty; resetting all objects with a reset() loop and with
+// fill_empty; and building the emptiness bitmap with mask_empty. ns_per_op
+// is per element; `extra` is the throughput in GB/s of storage. Element
+// counts go from 1K up to max_elements (default 10M).
+// Usage: benchmark_batch [max_elements]
+
+#include "compact_optional_algorithm.hpp"
+#include "benchmark.hpp"
+#include <climits>
+#include <string>
+#include <vector>
+
+using namespace ak_toolbox;
+
+template <typename EVP>
+std::size_t count_loop(const compact_optional<EVP>* p, std::size_t n)
+{
+  std::size_t c = 0;
+  for (std::size_t i = 0; i != n; ++i)
+    c += !p[i].has_value();
+  return c;
+}
+
+template <typename EVP>
+std::size_t count_mask_words(const compact_optional<EVP>* p, std::size_t n)
+{
+  typedef compact_optional_ns::detail_::engaged_scan<EVP> scan;
+  return compact_optional_ns::detail_::scan_defaults<EVP, scan>::count_empty(
+    reinterpret_cast<const typename EVP::storage_type*>(p), n);
+}
+
+template <typename EVP>
+void reset_loop(compact_optional<EVP>* p, std::size_t n)
+{
+  for (std::size_t i = 0; i != n; ++i)
+    p[i].reset();
+}
+
+template <typename EVP, typename Gen>
+void bench_policy(const char* suite, std::size_t n, Gen gen)
+{
+  typedef compact_optional<EVP> opt_t;
+  std::vector<opt_t> v (n), w (n);
+  bench::xorshift64 rnd;
+  for (std::size_t i = 0; i != n; ++i)
+  {
+    std::uint64_t x = rnd();
+    if (x % 4 != 0)
+      v[i] = opt_t(gen(x));
+  }
+  std::vector<std::uint64_t> mask ((n + 63) / 64);
+  const opt_t* first = v.data();
+  const opt_t* last = first + n;
+  const double gb = double(n * sizeof(opt_t)) / 1e9;
+
+  double ns = bench::time_ns([&] { bench::do_not_optimize(count_loop(first, n)); }, n);
+  bench::report(suite, "count_has_value_loop", n, ns, sizeof(opt_t), gb / (ns * n * 1e-9));
+  ns = bench::time_ns([&] { bench::do_not_optimize(count_mask_words(first, n)); }, n);
+  bench::report(suite, "count_mask_words", n, ns, sizeof(opt_t), gb / (ns * n * 1e-9));
+  ns = bench::time_ns([&] { bench::do_not_optimize(count_empty(first, last)); }, n);
+  bench::report(suite, "count_empty", n, ns, sizeof(opt_t), gb / (ns * n * 1e-9));
+
+  ns = bench::time_ns([&] { reset_loop(w.data(), n); bench::do_not_optimize(w[n / 2]); }, n);
+  bench::report(suite, "reset_loop", n, ns, sizeof(opt_t), gb / (ns * n * 1e-9));
+  ns = bench::time_ns([&] { fill_empty(w.data(), w.data() + n); bench::do_not_optimize(w[n / 2]); }, n);
+  bench::report(suite, "fill_empty", n, ns, sizeof(opt_t), gb / (ns * n * 1e-9));
+
+  ns = bench::time_ns([&] { mask_empty(first, last, mask.data()); bench::do_not_optimize(mask[0]); }, n);
+  bench::report(suite, "mask_empty", n, ns, sizeof(opt_t), gb / (ns * n * 1e-9));
+}
+
+int main(int argc, char** argv)
+{
+  std::size_t max_n = bench::max_elements(argc, argv, 10000000);
+  bench::print_header();
+  for (std::size_t n = 1000; n <= max_n; n *= 10)
+  {
+    bench_policy< evp_bool >("bool", n, [](std::uint64_t x) { return x % 2 == 0; });
+    bench_policy< evp_int<int, INT_MIN> >("int32", n, [](std::uint64_t x) { return int(x >> 33); });
+    bench_policy< evp_int<std::int64_t, LLONG_MIN> >("int64", n, [](std::uint64_t x) { return std::int64_t(x >> 1); });
+    bench_policy< evp_fp_nan<float> >("float", n, [](std::uint64_t x) { return float(x >> 40); });
+    bench_policy< evp_fp_nan<double> >("double", n, [](std::uint64_t x) { return double(x >> 11); });
+  }
+}
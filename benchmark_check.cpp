@@ -0,0 +1,81 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// The cost of the collision checking modes on the hot path: constructing
+// compact_optional<evp_int<int, -1>> from each of n ints, copying it into an
+// array, then summing the values through value(). The baseline does the
+// same with plain ints and a hand-written sentinel test; the default mode
+// (check_ignore) should match it exactly. No input collides. ns_per_op is
+// per element; `extra` is the time relative to the baseline. Element counts
+// go from 1K up to max_elements (default 10M).
+// Usage: benchmark_check [max_elements]
+
+#include "compact_optional_counters.hpp"
+#include "benchmark.hpp"
+#include <vector>
+
+using namespace ak_toolbox;
+
+typedef evp_int<int, -1> evp_default;
+struct evp_assert : evp_int<int, -1> { typedef check_assert collision_check; }; // a no-op under NDEBUG
+struct evp_throw : evp_int<int, -1> { typedef check_throw collision_check; };
+struct evp_count : evp_int<int, -1> { typedef check_count collision_check; };
+
+__attribute__((noinline)) long long raw_kernel(const int* in, int* out, std::size_t n)
+{
+  long long sum = 0;
+  for (std::size_t i = 0; i != n; ++i)
+  {
+    int v = in[i];
+    out[i] = v;
+    if (out[i] != -1)
+      sum += out[i];
+  }
+  return sum;
+}
+
+template <typename EVP>
+__attribute__((noinline)) long long kernel(const int* in, compact_optional<EVP>* out, std::size_t n)
+{
+  long long sum = 0;
+  for (std::size_t i = 0; i != n; ++i)
+  {
+    compact_optional<EVP> o (in[i]);
+    out[i] = o;
+    if (out[i].has_value())
+      sum += out[i].value();
+  }
+  return sum;
+}
+
+template <typename EVP>
+void run(const char* name, const std::vector<int>& in, double raw_ns)
+{
+  std::vector< compact_optional<EVP> > out (in.size());
+  double ns = bench::time_ns([&] { bench::do_not_optimize(kernel(in.data(), out.data(), in.size())); }, in.size());
+  bench::report("construct_copy_sum", name, in.size(), ns, sizeof(int), ns / raw_ns);
+}
+
+int main(int argc, char** argv)
+{
+  std::size_t max_n = bench::max_elements(argc, argv, 10000000);
+  bench::print_header();
+  for (std::size_t n = 1000; n <= max_n; n *= 10)
+  {
+    std::vector<int> in (n);
+    bench::xorshift64 rnd;
+    for (std::size_t i = 0; i != n; ++i)
+      in[i] = int(rnd() % 1000000);
+
+    std::vector<int> out (n);
+    double raw_ns = bench::time_ns([&] { bench::do_not_optimize(raw_kernel(in.data(), out.data(), n)); }, n);
+    bench::report("construct_copy_sum", "raw_int", n, raw_ns, sizeof(int), 1.0);
+    run<evp_default>("check_ignore", in, raw_ns);
+    run<evp_assert>("check_assert_ndebug", in, raw_ns);
+    run<evp_throw>("check_throw", in, raw_ns);
+    run<evp_count>("check_count", in, raw_ns);
+  }
+}
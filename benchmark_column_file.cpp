@@ -0,0 +1,78 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Loading a column of compact_optional<evp_fp_nan<double>> (one in ten
+// empty) from disk: opening a column file (header check only), opening it
+// and verifying the data checksum, and parsing the same values from CSV
+// text for comparison; also writing the column file. ns_per_op is per
+// element; `extra` is the throughput in MB of column data per second. The
+// file is in the page cache, so this measures the CPU cost of loading, not
+// the disk. Element counts go from 1K up to max_elements (default 10M).
+// Usage: benchmark_column_file [max_elements]
+
+#include "compact_optional_column_file.hpp"
+#include "compact_optional_csv.hpp"
+#include "benchmark.hpp"
+#include <string>
+#include <vector>
+
+using namespace ak_toolbox;
+
+typedef evp_fp_nan<double> evp_f64;
+typedef compact_optional<evp_f64> opt_f64;
+
+int main(int argc, char** argv)
+{
+  std::size_t max_n = bench::max_elements(argc, argv, 10000000);
+  const std::string path = "benchmark_column_file.tmp";
+  const std::string csv_path = "benchmark_column_file.csv.tmp";
+  bench::print_header();
+  for (std::size_t n = 1000; n <= max_n; n *= 10)
+  {
+    std::vector<opt_f64> v (n);
+    bench::xorshift64 rnd;
+    std::string text;
+    char buf[64];
+    for (std::size_t i = 0; i != n; ++i)
+    {
+      std::uint64_t x = rnd();
+      if (x % 10 != 0)
+      {
+        v[i] = opt_f64(double(std::int64_t(x >> 20)) / 1e4);
+        std::snprintf(buf, sizeof buf, "%.17g", v[i].value());
+        text += buf;
+      }
+      text += '\n';
+    }
+    std::FILE* f = std::fopen(csv_path.c_str(), "wb");
+    std::fwrite(text.data(), 1, text.size(), f);
+    std::fclose(f);
+
+    const double mb = double(n * sizeof(opt_f64)) / 1e6;
+    double ns = bench::time_ns([&] { bench::do_not_optimize(write_column_file(path.c_str(), v.data(), n)); }, n);
+    bench::report("f64", "write_column_file", n, ns, sizeof(opt_f64), mb / (ns * n * 1e-9));
+
+    ns = bench::time_ns([&] {
+      column_file<evp_f64> c (path.c_str());
+      bench::do_not_optimize(c.error() == column_file_ok && c.size() == n);
+    }, n);
+    bench::report("f64", "column_file_open", n, ns, sizeof(opt_f64), mb / (ns * n * 1e-9));
+
+    ns = bench::time_ns([&] {
+      column_file<evp_f64> c (path.c_str());
+      bench::do_not_optimize(c.verify() == column_file_ok);
+    }, n);
+    bench::report("f64", "column_file_open_verify", n, ns, sizeof(opt_f64), mb / (ns * n * 1e-9));
+
+    ns = bench::time_ns([&] {
+      csv_column_reader<evp_f64> r (n, v.data());
+      bench::do_not_optimize(parse_csv_file(csv_path.c_str(), r).ok());
+    }, n);
+    bench::report("f64", "parse_csv_file", n, ns, sizeof(opt_f64), mb / (ns * n * 1e-9));
+  }
+  std::remove(path.c_str());
+  std::remove(csv_path.c_str());
+}
@@ -0,0 +1,119 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Probe lengths and lookup cost of compact_hash_map at different load
+// factors, compared with std::unordered_map. For the *_probe_* cases,
+// `extra` is the probe length.
+// Usage: benchmark_compact_hash_map [max_elements]
+
+#include "compact_hash_map.hpp"
+#include "benchmark.hpp"
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+using namespace ak_toolbox;
+
+struct record { std::uint32_t a, b; };
+
+typedef compact_hash_map<evp_int<std::uint64_t, 0>, record> map_t;
+
+void bench_load_factor(std::size_t n, float load)
+{
+  std::size_t buckets = 16;
+  while (buckets * load < n)
+    buckets *= 2;
+  std::size_t fill = std::size_t(buckets * load);
+
+  map_t m;
+  m.max_load_factor(0.99f);
+  m.rehash(buckets);
+  bench::xorshift64 gen;
+  std::vector<std::uint64_t> keys;
+  for (std::size_t i = 0; i != fill; ++i)
+  {
+    std::uint64_t k = gen() | 1u;
+    if (m.insert(k, record()).second)
+      keys.push_back(k);
+  }
+  std::vector<std::uint64_t> misses;
+  for (std::size_t i = 0; i != keys.size(); ++i)
+    misses.push_back(gen() & ~std::uint64_t(1)); // even keys were never inserted
+
+  double total_probe = 0, max_probe = 0;
+  for (std::size_t i = 0; i != keys.size(); ++i)
+  {
+    double p = double(m.probe_length(keys[i]));
+    total_probe += p;
+    max_probe = std::max(max_probe, p);
+  }
+  double miss_probe = 0;
+  for (std::size_t i = 0; i != misses.size(); ++i)
+    miss_probe += double(m.probe_length(misses[i]));
+
+  char name[64];
+  double bytes = double(m.memory_usage()) / double(m.size());
+  std::snprintf(name, sizeof(name), "avg_probe_hit@%.3f", double(m.load_factor()));
+  bench::report("compact_hash_map", name, m.size(), 0.0, bytes, total_probe / double(keys.size()));
+  std::snprintf(name, sizeof(name), "max_probe_hit@%.3f", double(m.load_factor()));
+  bench::report("compact_hash_map", name, m.size(), 0.0, bytes, max_probe);
+  std::snprintf(name, sizeof(name), "avg_probe_miss@%.3f", double(m.load_factor()));
+  bench::report("compact_hash_map", name, m.size(), 0.0, bytes, miss_probe / double(misses.size()));
+
+  std::snprintf(name, sizeof(name), "find_hit@%.3f", double(m.load_factor()));
+  double ns = bench::time_ns([&] {
+    std::uint64_t sum = 0;
+    for (std::size_t i = 0; i != keys.size(); ++i)
+      sum += m.find(keys[i])->a;
+    bench::do_not_optimize(sum);
+  }, keys.size());
+  bench::report("compact_hash_map", name, m.size(), ns, bytes);
+
+  std::snprintf(name, sizeof(name), "find_miss@%.3f", double(m.load_factor()));
+  ns = bench::time_ns([&] {
+    std::size_t found = 0;
+    for (std::size_t i = 0; i != misses.size(); ++i)
+      found += m.find(misses[i]) != nullptr;
+    bench::do_not_optimize(found);
+  }, misses.size());
+  bench::report("compact_hash_map", name, m.size(), ns, bytes);
+}
+
+void bench_unordered_map(std::size_t n)
+{
+  std::unordered_map<std::uint64_t, record> m;
+  bench::xorshift64 gen;
+  std::vector<std::uint64_t> keys;
+  for (std::size_t i = 0; i != n; ++i)
+  {
+    std::uint64_t k = gen() | 1u;
+    if (m.insert(std::make_pair(k, record())).second)
+      keys.push_back(k);
+  }
+  double ns = bench::time_ns([&] {
+    std::uint64_t sum = 0;
+    for (std::size_t i = 0; i != keys.size(); ++i)
+      sum += m.find(keys[i])->second.a;
+    bench::do_not_optimize(sum);
+  }, keys.size());
+  // node: key, value, next pointer, cached hash, plus one bucket pointer per bucket
+  double bytes = double(m.size() * (sizeof(std::pair<const std::uint64_t, record>) + 2 * sizeof(void*))
+                        + m.bucket_count() * sizeof(void*)) / double(m.size());
+  bench::report("std_unordered_map", "find_hit", m.size(), ns, bytes);
+}
+
+int main(int argc, char** argv)
+{
+  std::size_t max_n = bench::max_elements(argc, argv, std::size_t(1) << 20);
+  bench::print_header();
+  for (std::size_t n = 1024; n <= max_n; n *= 32)
+  {
+    const float loads[] = { 0.5f, 0.75f, 0.875f, 0.95f };
+    for (float load : loads)
+      bench_load_factor(n, load);
+    bench_unordered_map(n);
+  }
+}
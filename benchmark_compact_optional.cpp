@@ -0,0 +1,194 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Size and speed of compact_optional with every shipped policy, against
+// std::optional of the same value type, over arrays of 1K elements up to
+// max_elements (default 1M; pass 100000000 for the full range).
+// Every fourth element is empty. For the scan cases, `extra` is the
+// throughput in MB/s of the optional objects read.
+// Usage: benchmark_compact_optional [max_elements]
+
+#include "compact_optional.hpp"
+#include "benchmark.hpp"
+#include <algorithm>
+#include <new>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace ak_toolbox;
+
+enum class Dir { N, E, S, W };
+
+// values and their numeric weight, for checksums
+
+template <typename T> T make_value(std::size_t i) { return T(i % 1000); }
+template <> bool make_value<bool>(std::size_t i) { return i % 2 != 0; }
+template <> Dir make_value<Dir>(std::size_t i) { return Dir(i % 4); }
+template <> std::string make_value<std::string>(std::size_t i) { return std::to_string(i % 1000); }
+
+template <typename T> long long weight(const T& v) { return static_cast<long long>(v); }
+long long weight(const std::string& v) { return static_cast<long long>(v.size()); }
+
+// uniform access to both kinds of optional
+
+template <typename N>
+typename compact_optional<N>::reference_type get(const compact_optional<N>& o) { return o.value(); }
+
+template <typename T>
+const T& get(const std::optional<T>& o) { return *o; }
+
+// ordering: empty first
+template <typename O>
+struct empty_first
+{
+  bool operator()(const O& l, const O& r) const
+  {
+    if (!r.has_value()) return false;
+    if (!l.has_value()) return true;
+    return get(l) < get(r);
+  }
+};
+
+template <typename O, typename T>
+O make_optional(std::size_t i)
+{
+  return i % 4 == 3 ? O() : O(make_value<T>(i));
+}
+
+template <typename O, typename T>
+void bench_type(const char* suite, std::size_t n)
+{
+  const double bytes = double(sizeof(O));
+  std::vector<O> a, b;
+  a.reserve(n);
+  for (std::size_t i = 0; i != n; ++i)
+    a.push_back(make_optional<O, T>(i));
+  b = a;
+
+  std::vector<T> values;
+  values.reserve(n);
+  for (std::size_t i = 0; i != n; ++i)
+    values.push_back(make_value<T>(i));
+
+  // construction from a value, into raw memory
+  {
+    O* raw = static_cast<O*>(::operator new(n * sizeof(O)));
+    double ns = bench::time_ns([&] {
+      for (std::size_t i = 0; i != n; ++i)
+        ::new (static_cast<void*>(raw + i)) O(values[i]);
+      bench::do_not_optimize(raw[n - 1]);
+      for (std::size_t i = 0; i != n; ++i)
+        raw[i].~O();
+    }, n);
+    ::operator delete(raw);
+    bench::report(suite, "construct", n, ns, bytes);
+  }
+
+  // copy assignment
+  {
+    double ns = bench::time_ns([&] {
+      std::copy(a.begin(), a.end(), b.begin());
+      bench::do_not_optimize(b[n - 1]);
+    }, n);
+    bench::report(suite, "copy", n, ns, bytes);
+  }
+
+  // swap
+  {
+    double ns = bench::time_ns([&] {
+      using std::swap;
+      for (std::size_t i = 0; i != n; ++i)
+        swap(a[i], b[i]);
+      bench::do_not_optimize(a[0]);
+    }, n);
+    bench::report(suite, "swap", n, ns, bytes);
+  }
+
+  // sequential scan: has_value() only
+  {
+    double ns = bench::time_ns([&] {
+      std::size_t c = 0;
+      for (std::size_t i = 0; i != n; ++i)
+        c += a[i].has_value();
+      bench::do_not_optimize(c);
+    }, n);
+    bench::report(suite, "has_value_scan", n, ns, bytes, bytes * 1e3 / ns);
+  }
+
+  // sequential scan: has_value() and value()
+  {
+    double ns = bench::time_ns([&] {
+      long long sum = 0;
+      for (std::size_t i = 0; i != n; ++i)
+        if (a[i].has_value())
+          sum += weight(get(a[i]));
+      bench::do_not_optimize(sum);
+    }, n);
+    bench::report(suite, "value_scan", n, ns, bytes, bytes * 1e3 / ns);
+  }
+
+  // random-order scan: sensitive to cache misses, hence to the object size
+  {
+    std::vector<std::uint32_t> order (n);
+    std::iota(order.begin(), order.end(), 0u);
+    bench::xorshift64 gen;
+    for (std::size_t i = n - 1; i > 0; --i)
+      std::swap(order[i], order[gen() % (i + 1)]);
+
+    double ns = bench::time_ns([&] {
+      long long sum = 0;
+      for (std::size_t i = 0; i != n; ++i)
+      {
+        const O& o = a[order[i]];
+        if (o.has_value())
+          sum += weight(get(o));
+      }
+      bench::do_not_optimize(sum);
+    }, n);
+    bench::report(suite, "random_scan", n, ns, bytes, bytes * 1e3 / ns);
+  }
+
+  // sort, empty first; the time to restore the unsorted input is included
+  {
+    std::vector<O> unsorted = a;
+    double ns = bench::time_ns([&] {
+      std::copy(unsorted.begin(), unsorted.end(), b.begin());
+      std::sort(b.begin(), b.end(), empty_first<O>());
+      bench::do_not_optimize(b[0]);
+    }, n, 20.0);
+    bench::report(suite, "sort", n, ns, bytes);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  std::size_t max_n = bench::max_elements(argc, argv, 1000000);
+  bench::print_header();
+  for (std::size_t n = 1000; n <= max_n; n *= 10)
+  {
+    bench_type<compact_optional<evp_int<int, -1>>, int>("evp_int<int>", n);
+    bench_type<std::optional<int>, int>("std::optional<int>", n);
+
+    bench_type<compact_optional<evp_fp_nan<double>>, double>("evp_fp_nan<double>", n);
+    bench_type<std::optional<double>, double>("std::optional<double>", n);
+
+    bench_type<compact_optional<evp_bool>, bool>("evp_bool", n);
+    bench_type<std::optional<bool>, bool>("std::optional<bool>", n);
+
+    bench_type<compact_optional<evp_enum<Dir, -1>>, Dir>("evp_enum<Dir>", n);
+    bench_type<std::optional<Dir>, Dir>("std::optional<Dir>", n);
+
+    bench_type<compact_optional<evp_optional<std::optional<int>>>, int>("evp_optional<std::optional<int>>", n);
+
+    if (n <= 10000000) // strings: keep memory use reasonable
+    {
+      bench_type<compact_optional<evp_stl_empty<std::string>>, std::string>("evp_stl_empty<string>", n);
+      bench_type<std::optional<std::string>, std::string>("std::optional<string>", n);
+    }
+  }
+}
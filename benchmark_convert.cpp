@@ -0,0 +1,94 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Conversion between std::vector<std::optional<T>> and arrays of
+// compact_optional, one third of the elements empty, for int (evp_int),
+// double (evp_fp_nan) and bool (evp_bool): to_compact and from_compact into
+// a separate buffer and in place, compared with loops converting one element
+// at a time. ns_per_op is per element; `extra` is the throughput in GB/s of
+// std::optional elements. Element counts go from 1K up to max_elements
+// (default 10M).
+// Usage: benchmark_convert [max_elements]
+
+#include "compact_optional_convert.hpp"
+#include "benchmark.hpp"
+#include <cstring>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace ak_toolbox;
+
+template <typename EVP, typename Gen>
+void bench_policy(const char* suite, std::size_t n, Gen gen)
+{
+  typedef typename EVP::value_type T;
+  typedef compact_optional<EVP> opt_t;
+  std::vector< std::optional<T> > src (n), buf (n);
+  bench::xorshift64 rnd;
+  for (std::optional<T>& o : src)
+  {
+    const std::uint64_t x = rnd();
+    if (x % 3 != 0)
+      o = gen(x);
+  }
+  std::vector<opt_t> c (n);
+  const double bytes = double(sizeof(std::optional<T>));
+
+  double ns = bench::time_ns([&] {
+    std::size_t first_collision = n;
+    for (std::size_t i = 0; i != n; ++i)
+    {
+      c[i] = src[i] ? opt_t(*src[i]) : opt_t();
+      if (src[i] && !c[i].has_value() && first_collision == n)
+        first_collision = i;
+    }
+    bench::do_not_optimize(first_collision);
+    bench::do_not_optimize(c.data());
+  }, n);
+  bench::report(suite, "to_compact_loop", n, ns, bytes, bytes / ns);
+
+  ns = bench::time_ns([&] {
+    bench::do_not_optimize(to_compact(src.data(), src.data() + n, c.data()));
+    bench::do_not_optimize(c.data());
+  }, n);
+  bench::report(suite, "to_compact", n, ns, bytes, bytes / ns);
+
+  ns = bench::time_ns([&] {
+    for (std::size_t i = 0; i != n; ++i)
+      buf[i] = c[i].has_value() ? std::optional<T>(c[i].value()) : std::nullopt;
+    bench::do_not_optimize(buf.data());
+  }, n);
+  bench::report(suite, "from_compact_loop", n, ns, bytes, bytes / ns);
+
+  ns = bench::time_ns([&] {
+    from_compact(c.data(), c.data() + n, buf.data());
+    bench::do_not_optimize(buf.data());
+  }, n);
+  bench::report(suite, "from_compact", n, ns, bytes, bytes / ns);
+
+  // there and back again in the same buffer
+  std::memcpy(static_cast<void*>(buf.data()), src.data(), n * sizeof(src[0]));
+  opt_t* cp = reinterpret_cast<opt_t*>(buf.data());
+  ns = bench::time_ns([&] {
+    to_compact(buf.data(), buf.data() + n, cp);
+    from_compact(cp, cp + n, buf.data());
+    bench::do_not_optimize(buf.data());
+  }, n);
+  bench::report(suite, "round_trip_in_place", n, ns, bytes, 2 * bytes / ns);
+}
+
+int main(int argc, char** argv)
+{
+  std::size_t max_n = bench::max_elements(argc, argv, 10000000);
+  bench::print_header();
+  for (std::size_t n = 1000; n <= max_n; n *= 10)
+  {
+    bench_policy< evp_int<int, -1> >("int", n, [](std::uint64_t x) { return int(x >> 40); });
+    bench_policy< evp_fp_nan<double> >("double", n, [](std::uint64_t x) { return double(x >> 11); });
+    bench_policy<evp_bool>("bool", n, [](std::uint64_t x) { return (x >> 32) % 2 == 0; });
+  }
+}
@@ -0,0 +1,124 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Parsing CSV text with an int, a double and an int64 column (one in ten
+// fields empty or NULL) into compact_optional columns. The baseline parses
+// into std::optional with strtol/strtod, then converts; csv_column_reader
+// gets the whole text at once, or in 64 KB chunks. ns_per_op is per row;
+// `extra` is the throughput in MB/s of input text. Row counts go from 1K up
+// to max_elements (default 1M).
+// Usage: benchmark_csv [max_elements]
+
+#include "compact_optional_csv.hpp"
+#include "benchmark.hpp"
+#include <climits>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace ak_toolbox;
+
+typedef evp_int<int, INT_MIN> evp_i32;
+typedef evp_fp_nan<double> evp_f64;
+typedef evp_int<std::int64_t, LLONG_MIN> evp_i64;
+
+std::string make_csv(std::size_t rows)
+{
+  std::string s;
+  bench::xorshift64 rnd;
+  char buf[64];
+  for (std::size_t i = 0; i != rows; ++i)
+  {
+    std::uint64_t x = rnd();
+    if (x % 10 == 0) s += "NULL";
+    else { std::snprintf(buf, sizeof buf, "%d", int(x >> 40) - (1 << 23)); s += buf; }
+    s += ',';
+    if (x % 10 == 1) {}
+    else { std::snprintf(buf, sizeof buf, "%.6g", double(std::int64_t(x >> 20)) / 1e4); s += buf; }
+    s += ',';
+    if (x % 10 == 2) s += "NULL";
+    else { std::snprintf(buf, sizeof buf, "%lld", (long long)(x >> 3)); s += buf; }
+    s += '\n';
+  }
+  return s;
+}
+
+struct columns
+{
+  std::vector< compact_optional<evp_i32> > a;
+  std::vector< compact_optional<evp_f64> > b;
+  std::vector< compact_optional<evp_i64> > c;
+
+  explicit columns(std::size_t n) : a(n), b(n), c(n) {}
+};
+
+bool is_null(const char* p, const char* e)
+{
+  return p == e || (e - p == 4 && std::memcmp(p, "NULL", 4) == 0);
+}
+
+// what one writes today
+std::size_t parse_baseline(const std::string& text, columns& out,
+                           std::vector< std::optional<int> >& a, std::vector< std::optional<double> >& b,
+                           std::vector< std::optional<long long> >& c)
+{
+  std::size_t row = 0;
+  const char* p = text.data();
+  const char* end = p + text.size();
+  while (p != end)
+  {
+    const char* e = p;
+    while (*e != ',') ++e;
+    a[row] = is_null(p, e) ? std::nullopt : std::optional<int>(int(std::strtol(p, 0, 10)));
+    p = e + 1;
+    for (e = p; *e != ','; ++e) {}
+    b[row] = is_null(p, e) ? std::nullopt : std::optional<double>(std::strtod(p, 0));
+    p = e + 1;
+    for (e = p; *e != '\n'; ++e) {}
+    c[row] = is_null(p, e) ? std::nullopt : std::optional<long long>(std::strtoll(p, 0, 10));
+    p = e + 1;
+    ++row;
+  }
+  for (std::size_t i = 0; i != row; ++i)
+  {
+    out.a[i] = a[i] ? compact_optional<evp_i32>(*a[i]) : compact_optional<evp_i32>();
+    out.b[i] = b[i] ? compact_optional<evp_f64>(*b[i]) : compact_optional<evp_f64>();
+    out.c[i] = c[i] ? compact_optional<evp_i64>(*c[i]) : compact_optional<evp_i64>();
+  }
+  return row;
+}
+
+std::size_t parse_reader(const std::string& text, columns& out, std::size_t chunk)
+{
+  csv_column_reader<evp_i32, evp_f64, evp_i64> r (out.a.size(), out.a.data(), out.b.data(), out.c.data());
+  for (std::size_t i = 0; i < text.size(); i += chunk)
+    r.feed(text.data() + i, std::min(chunk, text.size() - i));
+  r.finish();
+  return r.rows();
+}
+
+int main(int argc, char** argv)
+{
+  std::size_t max_n = bench::max_elements(argc, argv, 1000000);
+  bench::print_header();
+  for (std::size_t n = 1000; n <= max_n; n *= 10)
+  {
+    const std::string text = make_csv(n);
+    const double mb = double(text.size()) / 1e6;
+    columns out (n);
+    std::vector< std::optional<int> > a (n);
+    std::vector< std::optional<double> > b (n);
+    std::vector< std::optional<long long> > c (n);
+
+    double ns = bench::time_ns([&] { bench::do_not_optimize(parse_baseline(text, out, a, b, c)); }, n);
+    bench::report("i32_f64_i64", "strtod_std_optional", n, ns, double(text.size()) / n, mb / (ns * n * 1e-9));
+    ns = bench::time_ns([&] { bench::do_not_optimize(parse_reader(text, out, text.size())); }, n);
+    bench::report("i32_f64_i64", "csv_column_reader", n, ns, double(text.size()) / n, mb / (ns * n * 1e-9));
+    ns = bench::time_ns([&] { bench::do_not_optimize(parse_reader(text, out, 1 << 16)); }, n);
+    bench::report("i32_f64_i64", "csv_column_reader_64k_chunks", n, ns, double(text.size()) / n, mb / (ns * n * 1e-9));
+  }
+}
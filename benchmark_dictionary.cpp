@@ -0,0 +1,138 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// A column of optional strings (1000 distinct values of 21 characters, one
+// row in ten empty) stored as std::vector<std::optional<std::string>>, as
+// compact_optional with the string_empty_value policy of the README, and as
+// a dictionary_column. Cases: building the column from the input strings,
+// and counting the rows equal to a given string. ns_per_op is per row;
+// bytes_per_element is the memory per row, including the heap memory of the
+// strings and the dictionary. Row counts go from 1K up to max_elements
+// (default 10M).
+// Usage: benchmark_dictionary [max_elements]
+
+#include "compact_optional_dictionary.hpp"
+#include "benchmark.hpp"
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace ak_toolbox;
+
+struct string_empty_value : compact_optional_type<std::string>
+{
+  static std::string empty_value() { return std::string("\0\0", 2); }
+  static bool is_empty_value(const std::string& v) { return v.compare(0, v.npos, "\0\0", 2) == 0; }
+};
+
+std::size_t heap_bytes(const std::string& s)
+{
+  return s.capacity() > 15 ? s.capacity() + 1 : 0; // libstdc++ keeps up to 15 characters inline
+}
+
+void bench_std_optional(std::size_t n, const std::vector<const std::string*>& rows, const std::string& needle)
+{
+  std::vector< std::optional<std::string> > c;
+  double ns = bench::time_ns([&] {
+    c.clear();
+    c.reserve(n);
+    for (const std::string* s : rows)
+      c.push_back(s ? std::optional<std::string>(*s) : std::nullopt);
+    bench::do_not_optimize(c.data());
+  }, n);
+  std::size_t bytes = c.capacity() * sizeof(c[0]);
+  for (const std::optional<std::string>& o : c)
+    bytes += o ? heap_bytes(*o) : 0;
+  bench::report("build", "vector_std_optional_string", n, ns, double(bytes) / n);
+
+  ns = bench::time_ns([&] {
+    std::size_t k = 0;
+    for (const std::optional<std::string>& o : c)
+      k += o && *o == needle;
+    bench::do_not_optimize(k);
+  }, n);
+  bench::report("count_equal", "vector_std_optional_string", n, ns, double(bytes) / n);
+}
+
+void bench_string_empty_value(std::size_t n, const std::vector<const std::string*>& rows, const std::string& needle)
+{
+  typedef compact_optional<string_empty_value> opt_str;
+  std::vector<opt_str> c;
+  double ns = bench::time_ns([&] {
+    c.clear();
+    c.reserve(n);
+    for (const std::string* s : rows)
+      c.push_back(s ? opt_str(*s) : opt_str());
+    bench::do_not_optimize(c.data());
+  }, n);
+  std::size_t bytes = c.capacity() * sizeof(c[0]);
+  for (const opt_str& o : c)
+    bytes += o.has_value() ? heap_bytes(o.value()) : 0;
+  bench::report("build", "compact_optional_string_empty_value", n, ns, double(bytes) / n);
+
+  ns = bench::time_ns([&] {
+    std::size_t k = 0;
+    for (const opt_str& o : c)
+      k += o.has_value() && o.value() == needle;
+    bench::do_not_optimize(k);
+  }, n);
+  bench::report("count_equal", "compact_optional_string_empty_value", n, ns, double(bytes) / n);
+}
+
+void bench_dictionary(std::size_t n, const std::vector<const std::string*>& rows, const std::string& needle)
+{
+  string_dictionary d;
+  dictionary_column c (d);
+  double ns = bench::time_ns([&] {
+    d.reset();
+    c.clear();
+    c.reserve(n);
+    for (const std::string* s : rows)
+    {
+      if (s)
+        c.push_back(*s);
+      else
+        c.push_back_empty();
+    }
+    bench::do_not_optimize(c.ids().data());
+  }, n);
+  const double bytes = double(c.memory_usage() + d.memory_usage()) / n;
+  bench::report("build", "dictionary_column", n, ns, bytes);
+
+  ns = bench::time_ns([&] { bench::do_not_optimize(c.count_equal(needle)); }, n);
+  bench::report("count_equal", "dictionary_column", n, ns, bytes);
+}
+
+int main(int argc, char** argv)
+{
+  std::size_t max_n = bench::max_elements(argc, argv, 10000000);
+  bench::print_header();
+
+  std::vector<std::string> distinct;
+  for (int i = 0; i != 1000; ++i)
+  {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "category-%06d-label", i * 7919 % 1000000);
+    distinct.push_back(buf);
+  }
+
+  for (std::size_t n = 1000; n <= max_n; n *= 10)
+  {
+    bench::xorshift64 rnd;
+    std::vector<const std::string*> rows (n);
+    for (const std::string*& r : rows)
+    {
+      const std::uint64_t x = rnd();
+      r = x % 10 == 0 ? nullptr : &distinct[(x >> 8) % distinct.size()];
+    }
+    const std::string& needle = distinct[42];
+
+    bench_std_optional(n, rows, needle);
+    bench_string_empty_value(n, rows, needle);
+    bench_dictionary(n, rows, needle);
+  }
+}
@@ -0,0 +1,152 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Gap filling over series of compact_optional<evp_fp_nan<double>> (suites
+// double_*) and of millisecond time points (suite time_point_1pct): the
+// kernels forward_fill, backward_fill, interpolate_linear and replace_empty
+// compared with element-by-element loops over has_value(). Suffixes name
+// the share of empty samples: 1pct in gaps of 1 to 8 samples, 50pct at
+// random. Each measurement restores the series from a copy first; that
+// copy is timed separately and subtracted. ns_per_op is per sample; `extra`
+// is the throughput in GB/s of series. Sample counts go from 1M up to
+// max_elements (default 100M).
+// Usage: benchmark_gap_fill [max_elements]
+
+#include "compact_optional_chrono.hpp"
+#include "benchmark.hpp"
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace ak_toolbox;
+
+template <typename Opt>
+void loop_forward_fill(Opt* p, std::size_t n)
+{
+  for (std::size_t i = 1; i < n; ++i)
+    if (!p[i].has_value())
+      p[i] = p[i - 1];
+}
+
+template <typename Opt>
+void loop_backward_fill(Opt* p, std::size_t n)
+{
+  for (std::size_t i = n; i-- > 1; )
+    if (!p[i - 1].has_value())
+      p[i - 1] = p[i];
+}
+
+template <typename Opt, typename T>
+void loop_replace_empty(Opt* p, std::size_t n, T v)
+{
+  for (std::size_t i = 0; i != n; ++i)
+    if (!p[i].has_value())
+      p[i] = Opt(v);
+}
+
+template <typename Opt>
+void loop_interpolate(Opt* p, std::size_t n)
+{
+  std::size_t last = n;
+  for (std::size_t i = 0; i != n; ++i)
+  {
+    if (!p[i].has_value())
+      continue;
+    if (last != n && last + 1 != i)
+    {
+      const double lo = p[last].value(), hi = p[i].value(), step = 1.0 / double(i - last);
+      for (std::size_t k = last + 1; k != i; ++k)
+        p[k] = Opt(lo + (hi - lo) * (double(k - last) * step));
+    }
+    last = i;
+  }
+}
+
+template <typename Opt, typename F>
+void measure(const char* suite, const char* name, const std::vector<Opt>& src, std::vector<Opt>& work,
+             double copy_ns, F f)
+{
+  const std::size_t n = src.size();
+  double ns = bench::time_ns([&] {
+    std::memcpy(static_cast<void*>(work.data()), src.data(), n * sizeof(Opt));
+    f(work.data(), n);
+    bench::do_not_optimize(work[n / 2]);
+  }, n) - copy_ns;
+  bench::report(suite, name, n, ns, sizeof(Opt), double(sizeof(Opt)) / ns);
+}
+
+template <typename Opt>
+double copy_ns(const std::vector<Opt>& src, std::vector<Opt>& work)
+{
+  return bench::time_ns([&] {
+    std::memcpy(static_cast<void*>(work.data()), src.data(), src.size() * sizeof(Opt));
+    bench::do_not_optimize(work[src.size() / 2]);
+  }, src.size());
+}
+
+// every sample present, except for gaps of 1 to 8 samples (share 1%), or except 50% of samples at random
+template <typename Opt, typename Gen>
+std::vector<Opt> make_series(std::size_t n, bool sparse_gaps, Gen gen)
+{
+  std::vector<Opt> v (n);
+  bench::xorshift64 rnd;
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    const std::uint64_t x = rnd();
+    if (sparse_gaps ? x % 450 == 0 : x % 2 == 0)
+      i += sparse_gaps ? x % 8 : 0;
+    else
+      v[i] = Opt(gen(i, x));
+  }
+  return v;
+}
+
+void bench_double(const char* suite, std::size_t n, bool sparse_gaps)
+{
+  typedef compact_optional< evp_fp_nan<double> > opt_t;
+  const std::vector<opt_t> src = make_series<opt_t>(n, sparse_gaps, [](std::size_t i, std::uint64_t x) {
+    return double(i) + double(x % 100) / 100;
+  });
+  std::vector<opt_t> work (n);
+  const double c = copy_ns(src, work);
+
+  measure(suite, "forward_fill_loop", src, work, c, [](opt_t* p, std::size_t m) { loop_forward_fill(p, m); });
+  measure(suite, "forward_fill", src, work, c, [](opt_t* p, std::size_t m) { forward_fill(p, p + m); });
+  measure(suite, "backward_fill_loop", src, work, c, [](opt_t* p, std::size_t m) { loop_backward_fill(p, m); });
+  measure(suite, "backward_fill", src, work, c, [](opt_t* p, std::size_t m) { backward_fill(p, p + m); });
+  measure(suite, "interpolate_loop", src, work, c, [](opt_t* p, std::size_t m) { loop_interpolate(p, m); });
+  measure(suite, "interpolate_linear", src, work, c, [](opt_t* p, std::size_t m) { interpolate_linear(p, p + m); });
+  measure(suite, "replace_empty_loop", src, work, c, [](opt_t* p, std::size_t m) { loop_replace_empty(p, m, 0.0); });
+  measure(suite, "replace_empty", src, work, c, [](opt_t* p, std::size_t m) { replace_empty(p, p + m, 0.0); });
+}
+
+void bench_time_point(std::size_t n)
+{
+  typedef std::chrono::time_point<std::chrono::system_clock, std::chrono::milliseconds> tp;
+  typedef compact_optional< evp_time_point<tp> > opt_t;
+  const std::vector<opt_t> src = make_series<opt_t>(n, true, [](std::size_t i, std::uint64_t) {
+    return tp(std::chrono::milliseconds(std::int64_t(i) * 1000));
+  });
+  std::vector<opt_t> work (n);
+  const double c = copy_ns(src, work);
+
+  measure("time_point_1pct", "forward_fill_loop", src, work, c, [](opt_t* p, std::size_t m) { loop_forward_fill(p, m); });
+  measure("time_point_1pct", "forward_fill", src, work, c, [](opt_t* p, std::size_t m) { forward_fill(p, p + m); });
+  measure("time_point_1pct", "interpolate_linear", src, work, c, [](opt_t* p, std::size_t m) { interpolate_linear(p, p + m); });
+}
+
+int main(int argc, char** argv)
+{
+  std::size_t max_n = bench::max_elements(argc, argv, 100000000);
+  bench::print_header();
+  for (std::size_t n = 1000000; n <= max_n; n *= 10)
+  {
+    bench_double("double_1pct", n, true);
+    bench_double("double_50pct", n, false);
+    bench_time_point(n);
+  }
+}
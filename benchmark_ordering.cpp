@@ -0,0 +1,76 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// std::sort of nullable int keys (one in five empty, random order) with a
+// hand-written comparator that branches on has_value(), against
+// empty_first_less and empty_last_less. With evp_int<int, INT_MIN> the empty
+// value is the lowest int, so empty_first_less compares the raw values;
+// with evp_int<int, -1> it combines the emptiness flags without branches.
+// The time to restore the unsorted input is included. `extra` is unused.
+// Usage: benchmark_ordering [max_elements]
+
+#include "compact_optional_ordering.hpp"
+#include "benchmark.hpp"
+#include <algorithm>
+#include <climits>
+#include <string>
+#include <vector>
+
+using namespace ak_toolbox;
+
+// what one writes without the library's orderings
+struct branching_empty_first
+{
+  template <typename O>
+  bool operator()(const O& l, const O& r) const
+  {
+    if (!r.has_value()) return false;
+    if (!l.has_value()) return true;
+    return l.value() < r.value();
+  }
+};
+
+template <typename O, typename Cmp>
+void bench_sort(const std::string& suite, const char* name, const std::vector<O>& input)
+{
+  const std::size_t n = input.size();
+  std::vector<O> v (n);
+  double ns = bench::time_ns([&] {
+    std::copy(input.begin(), input.end(), v.begin());
+    std::sort(v.begin(), v.end(), Cmp());
+    bench::do_not_optimize(v[0]);
+  }, n, 20.0);
+  bench::report(suite.c_str(), name, n, ns, double(sizeof(O)));
+}
+
+template <typename EVP>
+void bench_policy(const char* suite, std::size_t n)
+{
+  typedef compact_optional<EVP> opt_t;
+  std::vector<opt_t> input;
+  input.reserve(n);
+  bench::xorshift64 gen;
+  for (std::size_t i = 0; i != n; ++i)
+  {
+    std::uint64_t x = gen();
+    input.push_back(x % 5 == 0 ? opt_t() : opt_t(int(x >> 33) - (1 << 30)));
+  }
+
+  bench_sort<opt_t, branching_empty_first>(suite, "sort_branching", input);
+  bench_sort<opt_t, empty_first_less>(suite, "sort_empty_first_less", input);
+  bench_sort<opt_t, empty_last_less>(suite, "sort_empty_last_less", input);
+}
+
+int main(int argc, char** argv)
+{
+  std::size_t max_n = bench::max_elements(argc, argv, 1000000);
+  bench::print_header();
+  for (std::size_t n = 1000; n <= max_n; n *= 10)
+  {
+    bench_policy< evp_int<int, INT_MIN> >("evp_int<int,INT_MIN>", n);
+    bench_policy< evp_int<int, -1> >("evp_int<int,-1>", n);
+  }
+}
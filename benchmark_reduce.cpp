@@ -0,0 +1,71 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Null-skipping aggregates (count, sum, min, max) of nullable columns, one in
+// four elements empty: a loop that branches on has_value(), against
+// aggregate_engaged on one thread and on every hardware thread. Sizes go
+// from 1K elements up to max_elements (default 10M). `extra` is the number
+// of threads requested; below 1M elements per thread fewer are used.
+// Usage: benchmark_reduce [max_elements]
+
+#include "compact_optional_reduce.hpp"
+#include "benchmark.hpp"
+#include <algorithm>
+#include <vector>
+
+using namespace ak_toolbox;
+
+template <typename EVP>
+engaged_aggregate<EVP> branching_aggregate(const std::vector< compact_optional<EVP> >& v)
+{
+  engaged_aggregate<EVP> r;
+  r.count = 0;
+  r.sum = 0;
+  for (std::size_t i = 0; i != v.size(); ++i)
+    if (v[i].has_value())
+    {
+      ++r.count;
+      r.sum += v[i].value();
+      if (!r.min.has_value() || v[i].value() < r.min.value()) r.min = v[i];
+      if (!r.max.has_value() || r.max.value() < v[i].value()) r.max = v[i];
+    }
+  return r;
+}
+
+template <typename EVP, typename Gen>
+void bench_policy(const char* suite, std::size_t n, Gen gen)
+{
+  typedef compact_optional<EVP> opt_t;
+  std::vector<opt_t> v;
+  v.reserve(n);
+  bench::xorshift64 rnd;
+  for (std::size_t i = 0; i != n; ++i)
+  {
+    std::uint64_t x = rnd();
+    v.push_back(x % 4 == 0 ? opt_t() : opt_t(gen(x)));
+  }
+
+  const unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+  double ns = bench::time_ns([&] { bench::do_not_optimize(branching_aggregate(v)); }, n);
+  bench::report(suite, "branching_loop", n, ns, double(sizeof(opt_t)), 1);
+  ns = bench::time_ns([&] { bench::do_not_optimize(aggregate_engaged(v.data(), n, 1)); }, n);
+  bench::report(suite, "aggregate_engaged", n, ns, double(sizeof(opt_t)), 1);
+  ns = bench::time_ns([&] { bench::do_not_optimize(aggregate_engaged(v.data(), n, hw)); }, n);
+  bench::report(suite, "aggregate_engaged", n, ns, double(sizeof(opt_t)), hw);
+}
+
+int main(int argc, char** argv)
+{
+  std::size_t max_n = bench::max_elements(argc, argv, 10000000);
+  bench::print_header();
+  for (std::size_t n = 1000; n <= max_n; n *= 10)
+  {
+    bench_policy< evp_int<int, -1> >("evp_int<int>", n, [](std::uint64_t x) { return int(x % 1000000); });
+    bench_policy< evp_int<std::int64_t, -1> >("evp_int<int64_t>", n, [](std::uint64_t x) { return std::int64_t(x >> 2); });
+    bench_policy< evp_fp_nan<float> >("evp_fp_nan<float>", n, [](std::uint64_t x) { return float(x % 100000) / 8; });
+    bench_policy< evp_fp_nan<double> >("evp_fp_nan<double>", n, [](std::uint64_t x) { return double(std::int64_t(x)) / 1e6; });
+  }
+}
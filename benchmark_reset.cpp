@@ -0,0 +1,130 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Cost of emptying compact_optional objects of raw-storage records of 16 B
+// to 4 KB, whose empty state is a sentinel in their first int, with and
+// without the policy's mark_empty hook. The suite name tells the record
+// size, whether the record is trivially copyable (sample: member storage)
+// or not (owned_sample: buffer storage), and whether the policy provides
+// mark_empty.
+// Cases: reset (an emplace followed by a reset, per element) and
+// default_construct. `extra` is unused.
+// Usage: benchmark_reset [elements]
+
+#include "compact_optional.hpp"
+#include "benchmark.hpp"
+#include <cstring>
+#include <new>
+#include <string>
+
+using namespace ak_toolbox;
+
+// Size bytes, of which only the leading id tells if the sample is empty
+template <std::size_t Size>
+struct sample
+{
+  int id;
+  unsigned char bytes[Size - sizeof(int)];
+  explicit sample(int i) : id(i) {}
+};
+
+// the same bytes, not trivially destructible, which puts it in buffer storage
+template <std::size_t Size>
+struct owned_sample : sample<Size>
+{
+  explicit owned_sample(int i) : sample<Size>(i) {}
+  ~owned_sample() {}
+};
+
+const int no_id = -1;
+
+// Empty when the id is no_id. With Marked, the policy has mark_empty, which
+// writes just the id; without, every reset copies a full Size-byte pattern.
+template <typename T, bool Marked>
+struct evp_sample : compact_optional_pod_storage_type<T>
+{
+  typedef typename compact_optional_pod_storage_type<T>::storage_type storage_type;
+
+  static storage_type empty_value() AK_TOOLBOX_NOEXCEPT
+  {
+    storage_type s = storage_type();
+    std::memcpy(&s, &no_id, sizeof(int));
+    return s;
+  }
+
+  static bool is_empty_value(const storage_type& s) { return std::memcmp(&s, &no_id, sizeof(int)) == 0; }
+};
+
+template <typename T>
+struct evp_sample<T, true> : evp_sample<T, false>
+{
+  typedef typename evp_sample<T, false>::storage_type storage_type;
+
+  static void mark_empty(storage_type& s) AK_TOOLBOX_NOEXCEPT { std::memcpy(&s, &no_id, sizeof(int)); }
+};
+
+template <typename EVP>
+void bench_policy(const std::string& suite, std::size_t n)
+{
+  typedef compact_optional<EVP> opt_t;
+  const double bytes = double(sizeof(opt_t));
+  opt_t* a = static_cast<opt_t*>(::operator new(n * sizeof(opt_t)));
+
+  {
+    double ns = bench::time_ns([&] {
+      for (std::size_t i = 0; i != n; ++i)
+        ::new (static_cast<void*>(a + i)) opt_t();
+      bench::do_not_optimize(a[n - 1]);
+      for (std::size_t i = 0; i != n; ++i)
+        a[i].~opt_t();
+    }, n);
+    bench::report(suite.c_str(), "default_construct", n, ns, bytes);
+  }
+
+  for (std::size_t i = 0; i != n; ++i)
+    ::new (static_cast<void*>(a + i)) opt_t();
+  {
+    double ns = bench::time_ns([&] {
+      for (std::size_t i = 0; i != n; ++i)
+      {
+        a[i].emplace(int(i));
+        a[i].reset();
+      }
+      bench::do_not_optimize(a[n - 1]);
+    }, n);
+    bench::report(suite.c_str(), "reset", n, ns, bytes);
+  }
+  for (std::size_t i = 0; i != n; ++i)
+    a[i].~opt_t();
+
+  ::operator delete(a);
+}
+
+template <typename T>
+void bench_record(const std::string& suite, std::size_t n)
+{
+  bench_policy< evp_sample<T, false> >(suite + "/full_pattern", n);
+  bench_policy< evp_sample<T, true> >(suite + "/mark_empty", n);
+}
+
+template <std::size_t Size>
+void bench_size(std::size_t n)
+{
+  bench_record< sample<Size> >("sample<" + std::to_string(Size) + ">/member", n);
+  bench_record< owned_sample<Size> >("owned_sample<" + std::to_string(Size) + ">/buffer", n);
+}
+
+int main(int argc, char** argv)
+{
+  // small enough to stay in cache for the smaller records
+  std::size_t n = bench::max_elements(argc, argv, 1000);
+  bench::print_header();
+  bench_size<16>(n);
+  bench_size<64>(n);
+  bench_size<256>(n);
+  bench_size<1024>(n);
+  bench_size<4096>(n);
+}
@@ -0,0 +1,116 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// value_or and transform over arrays of compact_optional, with 1% (suffix
+// 1pct) or 50% (50pct) of the elements empty at random. Suites int_* and
+// double_* sum `o.value_or(d)`, compared with `o.has_value() ? o.value() : d`
+// and with std::optional::value_or. Suite transform_* maps int into a
+// compact_optional<evp_int<long, -1>> with transform<evp_int<long, -1>>,
+// compared with going through a std::optional<long>. ns_per_op is per
+// element; `extra` is the throughput in GB/s of input. Element counts go
+// from 1K up to max_elements (default 10M).
+// Usage: benchmark_value_or [max_elements]
+
+#include "compact_optional.hpp"
+#include "benchmark.hpp"
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace ak_toolbox;
+
+template <typename Opt, typename F>
+void measure(const std::string& suite, const char* name, const std::vector<Opt>& v, F f)
+{
+  const std::size_t n = v.size();
+  const double ns = bench::time_ns([&] { bench::do_not_optimize(f(v)); }, n);
+  bench::report(suite.c_str(), name, n, ns, sizeof(Opt), double(sizeof(Opt)) / ns);
+}
+
+template <typename EVP>
+void bench_value_or(const char* type, std::size_t n, unsigned empty_pct)
+{
+  typedef typename EVP::value_type T;
+  typedef compact_optional<EVP> opt_t;
+  std::vector<opt_t> v (n);
+  std::vector< std::optional<T> > sv (n);
+  bench::xorshift64 rnd;
+  for (std::size_t i = 0; i != n; ++i)
+  {
+    const std::uint64_t x = rnd();
+    if (x % 100 >= empty_pct)
+    {
+      v[i] = opt_t(T(x >> 48));
+      sv[i] = T(x >> 48);
+    }
+  }
+  const std::string suite = std::string(type) + "_" + std::to_string(empty_pct) + "pct";
+  const T d = T(7);
+
+  measure(suite, "has_value_ternary", v, [&](const std::vector<opt_t>& a) {
+    T s = T();
+    for (const opt_t& o : a)
+      s += o.has_value() ? o.value() : d;
+    return s;
+  });
+  measure(suite, "value_or", v, [&](const std::vector<opt_t>& a) {
+    T s = T();
+    for (const opt_t& o : a)
+      s += o.value_or(d);
+    return s;
+  });
+  measure(suite, "std_optional_value_or", sv, [&](const std::vector< std::optional<T> >& a) {
+    T s = T();
+    for (const std::optional<T>& o : a)
+      s += o.value_or(d);
+    return s;
+  });
+}
+
+void bench_transform(std::size_t n, unsigned empty_pct)
+{
+  typedef compact_optional< evp_int<int, -1> > opt_int;
+  typedef evp_int<long, -1> evp_long;
+  typedef compact_optional<evp_long> opt_long;
+  std::vector<opt_int> v (n);
+  bench::xorshift64 rnd;
+  for (opt_int& o : v)
+  {
+    const std::uint64_t x = rnd();
+    if (x % 100 >= empty_pct)
+      o = opt_int(int(x >> 40));
+  }
+  std::vector<opt_long> out (n);
+  const std::string suite = "transform_" + std::to_string(empty_pct) + "pct";
+  auto f = [](int x) { return long(x) * 3 + 1; };
+
+  measure(suite, "via_std_optional", v, [&](const std::vector<opt_int>& a) {
+    for (std::size_t i = 0; i != a.size(); ++i)
+    {
+      const std::optional<long> t = a[i].has_value() ? std::optional<long>(f(a[i].value())) : std::nullopt;
+      out[i] = t ? opt_long(*t) : opt_long();
+    }
+    return out.data();
+  });
+  measure(suite, "transform", v, [&](const std::vector<opt_int>& a) {
+    for (std::size_t i = 0; i != a.size(); ++i)
+      out[i] = a[i].transform<evp_long>(f);
+    return out.data();
+  });
+}
+
+int main(int argc, char** argv)
+{
+  std::size_t max_n = bench::max_elements(argc, argv, 10000000);
+  bench::print_header();
+  for (std::size_t n = 1000; n <= max_n; n *= 10)
+    for (unsigned pct : { 1u, 50u })
+    {
+      bench_value_or< evp_int<int, -1> >("int", n, pct);
+      bench_value_or< evp_fp_nan<double> >("double", n, pct);
+      bench_transform(n, pct);
+    }
+}
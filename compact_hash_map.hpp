@@ -0,0 +1,307 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef AK_TOOLBOX_COMPACT_HASH_MAP_HEADER_GUARD_
+#define AK_TOOLBOX_COMPACT_HASH_MAP_HEADER_GUARD_
+
+#include "compact_optional.hpp"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace ak_toolbox {
+namespace compact_optional_ns {
+namespace detail_ {
+
+template <typename EVP, typename V>
+struct hash_slot
+{
+  typename EVP::storage_type key;
+  V value;
+};
+
+template <typename EVP>
+struct hash_slot<EVP, void>
+{
+  typename EVP::storage_type key;
+};
+
+// Open-addressing table with linear probing. A slot is free iff its key
+// holds the policy's empty value, so no control bytes are needed; erasure
+// uses backward shifting, so no tombstones are needed either.
+template <typename EVP, typename V, typename Hash>
+class compact_hash_table
+{
+public:
+  typedef typename EVP::value_type key_type;
+  typedef typename EVP::storage_type storage_type;
+  typedef std::size_t size_type;
+
+#ifndef AK_TOOLBOX_NO_ARVANCED_CXX11
+  static_assert(std::is_trivially_copyable<storage_type>::value && std::is_trivially_copyable<key_type>::value,
+                "compact hash tables require a policy with trivially copyable value and storage");
+#endif // AK_TOOLBOX_NO_ARVANCED_CXX11
+
+protected:
+  typedef hash_slot<EVP, V> slot;
+
+  std::vector<slot> slots_;
+  size_type size_;
+  unsigned shift_; // 64 - log2(slots_.size())
+  float max_load_factor_;
+  Hash hash_;
+
+  compact_hash_table() : size_(0), shift_(64), max_load_factor_(0.75f) {}
+
+  size_type mask() const { return slots_.size() - 1; }
+
+  // Fibonacci hashing: std::hash of integers is often the identity,
+  // which would cluster badly if we just masked the low bits
+  size_type home_slot(const key_type& k) const
+  {
+    std::uint64_t h = static_cast<std::uint64_t>(hash_(k)) * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_type>(h >> shift_);
+  }
+
+  static bool is_free(const slot& s) { return EVP::is_empty_value(s.key); }
+  static key_type key_of(const slot& s) { return EVP::access_value(s.key); }
+
+  // returns the slot holding k, or the free slot where k would be inserted
+  size_type probe(const key_type& k) const
+  {
+    size_type i = home_slot(k);
+    while (!is_free(slots_[i]) && !(key_of(slots_[i]) == k))
+      i = (i + 1) & mask();
+    return i;
+  }
+
+  // returns the slot index of k, or slots_.size() if absent
+  size_type locate(const key_type& k) const
+  {
+    if (size_ == 0)
+      return slots_.size();
+    size_type i = probe(k);
+    return is_free(slots_[i]) ? slots_.size() : i;
+  }
+
+  // returns the slot for k, after making room for an insertion if needed;
+  // the empty value cannot be a key: it is reported in the policy's
+  // collision mode, and slots_.size() returned if that does not throw
+  size_type prepare_insert(const key_type& k)
+  {
+    if (EVP::is_empty_value(EVP::store_value(k)))
+    {
+      report_collision<EVP>();
+      return slots_.size();
+    }
+    if (slots_.empty() || float(size_ + 1) > max_load_factor_ * float(slots_.size()))
+      rehash(slots_.empty() ? 16 : slots_.size() * 2);
+    return probe(k);
+  }
+
+  void occupy(size_type i, const key_type& k)
+  {
+    slots_[i].key = EVP::store_value(k);
+    ++size_;
+  }
+
+  void erase_slot(size_type i)
+  {
+    // shift back the following entries that would become unreachable
+    for (size_type j = (i + 1) & mask(); !is_free(slots_[j]); j = (j + 1) & mask())
+    {
+      size_type h = home_slot(key_of(slots_[j]));
+      if (((j - h) & mask()) >= ((j - i) & mask()))
+      {
+        slots_[i] = std::move(slots_[j]);
+        i = j;
+      }
+    }
+    slots_[i] = slot();
+    slots_[i].key = EVP::empty_value();
+    --size_;
+  }
+
+public:
+  size_type size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  size_type bucket_count() const { return slots_.size(); }
+  float load_factor() const { return slots_.empty() ? 0.0f : float(size_) / float(slots_.size()); }
+  std::size_t memory_usage() const { return slots_.size() * sizeof(slot); }
+  float max_load_factor() const { return max_load_factor_; }
+  void max_load_factor(float f) { assert (f > 0.0f && f < 1.0f); max_load_factor_ = f; }
+
+  bool contains(const key_type& k) const { return locate(k) != slots_.size(); }
+  size_type count(const key_type& k) const { return contains(k) ? 1 : 0; }
+
+  // the number of slots inspected by a lookup of k (a diagnostic)
+  size_type probe_length(const key_type& k) const
+  {
+    if (slots_.empty())
+      return 0;
+    return ((probe(k) - home_slot(k)) & mask()) + 1;
+  }
+
+  bool erase(const key_type& k)
+  {
+    size_type i = locate(k);
+    if (i == slots_.size())
+      return false;
+    erase_slot(i);
+    return true;
+  }
+
+  void clear()
+  {
+    for (size_type i = 0; i != slots_.size(); ++i)
+    {
+      slots_[i] = slot();
+      slots_[i].key = EVP::empty_value();
+    }
+    size_ = 0;
+  }
+
+  void reserve(size_type n)
+  {
+    size_type cap = 16;
+    while (float(n) > max_load_factor_ * float(cap))
+      cap *= 2;
+    if (cap > slots_.size())
+      rehash(cap);
+  }
+
+  void rehash(size_type cap) // cap must be a power of two, large enough for size()
+  {
+    assert (cap != 0 && (cap & (cap - 1)) == 0 && size_ < cap);
+    slot free_slot = slot();
+    free_slot.key = EVP::empty_value();
+    std::vector<slot> old (cap, free_slot);
+    old.swap(slots_);
+    for (shift_ = 64; cap > 1; cap /= 2)
+      --shift_;
+    for (size_type i = 0; i != old.size(); ++i)
+      if (!is_free(old[i]))
+        slots_[probe(key_of(old[i]))] = std::move(old[i]);
+  }
+};
+
+} // namespace detail_
+
+// A hash map from K to V, where K is the value_type of a compact-optional
+// policy. Keys equal to the policy's empty value cannot be stored.
+template <typename EVP, typename V, typename Hash = std::hash<typename EVP::value_type> >
+class compact_hash_map : public detail_::compact_hash_table<EVP, V, Hash>
+{
+  typedef detail_::compact_hash_table<EVP, V, Hash> base;
+
+public:
+  typedef typename base::key_type key_type;
+  typedef V mapped_type;
+  typedef typename base::size_type size_type;
+
+  compact_hash_map() {}
+
+  // returns the stored value and whether it has been inserted;
+  // (nullptr, false) if k is the empty value
+  std::pair<V*, bool> insert(const key_type& k, const V& v)
+  {
+    size_type i = this->prepare_insert(k);
+    if (i == this->slots_.size())
+      return std::pair<V*, bool>(nullptr, false);
+    bool inserted = this->is_free(this->slots_[i]);
+    if (inserted)
+    {
+      this->occupy(i, k);
+      this->slots_[i].value = v;
+    }
+    return std::make_pair(&this->slots_[i].value, inserted);
+  }
+
+  // throws sentinel_collision if k is the empty value
+  V& operator[](const key_type& k)
+  {
+    size_type i = this->prepare_insert(k);
+    if (i == this->slots_.size())
+      throw sentinel_collision();
+    if (this->is_free(this->slots_[i]))
+      this->occupy(i, k);
+    return this->slots_[i].value;
+  }
+
+  V* find(const key_type& k)
+  {
+    size_type i = this->locate(k);
+    return i == this->slots_.size() ? nullptr : &this->slots_[i].value;
+  }
+
+  const V* find(const key_type& k) const
+  {
+    size_type i = this->locate(k);
+    return i == this->slots_.size() ? nullptr : &this->slots_[i].value;
+  }
+
+  // calls f(key, value) for every element, in unspecified order
+  template <typename F>
+  void for_each(F f)
+  {
+    for (size_type i = 0; i != this->slots_.size(); ++i)
+      if (!this->is_free(this->slots_[i]))
+        f(this->key_of(this->slots_[i]), this->slots_[i].value);
+  }
+
+  template <typename F>
+  void for_each(F f) const
+  {
+    for (size_type i = 0; i != this->slots_.size(); ++i)
+      if (!this->is_free(this->slots_[i]))
+        f(this->key_of(this->slots_[i]), static_cast<const V&>(this->slots_[i].value));
+  }
+};
+
+// A hash set of values of a compact-optional policy's value_type;
+// the policy's empty value cannot be stored.
+template <typename EVP, typename Hash = std::hash<typename EVP::value_type> >
+class compact_hash_set : public detail_::compact_hash_table<EVP, void, Hash>
+{
+  typedef detail_::compact_hash_table<EVP, void, Hash> base;
+
+public:
+  typedef typename base::key_type key_type;
+  typedef typename base::size_type size_type;
+
+  compact_hash_set() {}
+
+  // returns true iff k has been inserted; false if k is the empty value
+  bool insert(const key_type& k)
+  {
+    size_type i = this->prepare_insert(k);
+    if (i == this->slots_.size() || !this->is_free(this->slots_[i]))
+      return false;
+    this->occupy(i, k);
+    return true;
+  }
+
+  // calls f(key) for every element, in unspecified order
+  template <typename F>
+  void for_each(F f) const
+  {
+    for (size_type i = 0; i != this->slots_.size(); ++i)
+      if (!this->is_free(this->slots_[i]))
+        f(this->key_of(this->slots_[i]));
+  }
+};
+
+} // namespace compact_optional_ns
+
+using compact_optional_ns::compact_hash_map;
+using compact_optional_ns::compact_hash_set;
+
+} // namespace ak_toolbox
+
+#endif //AK_TOOLBOX_COMPACT_HASH_MAP_HEADER_GUARD_
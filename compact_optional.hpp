@@ -11,6 +11,11 @@
 #include <utility>
 #include <limits>
 #include <new>
+#include <cstring>
+#include <cstdint>
+#include <memory>
+#include <functional>
+#include <stdexcept>
 #  include <type_traits>
 
 #if defined AK_TOOLBOX_NO_ARVANCED_CXX11
@@ -18,12 +23,19 @@
 #  define AK_TOOLBOX_CONSTEXPR
 #  define AK_TOOLBOX_EXPLICIT_CONV
 #  define AK_TOOLBOX_NOEXCEPT_AS(E)
+#  define AK_TOOLBOX_NOEXCEPT_IF(C)
+#  define AK_TOOLBOX_CONSTEXPR_NOCONST
 #else
 #  define AK_TOOLBOX_NOEXCEPT noexcept 
 #  define AK_TOOLBOX_CONSTEXPR constexpr 
 #  define AK_TOOLBOX_EXPLICIT_CONV explicit 
 #  define AK_TOOLBOX_NOEXCEPT_AS(E) noexcept(noexcept(E))
-#  define AK_TOOLBOX_CONSTEXPR_NOCONST // fix in the future
+#  define AK_TOOLBOX_NOEXCEPT_IF(C) noexcept(C)
+#  if __cplusplus >= 201402L
+#    define AK_TOOLBOX_CONSTEXPR_NOCONST constexpr
+#  else
+#    define AK_TOOLBOX_CONSTEXPR_NOCONST // in C++11 constexpr member functions are implicitly const
+#  endif
 #endif
 
 #if defined NDEBUG
@@ -49,6 +61,48 @@ namespace compact_optional_ns {
 
 struct default_tag{};
 
+// selects the constructors of compact_optional that build the value from arguments
+struct in_place_t {};
+#ifndef AK_TOOLBOX_NO_ARVANCED_CXX11
+constexpr in_place_t in_place {};
+#else
+const in_place_t in_place = in_place_t();
+#endif // AK_TOOLBOX_NO_ARVANCED_CXX11
+
+// What to do when a value stored in compact_optional turns out to be the
+// empty value, e.g. opt_int{-1}: nothing (the object silently becomes empty),
+// fail an assertion, throw sentinel_collision, or count it. Counting also
+// counts value() on empty objects, constructions, copies and moves; it is
+// defined in compact_optional_counters.hpp. A policy selects its mode with
+// `typedef check_throw collision_check;`; the others use
+// AK_TOOLBOX_COLLISION_CHECK, which defaults to check_ignore.
+struct check_ignore {};
+struct check_assert;
+struct check_throw;
+struct check_count;
+
+#ifndef AK_TOOLBOX_COLLISION_CHECK
+# define AK_TOOLBOX_COLLISION_CHECK check_ignore
+#endif
+
+class sentinel_collision : public std::logic_error
+{
+public:
+  sentinel_collision() : std::logic_error("compact_optional: stored value equals the empty value") {}
+};
+
+struct check_assert
+{
+  template <typename EVP>
+  static void collision() { assert (false && "compact_optional: stored value equals the empty value"); }
+};
+
+struct check_throw
+{
+  template <typename EVP>
+  static void collision() { throw sentinel_collision(); }
+};
+
 template <typename T, typename NT = T, typename CREF = const T&>
 struct compact_optional_type
 {
@@ -68,6 +122,28 @@ struct evp_int : compact_optional_type<T>
   static AK_TOOLBOX_CONSTEXPR bool is_empty_value(T v) { return v == Val; }
 };
 
+// Several spare values: the first one is the empty value, the remaining ones
+// are left for nesting, so that compact_optional<compact_optional<evp_int_multi<T, V1, V2>>>
+// has the same size as T. All of them are treated as empty by is_empty_value.
+template <typename T, T Val, T... Spare>
+struct evp_int_multi;
+
+template <typename T, T Val>
+struct evp_int_multi<T, Val> : compact_optional_type<T>
+{
+  static AK_TOOLBOX_CONSTEXPR T empty_value() AK_TOOLBOX_NOEXCEPT { return Val; }
+  static AK_TOOLBOX_CONSTEXPR bool is_empty_value(T v) { return v == Val; }
+};
+
+template <typename T, T Val, T Spare, T... Rest>
+struct evp_int_multi<T, Val, Spare, Rest...> : compact_optional_type<T>
+{
+  typedef evp_int_multi<T, Spare, Rest...> spare_policy;
+  
+  static AK_TOOLBOX_CONSTEXPR T empty_value() AK_TOOLBOX_NOEXCEPT { return Val; }
+  static AK_TOOLBOX_CONSTEXPR bool is_empty_value(T v) { return v == Val || spare_policy::is_empty_value(v); }
+};
+
 // for backward compatibility only:
 template <typename T, T Val>
 struct empty_scalar_value : compact_optional_type<T>
@@ -103,12 +179,12 @@ struct evp_optional : compact_optional_type<typename OT::value_type, OT>
   typedef typename OT::value_type value_type;
   typedef OT storage_type;
 
-  static OT empty_value() AK_TOOLBOX_NOEXCEPT { return OT(); }
-  static bool is_empty_value(const OT& v) { return !v; }
+  static AK_TOOLBOX_CONSTEXPR OT empty_value() AK_TOOLBOX_NOEXCEPT { return OT(); }
+  static AK_TOOLBOX_CONSTEXPR bool is_empty_value(const OT& v) { return !v; }
   
-  static const value_type& access_value(const storage_type& v) { return *v; }
-  static storage_type store_value(const value_type& v) { return v; }
-  static storage_type store_value(value_type&& v) { return std::move(v); }
+  static AK_TOOLBOX_CONSTEXPR const value_type& access_value(const storage_type& v) { return *v; }
+  static AK_TOOLBOX_CONSTEXPR storage_type store_value(const value_type& v) { return v; }
+  static AK_TOOLBOX_CONSTEXPR storage_type store_value(value_type&& v) { return std::move(v); }
 };
 
 // for backwards compatibility only:
@@ -118,12 +194,12 @@ struct compact_optional_from_optional : compact_optional_type<typename OT::value
   typedef typename OT::value_type value_type;
   typedef OT storage_type;
 
-  static OT empty_value() AK_TOOLBOX_NOEXCEPT { return OT(); }
-  static bool is_empty_value(const OT& v) { return !v; }
+  static AK_TOOLBOX_CONSTEXPR OT empty_value() AK_TOOLBOX_NOEXCEPT { return OT(); }
+  static AK_TOOLBOX_CONSTEXPR bool is_empty_value(const OT& v) { return !v; }
   
-  static const value_type& access_value(const storage_type& v) { return *v; }
-  static storage_type store_value(const value_type& v) { return v; }
-  static storage_type store_value(value_type&& v) { return std::move(v); }
+  static AK_TOOLBOX_CONSTEXPR const value_type& access_value(const storage_type& v) { return *v; }
+  static AK_TOOLBOX_CONSTEXPR storage_type store_value(const value_type& v) { return v; }
+  static AK_TOOLBOX_CONSTEXPR storage_type store_value(value_type&& v) { return std::move(v); }
 };
 
 struct evp_bool : compact_optional_type<bool, char, bool>
@@ -137,6 +213,39 @@ struct evp_bool : compact_optional_type<bool, char, bool>
 
 typedef evp_bool compact_bool;
 
+// for raw and smart pointers, where the null pointer represents no value
+template <typename Ptr>
+struct evp_nullptr : compact_optional_type<Ptr>
+{
+  static Ptr empty_value() AK_TOOLBOX_NOEXCEPT { return Ptr(); }
+  static bool is_empty_value(const Ptr& p) { return p == nullptr; }
+};
+
+// for raw pointers, where null is a valid value: the empty state is an odd
+// address, which no pointer to a T with alignment of 2 or more can hold
+template <typename T>
+struct evp_misaligned_ptr : compact_optional_type<T*, std::uintptr_t, T*>
+{
+  static_assert(alignof(T) >= 2, "evp_misaligned_ptr requires T with alignment of at least 2");
+  
+  static AK_TOOLBOX_CONSTEXPR std::uintptr_t empty_value() AK_TOOLBOX_NOEXCEPT { return 1; }
+  static AK_TOOLBOX_CONSTEXPR bool is_empty_value(std::uintptr_t v) { return (v & 1u) != 0; }
+  
+  static T* access_value(std::uintptr_t v) { return reinterpret_cast<T*>(v); }
+  static std::uintptr_t store_value(T* p) { return reinterpret_cast<std::uintptr_t>(p); }
+};
+
+// for std::reference_wrapper, stored as a pointer, where null represents no value
+template <typename T>
+struct evp_reference_wrapper : compact_optional_type<std::reference_wrapper<T>, T*, std::reference_wrapper<T>>
+{
+  static AK_TOOLBOX_CONSTEXPR T* empty_value() AK_TOOLBOX_NOEXCEPT { return nullptr; }
+  static AK_TOOLBOX_CONSTEXPR bool is_empty_value(T* p) { return p == nullptr; }
+  
+  static std::reference_wrapper<T> access_value(T* p) { return std::reference_wrapper<T>(*p); }
+  static T* store_value(std::reference_wrapper<T> r) { return std::addressof(r.get()); }
+};
+
 
 struct compact_optional_pod_storage_type_tag{};
 
@@ -169,9 +278,14 @@ struct evp_enum : compact_optional_pod_storage_type<Enum, typename std::underlyi
   static_assert(std::is_enum<Enum>::value, "evp_enum only works with enum types");
   typedef compact_optional_pod_storage_type<Enum, typename std::underlying_type<Enum>::type> base;
   typedef typename base::storage_type storage_type;
+  typedef Enum reference_type;
   
-  static storage_type empty_value() { return Val; }
-  static bool is_empty_value(const storage_type& v) { return v == Val; }
+  static AK_TOOLBOX_CONSTEXPR storage_type empty_value() AK_TOOLBOX_NOEXCEPT { return Val; }
+  static AK_TOOLBOX_CONSTEXPR bool is_empty_value(const storage_type& v) { return v == Val; }
+  
+  // conversions rather than reinterpret_cast, so that they work in constant expressions
+  static AK_TOOLBOX_CONSTEXPR Enum access_value(const storage_type& v) { return static_cast<Enum>(v); }
+  static AK_TOOLBOX_CONSTEXPR storage_type store_value(Enum e) { return static_cast<storage_type>(e); }
 };
 #else
 template <typename Enum, int Val> 
@@ -179,14 +293,260 @@ struct evp_enum : compact_optional_pod_storage_type<Enum, int>
 {
   typedef compact_optional_pod_storage_type<Enum, int> base;
   typedef typename base::storage_type storage_type;
+  typedef Enum reference_type;
+  
+  static AK_TOOLBOX_CONSTEXPR storage_type empty_value() AK_TOOLBOX_NOEXCEPT { return Val; }
+  static AK_TOOLBOX_CONSTEXPR bool is_empty_value(const storage_type& v) { return v == Val; }
   
-  static storage_type empty_value() { return Val; }
-  static bool is_empty_value(const storage_type& v) { return v == Val; }
+  // conversions rather than reinterpret_cast, so that they work in constant expressions
+  static AK_TOOLBOX_CONSTEXPR Enum access_value(const storage_type& v) { return static_cast<Enum>(v); }
+  static AK_TOOLBOX_CONSTEXPR storage_type store_value(Enum e) { return static_cast<storage_type>(e); }
 };
 #endif // AK_TOOLBOX_NO_UNDERLYING_TYPE
 
 namespace detail_ {
 
+template <std::size_t Size, bool Unsigned> struct integer_of_size;
+template <> struct integer_of_size<1, false> { typedef std::int8_t type; };
+template <> struct integer_of_size<1, true> { typedef std::uint8_t type; };
+template <> struct integer_of_size<2, false> { typedef std::int16_t type; };
+template <> struct integer_of_size<2, true> { typedef std::uint16_t type; };
+template <> struct integer_of_size<4, false> { typedef std::int32_t type; };
+template <> struct integer_of_size<4, true> { typedef std::uint32_t type; };
+template <> struct integer_of_size<8, false> { typedef std::int64_t type; };
+template <> struct integer_of_size<8, true> { typedef std::uint64_t type; };
+
+// Whether Enum's values are unsigned, without std::underlying_type: scoped
+// enums have a fixed underlying type, so -1 converts to its maximum; an
+// unscoped enum tells by the type it promotes to.
+template <typename Enum, bool = std::is_convertible<Enum, int>::value>
+struct enum_is_unsigned : std::integral_constant<bool, !(static_cast<Enum>(-1) < static_cast<Enum>(0))> {};
+
+template <typename Enum>
+struct enum_is_unsigned<Enum, true> : std::is_unsigned<decltype(+Enum())> {};
+
+// An integer type that holds the values of Enum: its underlying type, or
+// without std::underlying_type the integer of the same size and signedness.
+#ifndef AK_TOOLBOX_NO_UNDERLYING_TYPE
+template <typename Enum>
+struct enum_integer { typedef typename std::underlying_type<Enum>::type type; };
+#else
+template <typename Enum>
+struct enum_integer : integer_of_size<sizeof(Enum), enum_is_unsigned<Enum>::value> {};
+#endif // AK_TOOLBOX_NO_UNDERLYING_TYPE
+
+} // namespace detail_
+
+// Customization point: specialize niche_traits<T> with a nested `policy` to
+// tell auto_evp<T> how to represent an optional T without extra storage.
+template <typename T, typename = void>
+struct niche_traits {};
+
+template <>
+struct niche_traits<bool> { typedef evp_bool policy; };
+
+template <typename FPT>
+struct niche_traits<FPT, typename std::enable_if<std::is_floating_point<FPT>::value>::type>
+{
+  typedef evp_fp_nan<FPT> policy;
+};
+
+template <typename T>
+struct niche_traits<T*>
+{
+  // keep null as a value when alignment leaves a spare bit
+  typedef typename std::conditional<(alignof(T) >= 2), evp_misaligned_ptr<T>, evp_nullptr<T*>>::type policy;
+};
+
+template <>
+struct niche_traits<void*> { typedef evp_nullptr<void*> policy; };
+
+template <>
+struct niche_traits<const void*> { typedef evp_nullptr<const void*> policy; };
+
+template <typename T, typename D>
+struct niche_traits< std::unique_ptr<T, D> > { typedef evp_nullptr< std::unique_ptr<T, D> > policy; };
+
+template <typename T>
+struct niche_traits< std::shared_ptr<T> > { typedef evp_nullptr< std::shared_ptr<T> > policy; };
+
+template <typename T>
+struct niche_traits< std::reference_wrapper<T> > { typedef evp_reference_wrapper<T> policy; };
+
+namespace detail_ {
+
+template <typename T>
+struct void_t_ { typedef void type; };
+
+template <typename T, typename = void>
+struct niche_policy
+{
+  static_assert(sizeof(T) == 0, "no niche known for T: specialize niche_traits<T> or use an explicit policy");
+};
+
+template <typename T>
+struct niche_policy<T, typename std::conditional<true, void, typename niche_traits<T>::policy>::type>
+{
+  typedef typename niche_traits<T>::policy type;
+};
+
+} // namespace detail_
+
+// the zero-overhead policy for T, as selected by niche_traits<T>
+template <typename T>
+struct auto_evp : detail_::niche_policy<T>::type {};
+
+namespace detail_ {
+
+// Optional policy hook: `static void mark_empty(storage_type& s)` makes s
+// represent the empty value by writing only the bytes that is_empty_value
+// inspects. Without it, the whole of empty_value() is assigned.
+template <typename EVP, typename = void>
+struct has_mark_empty : std::false_type {};
+
+template <typename EVP>
+struct has_mark_empty<EVP, typename void_t_<decltype(EVP::mark_empty(std::declval<typename EVP::storage_type&>()))>::type>
+  : std::true_type {};
+
+template <typename EVP>
+void fill_empty_value(typename EVP::storage_type& s, std::true_type)
+  AK_TOOLBOX_NOEXCEPT_AS(EVP::mark_empty(s))
+{
+  EVP::mark_empty(s);
+}
+
+template <typename EVP>
+AK_TOOLBOX_CONSTEXPR_NOCONST void fill_empty_value(typename EVP::storage_type& s, std::false_type)
+  AK_TOOLBOX_NOEXCEPT_AS(s = EVP::empty_value())
+{
+  s = EVP::empty_value();
+}
+
+template <typename EVP>
+AK_TOOLBOX_CONSTEXPR_NOCONST void fill_empty_value(typename EVP::storage_type& s)
+  AK_TOOLBOX_NOEXCEPT_AS(fill_empty_value<EVP>(s, has_mark_empty<EVP>()))
+{
+  fill_empty_value<EVP>(s, has_mark_empty<EVP>());
+}
+
+// Optional policy hook: `typedef check_xxx collision_check;`
+template <typename EVP, typename = void>
+struct collision_check_of { typedef AK_TOOLBOX_COLLISION_CHECK type; };
+
+template <typename EVP>
+struct collision_check_of<EVP, typename void_t_<typename EVP::collision_check>::type>
+{
+  typedef typename EVP::collision_check type;
+};
+
+// With check_ignore none of the checks below is even compiled.
+template <typename EVP>
+struct checks_collisions
+  : std::integral_constant<bool, !std::is_same<typename collision_check_of<EVP>::type, check_ignore>::value> {};
+
+template <typename EVP>
+struct counts_operations
+  : std::integral_constant<bool, std::is_same<typename collision_check_of<EVP>::type, check_count>::value> {};
+
+template <typename EVP, typename S>
+AK_TOOLBOX_CONSTEXPR S checked_store(S s)
+{
+  return EVP::is_empty_value(s) ? (collision_check_of<EVP>::type::template collision<EVP>(), static_cast<S&&>(s))
+                                : static_cast<S&&>(s);
+}
+
+// reports a collision in EVP's mode; does nothing with check_ignore
+template <typename EVP>
+void report_collision(std::false_type) {}
+
+template <typename EVP>
+void report_collision(std::true_type) { collision_check_of<EVP>::type::template collision<EVP>(); }
+
+template <typename EVP>
+void report_collision() { report_collision<EVP>(checks_collisions<EVP>()); }
+
+template <typename EVP>
+AK_TOOLBOX_CONSTEXPR const typename EVP::storage_type& noted_access(const typename EVP::storage_type& s, std::false_type)
+{
+  return s;
+}
+
+template <typename EVP>
+AK_TOOLBOX_CONSTEXPR const typename EVP::storage_type& noted_access(const typename EVP::storage_type& s, std::true_type)
+{
+  return EVP::is_empty_value(s) ? (collision_check_of<EVP>::type::template empty_access<EVP>(), s) : s;
+}
+
+#ifndef AK_TOOLBOX_NO_ARVANCED_CXX11
+namespace swap_adl_ {
+  using std::swap;
+  
+  template <typename T>
+  struct is_nothrow_swappable
+  {
+    static const bool value = noexcept(swap(std::declval<T&>(), std::declval<T&>()));
+  };
+} // namespace swap_adl_
+
+using swap_adl_::is_nothrow_swappable;
+
+template <typename EVP>
+struct is_nothrow_empty_value
+{
+  static const bool value = noexcept(typename EVP::storage_type(EVP::empty_value()))
+                            && noexcept(fill_empty_value<EVP>(std::declval<typename EVP::storage_type&>()));
+};
+#else
+template <typename T>
+struct is_nothrow_swappable { static const bool value = false; };
+
+template <typename EVP>
+struct is_nothrow_empty_value { static const bool value = false; };
+#endif // AK_TOOLBOX_NO_ARVANCED_CXX11
+
+// If the value type has trivial copy and destruction, manual life-time
+// management is not needed: POD storage is then held like any other member,
+// and compact_optional is trivially copyable whenever storage_type is.
+template <typename T>
+struct is_trivial_value
+{
+#ifndef AK_TOOLBOX_NO_IS_TRIVIALLY_COPYABLE
+  static const bool value = std::is_trivially_copyable<T>::value && std::is_trivially_destructible<T>::value;
+#else
+  static const bool value = false;
+#endif // AK_TOOLBOX_NO_IS_TRIVIALLY_COPYABLE
+};
+
+// std::swap is not constexpr before C++20: trivial values are swapped by hand,
+// which is usable in constant expressions since C++14
+template <typename T>
+AK_TOOLBOX_CONSTEXPR_NOCONST void swap_values(T& l, T& r, std::integral_constant<bool, true>)
+{
+  T tmp = l;
+  l = r;
+  r = tmp;
+}
+
+template <typename T>
+void swap_values(T& l, T& r, std::integral_constant<bool, false>)
+{
+  using namespace std;
+  swap(l, r);
+}
+
+// Builds the storage for a value constructed from args: directly, when the
+// value is stored as itself; otherwise through the policy's store_value.
+template <typename EVP, typename... Args>
+AK_TOOLBOX_CONSTEXPR typename EVP::storage_type make_storage(std::true_type, Args&&... args)
+{
+  return typename EVP::storage_type(std::forward<Args>(args)...);
+}
+
+template <typename EVP, typename... Args>
+AK_TOOLBOX_CONSTEXPR typename EVP::storage_type make_storage(std::false_type, Args&&... args)
+{
+  return EVP::store_value(typename EVP::value_type(std::forward<Args>(args)...));
+}
 
 template <typename EVP>
 struct member_storage
@@ -197,19 +557,106 @@ struct member_storage
   
   storage_type value_;
   
-  AK_TOOLBOX_CONSTEXPR member_storage() AK_TOOLBOX_NOEXCEPT_AS(storage_type(EVP::empty_value()))
-    : value_(EVP::empty_value()) {}
+  AK_TOOLBOX_CONSTEXPR member_storage() AK_TOOLBOX_NOEXCEPT_IF(is_nothrow_empty_value<EVP>::value)
+    : member_storage(has_mark_empty<EVP>()) {}
     
   AK_TOOLBOX_CONSTEXPR member_storage(const value_type& v)
-    : value_(EVP::store_value(v)) {}
+    : member_storage(check_tag(), v) {}
     
   AK_TOOLBOX_CONSTEXPR member_storage(value_type&& v)
+    : member_storage(check_tag(), std::move(v)) {}
+    
+  template <typename... Args>
+  AK_TOOLBOX_CONSTEXPR explicit member_storage(in_place_t, Args&&... args)
+    : member_storage(check_tag(), in_place, std::forward<Args>(args)...) {}
+    
+private:
+  AK_TOOLBOX_CONSTEXPR explicit member_storage(std::false_type)
+    : value_(EVP::empty_value()) {}
+    
+  explicit member_storage(std::true_type)
+    { EVP::mark_empty(value_); }
+    
+  typedef std::integral_constant<bool, std::is_same<value_type, storage_type>::value> stored_as_value;
+  typedef std::integral_constant<bool, checks_collisions<EVP>::value> check_tag;
+  
+  AK_TOOLBOX_CONSTEXPR member_storage(std::false_type, const value_type& v)
+    : value_(EVP::store_value(v)) {}
+    
+  AK_TOOLBOX_CONSTEXPR member_storage(std::true_type, const value_type& v)
+    : value_(checked_store<EVP>(EVP::store_value(v))) {}
+    
+  AK_TOOLBOX_CONSTEXPR member_storage(std::false_type, value_type&& v)
     : value_(EVP::store_value(std::move(v))) {}
     
-  void swap_impl(member_storage& rhs)
+  AK_TOOLBOX_CONSTEXPR member_storage(std::true_type, value_type&& v)
+    : value_(checked_store<EVP>(EVP::store_value(std::move(v)))) {}
+    
+  template <typename... Args>
+  AK_TOOLBOX_CONSTEXPR member_storage(std::false_type, in_place_t, Args&&... args)
+    : value_(make_storage<EVP>(stored_as_value(), std::forward<Args>(args)...)) {}
+    
+  template <typename... Args>
+  AK_TOOLBOX_CONSTEXPR member_storage(std::true_type, in_place_t, Args&&... args)
+    : value_(checked_store<EVP>(make_storage<EVP>(stored_as_value(), std::forward<Args>(args)...))) {}
+    
+  AK_TOOLBOX_CONSTEXPR_NOCONST void check_stored(std::false_type) {}
+  
+  AK_TOOLBOX_CONSTEXPR_NOCONST void check_stored(std::true_type)
   {
-    using namespace std;
-    swap(value_, rhs.value_);
+    if (EVP::is_empty_value(value_))
+      collision_check_of<EVP>::type::template collision<EVP>();
+  }
+  
+  // Rebuilding value_ in place is only safe if that cannot throw: the storage
+  // must always hold a live object. Trivial storage is simply assigned.
+  template <typename... Args>
+  struct rebuild_in_place
+  {
+    static const bool value = stored_as_value::value && !is_trivial_value<storage_type>::value
+#ifndef AK_TOOLBOX_NO_ARVANCED_CXX11
+                              && std::is_nothrow_constructible<storage_type, Args...>::value
+#else
+                              && false
+#endif // AK_TOOLBOX_NO_ARVANCED_CXX11
+                              ;
+  };
+  
+  template <typename... Args>
+  void emplace_impl(std::true_type, Args&&... args)
+  {
+    value_.~storage_type();
+    ::new (static_cast<void*>(std::addressof(value_))) storage_type(std::forward<Args>(args)...);
+    check_stored(check_tag());
+  }
+  
+  template <typename... Args>
+  AK_TOOLBOX_CONSTEXPR_NOCONST void emplace_impl(std::false_type, Args&&... args)
+  {
+    value_ = make_storage<EVP>(stored_as_value(), std::forward<Args>(args)...);
+    check_stored(check_tag());
+  }
+  
+public:
+  template <typename... Args>
+  AK_TOOLBOX_CONSTEXPR_NOCONST void emplace(Args&&... args)
+  {
+    emplace_impl(std::integral_constant<bool, rebuild_in_place<Args...>::value>(), std::forward<Args>(args)...);
+  }
+  
+  AK_TOOLBOX_CONSTEXPR_NOCONST void assign_impl(const value_type& v)
+    { value_ = EVP::store_value(v); check_stored(check_tag()); }
+  AK_TOOLBOX_CONSTEXPR_NOCONST void assign_impl(value_type&& v)
+    { value_ = EVP::store_value(std::move(v)); check_stored(check_tag()); }
+    
+  AK_TOOLBOX_CONSTEXPR_NOCONST void swap_impl(member_storage& rhs) AK_TOOLBOX_NOEXCEPT_IF(is_nothrow_swappable<storage_type>::value)
+  {
+    swap_values(value_, rhs.value_, std::integral_constant<bool, is_trivial_value<storage_type>::value>());
+  }
+  
+  AK_TOOLBOX_CONSTEXPR_NOCONST void reset_impl() AK_TOOLBOX_NOEXCEPT_IF(is_nothrow_empty_value<EVP>::value)
+  {
+    fill_empty_value<EVP>(value_);
   }
 };
 
@@ -223,35 +670,71 @@ struct buffer_storage
   storage_type value_;
   
 private:
+  typedef std::integral_constant<bool, checks_collisions<EVP>::value> check_tag;
+
   void* address() { return static_cast<void*>(std::addressof(value_)); }
-  void construct(const value_type& v) { ::new (address()) value_type(v); }
-  void construct(value_type&& v) { ::new (address()) value_type(std::move(v)); }
+  template <typename... Args>
+  void construct(Args&&... args)
+  {
+    ::new (address()) value_type(std::forward<Args>(args)...);
+    check_stored(check_tag());
+  }
+  void check_stored(std::false_type) {}
+  // The representation is only known once the value is built. A value that
+  // reads as empty is destroyed and the empty value written, so that the
+  // object is really empty (and nothing leaks) before the collision is
+  // reported, which may throw.
+  void check_stored(std::true_type)
+  {
+    if (!has_value())
+    {
+      destroy();
+      collision_check_of<EVP>::type::template collision<EVP>();
+    }
+  }
   void call_destructor() { as_value_type().value_type::~value_type(); }
-  void destroy() { call_destructor(); value_ = EVP::empty_value(); } // TODO: "fill_empty_value_pattern"
+  void destroy() { call_destructor(); fill_empty_value<EVP>(value_); }
   bool has_value() const { return !EVP::is_empty_value(value_); }
+  
+  static const bool nothrow_move = std::is_nothrow_move_constructible<value_type>::value
+                                   && is_nothrow_empty_value<EVP>::value;
+  static const bool nothrow_move_assign = nothrow_move && std::is_nothrow_move_assignable<value_type>::value;
+  static const bool nothrow_swap = nothrow_move && is_nothrow_swappable<value_type>::value;
+  
   value_type& as_value_type() { return reinterpret_cast<value_type&>(value_); }
   const value_type& as_value_type() const { return reinterpret_cast<const value_type&>(value_); }
   
 public:
-  buffer_storage() AK_TOOLBOX_NOEXCEPT_AS(storage_type(EVP::empty_value()))
-    : value_(EVP::empty_value()) {}
+  // value_ is POD: it is left uninitialized until either a value is
+  // constructed in it or the empty value is written
+  
+  buffer_storage() AK_TOOLBOX_NOEXCEPT_IF(is_nothrow_empty_value<EVP>::value)
+    { fill_empty_value<EVP>(value_); }
     
-  buffer_storage(const value_type& v) : value_(EVP::empty_value())
+  buffer_storage(const value_type& v)
     { construct(v); }
     
-  buffer_storage(value_type&& v) : value_(EVP::empty_value())
+  buffer_storage(value_type&& v)
     { construct(std::move(v)); }
     
-  buffer_storage(const buffer_storage& rhs) : value_(EVP::empty_value())
+  template <typename... Args>
+  explicit buffer_storage(in_place_t, Args&&... args)
+    { construct(std::forward<Args>(args)...); }
+    
+  buffer_storage(const buffer_storage& rhs)
     {
       if (rhs.has_value())
         construct(rhs.as_value_type());
+      else
+        fill_empty_value<EVP>(value_);
     }
     
-  buffer_storage(buffer_storage&& rhs) : value_(EVP::empty_value())
+  buffer_storage(buffer_storage&& rhs) AK_TOOLBOX_NOEXCEPT_IF(nothrow_move)
     {
       if (rhs.has_value())
-        construct(std::move(rhs.as_value_type())); // TODO: add move
+        construct(std::move(rhs.as_value_type()));
+      else
+        fill_empty_value<EVP>(value_);
     }
     
   void operator=(const buffer_storage& rhs)
@@ -270,7 +753,7 @@ public:
       }
     }
     
-  void operator=(buffer_storage&& rhs)
+  void operator=(buffer_storage&& rhs) AK_TOOLBOX_NOEXCEPT_IF(nothrow_move_assign)
     {
       if (has_value() && rhs.has_value())
       {
@@ -286,7 +769,7 @@ public:
       }
     }
     
-  void swap_impl(buffer_storage& rhs)
+  void swap_impl(buffer_storage& rhs) AK_TOOLBOX_NOEXCEPT_IF(nothrow_swap)
   {
     using namespace std;
     if (has_value() && rhs.has_value())
@@ -305,34 +788,183 @@ public:
     }
   }
     
+  void reset_impl()
+  {
+    if (has_value())
+      destroy();
+  }
+  
+  // if construction throws, the object is left empty
+  template <typename... Args>
+  void emplace(Args&&... args)
+  {
+    reset_impl();
+    construct(std::forward<Args>(args)...);
+  }
+  
+  template <typename V>
+  void assign_impl(V&& v)
+  {
+    if (has_value())
+    {
+      as_value_type() = std::forward<V>(v);
+      check_stored(check_tag());
+    }
+    else
+      construct(std::forward<V>(v));
+  }
+    
   ~buffer_storage()
   {
     if (has_value())
       call_destructor();
   }
-  // TODO: implement moves and copies, swap, dtor
 };
 
 template <typename T>
 struct storage_destruction
 {
 
-  typedef typename std::conditional<std::is_base_of<compact_optional_pod_storage_type_tag, T>::value,
+  typedef typename std::conditional<std::is_base_of<compact_optional_pod_storage_type_tag, T>::value
+                                    && !is_trivial_value<typename T::value_type>::value,
                                     buffer_storage<T>, 
                                     member_storage<T>>::type type;
 };
 
+// Used instead of the storage when N's collision_check is check_count.
+template <typename Base, typename N>
+struct counted_storage : Base
+{
+  typedef typename N::value_type value_type;
+  typedef typename collision_check_of<N>::type counter;
+  
+  counted_storage() AK_TOOLBOX_NOEXCEPT_AS(Base())
+    : Base() { counter::template constructed<N>(); }
+    
+  counted_storage(const value_type& v)
+    : Base(v) { counter::template constructed<N>(); }
+    
+  counted_storage(value_type&& v)
+    : Base(std::move(v)) { counter::template constructed<N>(); }
+    
+  template <typename... Args>
+  explicit counted_storage(in_place_t, Args&&... args)
+    : Base(in_place, std::forward<Args>(args)...) { counter::template constructed<N>(); }
+    
+  counted_storage(const counted_storage& rhs)
+    : Base(rhs) { counter::template copied<N>(); }
+    
+  counted_storage(counted_storage&& rhs) AK_TOOLBOX_NOEXCEPT_IF(std::is_nothrow_move_constructible<Base>::value)
+    : Base(std::move(rhs)) { counter::template moved<N>(); }
+    
+  counted_storage& operator=(const counted_storage& rhs)
+  {
+    Base::operator=(rhs);
+    counter::template copied<N>();
+    return *this;
+  }
+  
+  counted_storage& operator=(counted_storage&& rhs) AK_TOOLBOX_NOEXCEPT_IF(std::is_nothrow_move_assignable<Base>::value)
+  {
+    Base::operator=(std::move(rhs));
+    counter::template moved<N>();
+    return *this;
+  }
+};
+
+template <typename N>
+struct counted_storage_of
+{
+  typedef typename std::conditional<counts_operations<N>::value,
+                                    counted_storage<typename storage_destruction<N>::type, N>,
+                                    typename storage_destruction<N>::type>::type type;
+};
+
+// value_or for a storage s: `empty ? store_value(v) : s`. Where both the
+// storage and the value are arithmetic or enumerations, this is a select
+// computed with a bit mask, so the compiler has no branch to emit.
+template <typename N>
+struct is_select_policy : std::integral_constant<bool,
+     (std::is_arithmetic<typename N::storage_type>::value || std::is_enum<typename N::storage_type>::value)
+  && (std::is_arithmetic<typename N::value_type>::value || std::is_enum<typename N::value_type>::value)>
+{};
+
+template <typename N, typename = void>
+struct value_or_select
+{
+  typedef typename N::value_type value_type;
+  typedef typename N::storage_type storage_type;
+
+  template <typename U>
+  static AK_TOOLBOX_CONSTEXPR value_type get(const storage_type& s, U&& v)
+  {
+    return N::is_empty_value(s) ? static_cast<value_type>(std::forward<U>(v)) : value_type(N::access_value(s));
+  }
+};
+
+template <typename N>
+struct value_or_select<N, typename std::enable_if<is_select_policy<N>::value
+                                                  && std::is_integral<typename N::storage_type>::value
+                                                  && !std::is_same<typename N::storage_type, bool>::value>::type>
+{
+  typedef typename N::value_type value_type;
+  typedef typename N::storage_type storage_type;
+  typedef typename std::make_unsigned<storage_type>::type bits;
+
+  static AK_TOOLBOX_CONSTEXPR bits blend(bits s, bits d, bits mask) { return bits((s & bits(~mask)) | (d & mask)); }
+
+  template <typename U>
+  static AK_TOOLBOX_CONSTEXPR value_type get(const storage_type& s, U&& v)
+  {
+    return N::access_value(static_cast<storage_type>(blend(bits(s),
+                                                           bits(N::store_value(static_cast<value_type>(std::forward<U>(v)))),
+                                                           bits(bits(0) - bits(N::is_empty_value(s))))));
+  }
+};
+
+template <std::size_t Size> struct unsigned_of_size;
+template <> struct unsigned_of_size<4> { typedef std::uint32_t type; };
+template <> struct unsigned_of_size<8> { typedef std::uint64_t type; };
+
+template <typename N>
+struct value_or_select<N, typename std::enable_if<is_select_policy<N>::value
+                                                  && std::is_floating_point<typename N::storage_type>::value
+                                                  && (sizeof(typename N::storage_type) == 4
+                                                      || sizeof(typename N::storage_type) == 8)>::type>
+{
+  typedef typename N::value_type value_type;
+  typedef typename N::storage_type storage_type;
+  typedef typename unsigned_of_size<sizeof(storage_type)>::type bits;
+
+  template <typename U>
+  static value_type get(const storage_type& s, U&& v)
+  {
+    const storage_type d = N::store_value(static_cast<value_type>(std::forward<U>(v)));
+    bits bs, bd;
+    std::memcpy(&bs, &s, sizeof(bits));
+    std::memcpy(&bd, &d, sizeof(bits));
+    const bits mask = bits(0) - bits(N::is_empty_value(s));
+    const bits r = (bs & ~mask) | (bd & mask);
+    storage_type out;
+    std::memcpy(&out, &r, sizeof(bits));
+    return N::access_value(out);
+  }
+};
+
 template <typename N>
-class compact_optional_base : storage_destruction<N>::type
+class compact_optional_base : counted_storage_of<N>::type
 {
-  typedef typename storage_destruction<N>::type base;
-  base& as_base() { return static_cast<base&>(*this); }
+  typedef typename counted_storage_of<N>::type base;
   
 protected:
+  AK_TOOLBOX_CONSTEXPR_NOCONST base& as_base() { return static_cast<base&>(*this); }
+  
   typedef typename N::value_type value_type;
   typedef typename N::storage_type storage_type;
   typedef typename N::reference_type reference_type;
-  void swap_storages(compact_optional_base& rhs) { as_base().swap_impl(rhs.as_base()); }
+  AK_TOOLBOX_CONSTEXPR_NOCONST void swap_storages(compact_optional_base& rhs)
+    AK_TOOLBOX_NOEXCEPT_AS(std::declval<base&>().swap_impl(std::declval<base&>()))
+    { as_base().swap_impl(rhs.as_base()); }
   
   AK_TOOLBOX_CONSTEXPR_NOCONST storage_type& raw_value() { return base::value_; }
   
@@ -346,27 +978,83 @@ public:
   AK_TOOLBOX_CONSTEXPR compact_optional_base(value_type&& v)
     : base(std::move(v)) {}
     
+  template <typename... Args>
+  AK_TOOLBOX_CONSTEXPR explicit compact_optional_base(in_place_t, Args&&... args)
+    : base(in_place, std::forward<Args>(args)...) {}
+    
   AK_TOOLBOX_CONSTEXPR bool has_value() const { return !N::is_empty_value(base::value_); }
   
-  AK_TOOLBOX_CONSTEXPR reference_type value() const { return AK_TOOLBOX_ASSERTED_EXPRESSION(has_value(), N::access_value(base::value_)); }
+  AK_TOOLBOX_CONSTEXPR reference_type value() const
+  {
+    return AK_TOOLBOX_ASSERTED_EXPRESSION(has_value(), N::access_value(noted_access<N>(base::value_, counts_operations<N>())));
+  }
   
   AK_TOOLBOX_CONSTEXPR storage_type const& unsafe_raw_value() const { return base::value_; }
+
+  // the contained value, or v if there is none; see value_or_select
+  template <typename U>
+  AK_TOOLBOX_CONSTEXPR value_type value_or(U&& v) const
+  {
+    return value_or_select<N>::get(base::value_, std::forward<U>(v));
+  }
+
+  AK_TOOLBOX_CONSTEXPR_NOCONST void reset() AK_TOOLBOX_NOEXCEPT_AS(std::declval<base&>().reset_impl())
+    { as_base().reset_impl(); }
+    
+  // builds the new value directly in the storage, with no temporary value_type
+  template <typename... Args>
+  AK_TOOLBOX_CONSTEXPR_NOCONST void emplace(Args&&... args)
+    { as_base().emplace(std::forward<Args>(args)...); }
 };
 
 } // namespace detail_
 
-template <typename N, typename /* tag */ = default_tag>
-class compact_optional : public detail_::compact_optional_base<N>
+template <typename N, typename Tag = default_tag>
+class compact_optional;
+
+template <typename EVP, typename Tag>
+struct evp_nested;
+
+namespace detail_ {
+
+// compact_optional<compact_optional<EVP>> uses evp_nested<EVP> as its policy
+template <typename N>
+struct policy_of { typedef N type; };
+
+template <typename EVP, typename Tag>
+struct policy_of< compact_optional<EVP, Tag> > { typedef evp_nested<EVP, Tag> type; };
+
+// the type of o.transform<EVP2>(f) for o of type Opt: compact_optional<EVP2>,
+// or by default Opt if f returns Opt::value_type, and auto_evp of the result otherwise
+template <typename Opt, typename EVP2, typename F>
+struct transform_result
 {
-  typedef detail_::compact_optional_base<N> super;
+  typedef compact_optional<EVP2> type;
+};
+
+template <typename Opt, typename F>
+struct transform_result<Opt, void, F>
+{
+  typedef typename std::decay<decltype(std::declval<F>()(std::declval<typename Opt::reference_type>()))>::type result;
+  typedef typename std::conditional<std::is_same<result, typename Opt::value_type>::value,
+                                    Opt, compact_optional< auto_evp<result> > >::type type;
+};
+
+} // namespace detail_
+
+template <typename N, typename /* tag */>
+class compact_optional : public detail_::compact_optional_base<typename detail_::policy_of<N>::type>
+{
+  typedef typename detail_::policy_of<N>::type policy;
+  typedef detail_::compact_optional_base<policy> super;
   
 public:
 
-  typedef typename N::value_type value_type;
-  typedef typename N::storage_type storage_type;
-  typedef typename N::reference_type reference_type;
+  typedef typename policy::value_type value_type;
+  typedef typename policy::storage_type storage_type;
+  typedef typename policy::reference_type reference_type;
 
-  AK_TOOLBOX_CONSTEXPR compact_optional() AK_TOOLBOX_NOEXCEPT_AS(storage_type(N::empty_value()))
+  AK_TOOLBOX_CONSTEXPR compact_optional() AK_TOOLBOX_NOEXCEPT_IF(detail_::is_nothrow_empty_value<policy>::value)
     : super() {}
     
   AK_TOOLBOX_CONSTEXPR compact_optional(const value_type& v)
@@ -374,16 +1062,195 @@ public:
     
   AK_TOOLBOX_CONSTEXPR compact_optional(value_type&& v)
     : super(std::move(v)) {}
+    
+  template <typename... Args>
+  AK_TOOLBOX_CONSTEXPR explicit compact_optional(in_place_t, Args&&... args)
+    : super(in_place, std::forward<Args>(args)...) {}
+    
+  // Assigns to the contained value (if any) rather than going through a
+  // temporary compact_optional. As in std::optional, scalars are excluded,
+  // so that `o = {}` still resets the object.
+  template <typename U = value_type,
+            typename = typename std::enable_if<std::is_same<typename std::decay<U>::type, value_type>::value
+                                               && !std::is_scalar<value_type>::value>::type>
+  AK_TOOLBOX_CONSTEXPR_NOCONST compact_optional& operator=(U&& v)
+  {
+    super::as_base().assign_impl(std::forward<U>(v));
+    return *this;
+  }
+
+  // f applied to the contained value, stored directly as a compact_optional
+  // with policy EVP2 (see transform_result for the default); empty if *this
+  // is empty, or if f returns the empty value of EVP2
+  template <typename EVP2 = void, typename F,
+            typename R = typename detail_::transform_result<compact_optional, EVP2, F>::type>
+  AK_TOOLBOX_CONSTEXPR R transform(F&& f) const
+  {
+    return this->has_value() ? R(std::forward<F>(f)(this->value())) : R();
+  }
 
-  friend void swap(compact_optional& l, compact_optional&r)
+  // f applied to the contained value, where f returns an optional type
+  // (compact_optional or other) whose default value is empty
+  template <typename F,
+            typename R = typename std::decay<decltype(std::declval<F>()(std::declval<reference_type>()))>::type>
+  AK_TOOLBOX_CONSTEXPR R and_then(F&& f) const
+  {
+    return this->has_value() ? R(std::forward<F>(f)(this->value())) : R();
+  }
+
+  // *this, or f() (a compact_optional or a value_type) if *this is empty
+  template <typename F>
+  AK_TOOLBOX_CONSTEXPR compact_optional or_else(F&& f) const
+  {
+    return this->has_value() ? *this : compact_optional(std::forward<F>(f)());
+  }
+
+  friend AK_TOOLBOX_CONSTEXPR_NOCONST void swap(compact_optional& l, compact_optional&r) AK_TOOLBOX_NOEXCEPT_AS(l.swap_storages(r))
   {
     l.swap_storages(r);
   }
 };
 
+namespace detail_ {
+
+// passes on the further spare values, if any, to allow deeper nesting
+template <typename Spare, typename = void>
+struct spare_policy_base {};
+
+template <typename Spare>
+struct spare_policy_base<Spare, typename void_t_<typename Spare::spare_policy>::type>
+{
+  typedef typename Spare::spare_policy spare_policy;
+};
+
+template <typename EVP, typename = void>
+struct has_spare_policy : std::false_type {};
+
+template <typename EVP>
+struct has_spare_policy<EVP, typename void_t_<typename EVP::spare_policy>::type> : std::true_type {};
+
+// stands in for a missing spare_policy, so that evp_nested can report it with a static_assert
+template <typename Storage>
+struct no_spare_policy
+{
+  static Storage empty_value() AK_TOOLBOX_NOEXCEPT;
+  static bool is_empty_value(const Storage&);
+};
+
+template <typename EVP, typename = void>
+struct spare_policy_of { typedef no_spare_policy<typename EVP::storage_type> type; };
+
+template <typename EVP>
+struct spare_policy_of<EVP, typename void_t_<typename EVP::spare_policy>::type> { typedef typename EVP::spare_policy type; };
+
+} // namespace detail_
+
+// The policy for an optional compact_optional<EVP, Tag>, stored in EVP's
+// storage_type: the empty value is the first of the spare values that EVP
+// declares in its nested `spare_policy`.
+template <typename EVP, typename Tag>
+struct evp_nested
+  : compact_optional_type<compact_optional<EVP, Tag>,
+                          typename detail_::policy_of<EVP>::type::storage_type,
+                          compact_optional<EVP, Tag>>
+  , detail_::spare_policy_base<typename detail_::spare_policy_of<typename detail_::policy_of<EVP>::type>::type>
+{
+  typedef typename detail_::policy_of<EVP>::type inner;
+  typedef compact_optional<EVP, Tag> value_type;
+  typedef typename inner::storage_type storage_type;
+  typedef typename detail_::spare_policy_of<inner>::type spare;
+  
+  static_assert(detail_::has_spare_policy<inner>::value,
+                "nesting requires the inner policy to declare a spare_policy with a spare value, as evp_int_multi<T, V1, V2> does");
+  static_assert(std::is_same<typename detail_::storage_destruction<inner>::type, detail_::member_storage<inner>>::value,
+                "nesting requires a policy that does not manage the life-time of its value manually");
+  
+  static AK_TOOLBOX_CONSTEXPR storage_type empty_value() AK_TOOLBOX_NOEXCEPT_AS(spare::empty_value()) { return spare::empty_value(); }
+  static AK_TOOLBOX_CONSTEXPR bool is_empty_value(const storage_type& v) { return spare::is_empty_value(v); }
+  
+  static AK_TOOLBOX_CONSTEXPR value_type access_value(const storage_type& v)
+  {
+    return inner::is_empty_value(v) ? value_type() : value_type(inner::access_value(v));
+  }
+  
+  // an inner optional that is empty may hold any of the inner empty values,
+  // including one of the spare values: store the inner empty value proper
+  static AK_TOOLBOX_CONSTEXPR storage_type store_value(const value_type& v)
+  {
+    return v.has_value() ? v.unsafe_raw_value() : inner::empty_value();
+  }
+};
+
+namespace detail_ {
+
+template <typename EVP, typename = void>
+struct declared_trivially_relocatable : std::false_type {};
+
+template <typename EVP>
+struct declared_trivially_relocatable<EVP, typename void_t_<typename EVP::trivially_relocatable>::type>
+  : EVP::trivially_relocatable {};
+
+} // namespace detail_
+
+// A policy can declare `typedef std::true_type trivially_relocatable;` to
+// state that moving its storage_type to a new address and abandoning the old
+// one is equivalent to a bitwise copy.
+template <typename EVP>
+struct is_trivially_relocatable : std::integral_constant<bool,
+  detail_::declared_trivially_relocatable<EVP>::value
+#ifndef AK_TOOLBOX_NO_IS_TRIVIALLY_COPYABLE
+  || std::is_trivially_copyable<compact_optional<EVP>>::value
+#endif // AK_TOOLBOX_NO_IS_TRIVIALLY_COPYABLE
+  >
+{};
+
+namespace detail_ {
+
+template <typename EVP, typename Tag>
+compact_optional<EVP, Tag>* relocate_impl(compact_optional<EVP, Tag>* first, compact_optional<EVP, Tag>* last,
+                                          compact_optional<EVP, Tag>* d_first, std::true_type) AK_TOOLBOX_NOEXCEPT
+{
+  std::memmove(static_cast<void*>(d_first), static_cast<const void*>(first), (last - first) * sizeof(*first));
+  return d_first + (last - first);
+}
+
+template <typename EVP, typename Tag>
+compact_optional<EVP, Tag>* relocate_impl(compact_optional<EVP, Tag>* first, compact_optional<EVP, Tag>* last,
+                                          compact_optional<EVP, Tag>* d_first, std::false_type)
+{
+  typedef compact_optional<EVP, Tag> opt_t;
+  for (; first != last; ++first, ++d_first)
+  {
+    ::new (static_cast<void*>(d_first)) opt_t(std::move(*first));
+    first->~opt_t();
+  }
+  return d_first;
+}
+
+} // namespace detail_
+
+// Moves objects in [first, last) into raw memory starting at d_first and ends
+// the life-time of the source objects. Ranges must not overlap, unless the
+// policy is trivially relocatable. Returns the end of the destination range.
+template <typename EVP, typename Tag>
+compact_optional<EVP, Tag>* uninitialized_relocate(compact_optional<EVP, Tag>* first, compact_optional<EVP, Tag>* last,
+                                                   compact_optional<EVP, Tag>* d_first)
+{
+  return detail_::relocate_impl(first, last, d_first, is_trivially_relocatable<EVP>());
+}
+
 } // namespace compact_optional_ns
 
 using compact_optional_ns::compact_optional;
+using compact_optional_ns::in_place_t;
+using compact_optional_ns::in_place;
+using compact_optional_ns::check_ignore;
+using compact_optional_ns::check_assert;
+using compact_optional_ns::check_throw;
+using compact_optional_ns::check_count;
+using compact_optional_ns::sentinel_collision;
+using compact_optional_ns::is_trivially_relocatable;
+using compact_optional_ns::uninitialized_relocate;
 using compact_optional_ns::empty_scalar_value;
 using compact_optional_ns::compact_optional_type;
 using compact_optional_ns::compact_optional_pod_storage_type;
@@ -391,11 +1258,18 @@ using compact_optional_ns::compact_optional_from_optional;
 using compact_optional_ns::compact_bool;
 using compact_optional_ns::evp_bool;
 using compact_optional_ns::evp_int;
+using compact_optional_ns::evp_int_multi;
+using compact_optional_ns::evp_nested;
 using compact_optional_ns::evp_fp_nan;
 using compact_optional_ns::evp_value_init;
 using compact_optional_ns::evp_optional;
 using compact_optional_ns::evp_stl_empty;
 using compact_optional_ns::evp_enum;
+using compact_optional_ns::evp_nullptr;
+using compact_optional_ns::evp_misaligned_ptr;
+using compact_optional_ns::evp_reference_wrapper;
+using compact_optional_ns::niche_traits;
+using compact_optional_ns::auto_evp;
 
 } // namespace ak_toolbox
 
@@ -0,0 +1,453 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef AK_TOOLBOX_COMPACT_OPTIONAL_ALGORITHM_HEADER_GUARD_
+#define AK_TOOLBOX_COMPACT_OPTIONAL_ALGORITHM_HEADER_GUARD_
+
+#include "compact_optional.hpp"
+#include "compact_optional_ordering.hpp"
+#include "compact_optional_simd.hpp"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+// Null-aware partitioning and sorting of ranges of compact_optional, and
+// batch and gap-filling operations on arrays of them.
+
+namespace ak_toolbox {
+namespace compact_optional_ns {
+
+enum empty_placement { empties_first, empties_last };
+
+// Reorders [first, last) so that the empty objects come after (or before)
+// the ones with a value. Returns the first element of the second group.
+// The order of the objects with a value is not preserved; each misplaced
+// object is moved once, and the object it leaves behind is reset.
+template <typename BidirIt>
+BidirIt partition_engaged(BidirIt first, BidirIt last, empty_placement where = empties_last)
+{
+  const bool engaged_first = where == empties_last;
+  for (;;)
+  {
+    while (first != last && first->has_value() == engaged_first)
+      ++first;
+    if (first == last)
+      return first;
+    do
+    {
+      if (--last == first)
+        return first;
+    } while (last->has_value() != engaged_first);
+
+    if (engaged_first)
+    {
+      *first = std::move(*last); // the empty *first needs no saving
+      last->reset();
+    }
+    else
+    {
+      *last = std::move(*first);
+      first->reset();
+    }
+    ++first;
+  }
+}
+
+namespace detail_ {
+
+// moves the objects with a value to the front, in order, then resets the rest
+template <typename ForwardIt>
+ForwardIt compact_engaged(ForwardIt first, ForwardIt last)
+{
+  ForwardIt out = first;
+  for (; first != last; ++first)
+    if (first->has_value())
+    {
+      if (out != first)
+        *out = std::move(*first);
+      ++out;
+    }
+  for (ForwardIt it = out; it != last; ++it)
+    it->reset();
+  return out;
+}
+
+} // namespace detail_
+
+// As above, but the objects with a value keep their relative order. Takes
+// one pass: those objects are moved into place, then the rest is reset.
+template <typename BidirIt>
+BidirIt stable_partition_engaged(BidirIt first, BidirIt last, empty_placement where = empties_last)
+{
+  if (where == empties_last)
+    return detail_::compact_engaged(first, last);
+
+  std::reverse_iterator<BidirIt> rfirst (last), rlast (first);
+  return detail_::compact_engaged(rfirst, rlast).base();
+}
+
+namespace detail_ {
+
+// Maps the storage of an object with a value to an unsigned key with the
+// same order, and back.
+template <typename EVP, typename = void>
+struct radix_traits
+{
+  static_assert(sizeof(EVP) == 0, "radix_sort requires a raw-comparable integral policy, or evp_fp_nan");
+};
+
+template <typename EVP>
+struct radix_traits<EVP, typename std::enable_if<is_raw_comparable<EVP>::value
+                                                 && std::is_integral<typename EVP::storage_type>::value>::type>
+{
+  typedef typename EVP::storage_type storage_type;
+  typedef typename std::make_unsigned<storage_type>::type key_type;
+
+  // flipping the sign bit turns two's complement order into unsigned order
+  static key_type bias() { return std::is_signed<storage_type>::value ? key_type(~(key_type(-1) >> 1)) : key_type(0); }
+
+  static key_type to_key(storage_type v) { return key_type(key_type(v) ^ bias()); }
+  static storage_type from_key(key_type k) { return storage_type(key_type(k ^ bias())); }
+};
+
+template <typename FPT>
+struct fp_key
+{
+  typedef typename std::conditional<sizeof(FPT) == 4, std::uint32_t, std::uint64_t>::type key_type;
+  static_assert(sizeof(FPT) == sizeof(key_type), "unsupported floating-point type");
+  static const key_type sign = key_type(1) << (sizeof(key_type) * 8 - 1);
+
+  // negative numbers: all bits flipped; non-negative: the sign bit set
+  static key_type to_key(FPT v)
+  {
+    key_type b;
+    std::memcpy(&b, &v, sizeof b);
+    return (b & sign) ? key_type(~b) : key_type(b | sign);
+  }
+
+  static FPT from_key(key_type k)
+  {
+    key_type b = (k & sign) ? key_type(k ^ sign) : key_type(~k);
+    FPT v;
+    std::memcpy(&v, &b, sizeof v);
+    return v;
+  }
+};
+
+template <typename FPT>
+struct radix_traits< evp_fp_nan<FPT> > : fp_key<FPT>
+{
+  typedef FPT storage_type;
+};
+
+template <typename T>
+struct radix_traits< auto_evp<T> > : radix_traits<typename niche_policy<T>::type> {};
+
+// LSD radix sort of keys in a, using b as scratch space; 8-bit digits,
+// skipping the digits in which all keys agree. The result ends up in a.
+template <typename Key>
+void radix_sort_keys(std::vector<Key>& a, std::vector<Key>& b)
+{
+  const std::size_t digits = sizeof(Key);
+  const std::size_t n = a.size();
+  std::vector<std::size_t> count (digits * 256, 0);
+
+  for (std::size_t i = 0; i != n; ++i)
+    for (std::size_t d = 0; d != digits; ++d)
+      ++count[d * 256 + ((a[i] >> (8 * d)) & 0xFF)];
+
+  for (std::size_t d = 0; d != digits; ++d)
+  {
+    std::size_t* c = &count[d * 256];
+    if (c[(a[0] >> (8 * d)) & 0xFF] == n)
+      continue; // every key has the same digit
+
+    std::size_t sum = 0;
+    for (std::size_t v = 0; v != 256; ++v)
+    {
+      std::size_t k = c[v];
+      c[v] = sum;
+      sum += k;
+    }
+    for (std::size_t i = 0; i != n; ++i)
+      b[c[(a[i] >> (8 * d)) & 0xFF]++] = a[i];
+    a.swap(b);
+  }
+}
+
+template <typename EVP, typename Tag>
+typename EVP::storage_type* raw_storage(compact_optional<EVP, Tag>* first)
+{
+  typedef compact_optional<EVP, Tag> opt_t;
+  static_assert(sizeof(opt_t) == sizeof(typename EVP::storage_type) && std::is_standard_layout<opt_t>::value,
+                "compact_optional must have the layout of its storage_type");
+  return reinterpret_cast<typename EVP::storage_type*>(first);
+}
+
+template <typename EVP, typename Tag>
+const typename EVP::storage_type* raw_storage(const compact_optional<EVP, Tag>* first)
+{
+  return raw_storage(const_cast<compact_optional<EVP, Tag>*>(first));
+}
+
+// Calls f(b, e) for each gap [b, e) in p[0], ..., p[n - 1]: a maximal run of
+// empty elements. Reads the engaged bits 64 at a time, so that the cost is
+// one scan of the array plus the work of f.
+template <typename EVP, typename F>
+void for_each_gap(const typename EVP::storage_type* p, std::size_t n, F f)
+{
+  const std::size_t none = std::size_t(-1);
+  std::size_t gap = none;
+  for (std::size_t i = 0; i < n; i += 64)
+  {
+    const std::size_t len = n - i < 64 ? n - i : 64;
+    const std::uint64_t engaged = engaged_scan<EVP>::mask64(p + i, len);
+    const std::uint64_t empty = ~engaged & low_bits64(len);
+    for (std::size_t j = 0; j < len; )
+    {
+      if (gap == none)
+      {
+        const std::uint64_t next = empty >> j;
+        if (!next)
+          break;
+        j += lowest_bit64(next);
+        gap = i + j;
+      }
+      const std::uint64_t next = engaged >> j;
+      if (!next)
+        break;
+      j += lowest_bit64(next);
+      f(gap, i + j);
+      gap = none;
+    }
+  }
+  if (gap != none)
+    f(gap, n);
+}
+
+// The values interpolate_linear computes and the positions it accepts:
+// arithmetic types here, durations and time points in compact_optional_chrono.hpp.
+template <typename T, typename = void>
+struct interpolation
+{
+  static_assert(std::is_arithmetic<T>::value, "interpolate_linear: unsupported value or position type");
+
+  static double position(T x) { return double(x); }
+
+  static T between(T a, T b, double t) { return between(a, b, t, std::is_floating_point<T>()); }
+  static T between(T a, T b, double t, std::true_type) { return T(a + (b - a) * t); }
+  // Integers: only the offset from a goes through double, computed on the
+  // distance |b - a| in 64-bit unsigned arithmetic, so that 64-bit values keep
+  // their low bits and equal neighbours give the same value back. The offset
+  // is rounded to nearest and kept within [0, |b - a|].
+  static T between(T a, T b, double t, std::false_type)
+  {
+    const std::uint64_t ua = std::uint64_t(a), ub = std::uint64_t(b);
+    const bool up = !(b < a);
+    const std::uint64_t d = up ? ub - ua : ua - ub;
+    const double x = std::round(double(d) * t);
+    const std::uint64_t off = !(x > 0) ? 0 : x >= 18446744073709551616.0 || std::uint64_t(x) > d ? d : std::uint64_t(x);
+    return T(up ? ua + off : ua - off);
+  }
+};
+
+} // namespace detail_
+
+// Batch operations on the array [first, last). They use the policy's
+// count_empty, fill_empty and mask_empty hooks if it has them (see
+// compact_optional_simd.hpp), SIMD kernels for the shipped scalar policies,
+// and a loop over is_empty_value otherwise.
+
+template <typename EVP, typename Tag>
+std::size_t count_empty(const compact_optional<EVP, Tag>* first, const compact_optional<EVP, Tag>* last)
+{
+  return detail_::count_empty<EVP>(detail_::raw_storage(first), last - first);
+}
+
+// Resets every object; as many times faster than a loop calling reset() as
+// the kernel is wide. Not for policies that construct the value in a buffer.
+template <typename EVP, typename Tag>
+void fill_empty(compact_optional<EVP, Tag>* first, compact_optional<EVP, Tag>* last)
+{
+  static_assert(std::is_same<typename detail_::storage_destruction<EVP>::type, detail_::member_storage<EVP>>::value,
+                "fill_empty would not destroy the values of this policy");
+  detail_::fill_empty<EVP>(detail_::raw_storage(first), last - first);
+}
+
+// bit i % 64 of word i / 64 is set iff first[i] is empty; `out` must have
+// room for ((last - first) + 63) / 64 words
+template <typename EVP, typename Tag>
+void mask_empty(const compact_optional<EVP, Tag>* first, const compact_optional<EVP, Tag>* last, std::uint64_t* out)
+{
+  detail_::mask_empty<EVP>(detail_::raw_storage(first), last - first, out);
+}
+
+// Gap filling for series stored in the array [first, last), such as samples
+// of a metric. A gap is a run of empty objects. Each algorithm makes one pass
+// over the array, 64 elements at a time, skips the words without gaps, and
+// allocates nothing. Gaps are filled with wide stores (interpolated ones
+// with a loop the compiler can vectorize). A gap at the front has no value
+// before it, and a gap at the back has no value after it. The algorithms
+// that need such a value leave the gap empty. Not for policies that
+// construct the value in a buffer.
+
+// each empty object takes the value of the nearest object with a value before it
+template <typename EVP, typename Tag>
+void forward_fill(compact_optional<EVP, Tag>* first, compact_optional<EVP, Tag>* last)
+{
+  static_assert(std::is_same<typename detail_::storage_destruction<EVP>::type, detail_::member_storage<EVP>>::value,
+                "forward_fill requires a policy with member storage");
+  typename EVP::storage_type* p = detail_::raw_storage(first);
+  detail_::for_each_gap<EVP>(p, last - first, [p](std::size_t b, std::size_t e) {
+    if (b != 0)
+      detail_::broadcast_fill(p + b, e - b, p[b - 1]);
+  });
+}
+
+// each empty object takes the value of the nearest object with a value after it
+template <typename EVP, typename Tag>
+void backward_fill(compact_optional<EVP, Tag>* first, compact_optional<EVP, Tag>* last)
+{
+  static_assert(std::is_same<typename detail_::storage_destruction<EVP>::type, detail_::member_storage<EVP>>::value,
+                "backward_fill requires a policy with member storage");
+  typename EVP::storage_type* p = detail_::raw_storage(first);
+  const std::size_t n = last - first;
+  detail_::for_each_gap<EVP>(p, n, [p, n](std::size_t b, std::size_t e) {
+    if (e != n)
+      detail_::broadcast_fill(p + b, e - b, p[e]);
+  });
+}
+
+// every empty object takes the value v
+template <typename EVP, typename Tag>
+void replace_empty(compact_optional<EVP, Tag>* first, compact_optional<EVP, Tag>* last,
+                   const typename EVP::value_type& v)
+{
+  static_assert(std::is_same<typename detail_::storage_destruction<EVP>::type, detail_::member_storage<EVP>>::value,
+                "replace_empty requires a policy with member storage");
+  typedef typename EVP::storage_type storage_type;
+  storage_type* p = detail_::raw_storage(first);
+  const storage_type s = EVP::store_value(v);
+  const std::size_t n = last - first;
+  // no dependence between elements: a select over each word with a gap, which the compiler can vectorize
+  for (std::size_t i = 0; i < n; i += 64)
+  {
+    const std::size_t len = n - i < 64 ? n - i : 64;
+    if (detail_::engaged_scan<EVP>::mask64(p + i, len) == detail_::low_bits64(len))
+      continue;
+    for (storage_type* q = p + i; q != p + i + len; ++q)
+      *q = EVP::is_empty_value(*q) ? s : *q;
+  }
+}
+
+// Each empty object between two objects with a value takes the value on the
+// straight line between them, as if the elements were equally spaced. The
+// value type can be arithmetic (integers are rounded to nearest), a duration
+// or a time point. An interpolated value equal to the empty value leaves the
+// object empty.
+template <typename EVP, typename Tag>
+void interpolate_linear(compact_optional<EVP, Tag>* first, compact_optional<EVP, Tag>* last)
+{
+  static_assert(std::is_same<typename detail_::storage_destruction<EVP>::type, detail_::member_storage<EVP>>::value,
+                "interpolate_linear requires a policy with member storage");
+  typedef typename EVP::value_type value_type;
+  typedef detail_::interpolation<value_type> interp;
+  typename EVP::storage_type* p = detail_::raw_storage(first);
+  const std::size_t n = last - first;
+  detail_::for_each_gap<EVP>(p, n, [p, n](std::size_t b, std::size_t e) {
+    if (b == 0 || e == n)
+      return;
+    const value_type lo = EVP::access_value(p[b - 1]), hi = EVP::access_value(p[e]);
+    const double step = 1.0 / double(e - b + 1);
+    for (std::size_t k = b; k != e; ++k)
+      p[k] = EVP::store_value(interp::between(lo, hi, double(k - b + 1) * step));
+  });
+}
+
+// As above, but first[i] is the sample at positions[i], such as a timestamp;
+// the positions must increase. They can be arithmetic, durations or time points.
+template <typename EVP, typename Tag, typename Pos>
+void interpolate_linear(compact_optional<EVP, Tag>* first, compact_optional<EVP, Tag>* last, const Pos* positions)
+{
+  static_assert(std::is_same<typename detail_::storage_destruction<EVP>::type, detail_::member_storage<EVP>>::value,
+                "interpolate_linear requires a policy with member storage");
+  typedef typename EVP::value_type value_type;
+  typedef detail_::interpolation<value_type> interp;
+  typedef detail_::interpolation<Pos> pos;
+  typename EVP::storage_type* p = detail_::raw_storage(first);
+  const std::size_t n = last - first;
+  detail_::for_each_gap<EVP>(p, n, [p, n, positions](std::size_t b, std::size_t e) {
+    if (b == 0 || e == n)
+      return;
+    const value_type lo = EVP::access_value(p[b - 1]), hi = EVP::access_value(p[e]);
+    const double x0 = pos::position(positions[b - 1]);
+    const double scale = 1.0 / (pos::position(positions[e]) - x0);
+    for (std::size_t k = b; k != e; ++k)
+      p[k] = EVP::store_value(interp::between(lo, hi, (pos::position(positions[k]) - x0) * scale));
+  });
+}
+
+// Sorts the n objects at first in ascending order of their values, with the
+// empty objects at the front or at the back. A least-significant-digit
+// radix sort over the raw storage: O(n) time, O(n) extra memory.
+// Works for evp_int, evp_enum, evp_bool (and other integral policies for
+// which is_raw_comparable holds) and for evp_fp_nan, where every NaN is
+// empty, and -0.0 sorts before +0.0.
+template <typename EVP, typename Tag>
+void radix_sort(compact_optional<EVP, Tag>* first, compact_optional<EVP, Tag>* last,
+                empty_placement where = empties_last)
+{
+  typedef detail_::radix_traits<EVP> traits;
+  typedef typename traits::key_type key_type;
+
+  const std::size_t n = last - first;
+  std::vector<key_type> keys, scratch;
+  keys.reserve(n);
+  for (compact_optional<EVP, Tag>* it = first; it != last; ++it)
+    if (it->has_value())
+      keys.push_back(traits::to_key(it->unsafe_raw_value()));
+
+  const std::size_t engaged = keys.size();
+  if (engaged > 1)
+  {
+    scratch.resize(engaged);
+    detail_::radix_sort_keys(keys, scratch);
+  }
+
+  compact_optional<EVP, Tag>* out = first;
+  if (where == empties_first)
+  {
+    fill_empty(out, last - engaged);
+    out = last - engaged;
+  }
+  for (std::size_t i = 0; i != engaged; ++i, ++out)
+    *out = compact_optional<EVP, Tag>(EVP::access_value(traits::from_key(keys[i])));
+  fill_empty(out, last);
+}
+
+} // namespace compact_optional_ns
+
+using compact_optional_ns::empty_placement;
+using compact_optional_ns::empties_first;
+using compact_optional_ns::empties_last;
+using compact_optional_ns::partition_engaged;
+using compact_optional_ns::stable_partition_engaged;
+using compact_optional_ns::radix_sort;
+using compact_optional_ns::count_empty;
+using compact_optional_ns::fill_empty;
+using compact_optional_ns::mask_empty;
+using compact_optional_ns::forward_fill;
+using compact_optional_ns::backward_fill;
+using compact_optional_ns::replace_empty;
+using compact_optional_ns::interpolate_linear;
+
+} // namespace ak_toolbox
+
+#endif //AK_TOOLBOX_COMPACT_OPTIONAL_ALGORITHM_HEADER_GUARD_
@@ -0,0 +1,282 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef AK_TOOLBOX_COMPACT_OPTIONAL_ARRAY_MAP_HEADER_GUARD_
+#define AK_TOOLBOX_COMPACT_OPTIONAL_ARRAY_MAP_HEADER_GUARD_
+
+#include "compact_optional.hpp"
+#include "compact_optional_simd.hpp"
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace ak_toolbox {
+namespace compact_optional_ns {
+
+// Slot layouts of compact_optional_array_map: one array of slots for all
+// indices below the largest one, or pages of 4 KB allocated on first write.
+struct array_map_dense {};
+struct array_map_paged {};
+
+namespace detail_ {
+
+template <typename EVP, typename Layout>
+class slot_store;
+
+template <typename EVP>
+class slot_store<EVP, array_map_dense>
+{
+public:
+  typedef typename EVP::storage_type storage_type;
+  typedef std::size_t size_type;
+
+protected:
+  std::vector<storage_type> slots_;
+
+  // null if i has no slot
+  const storage_type* find_slot(size_type i) const { return i < slots_.size() ? &slots_[i] : nullptr; }
+  storage_type* find_slot(size_type i) { return i < slots_.size() ? &slots_[i] : nullptr; }
+
+  storage_type& slot_for_write(size_type i)
+  {
+    if (i >= slots_.max_size()) // also keeps i + 1 below from overflowing
+      throw std::length_error("compact_optional_array_map: key too large");
+    if (i >= slots_.size())
+    {
+      size_type n = slots_.size() < 16 ? 16 : slots_.size() * 2;
+      slots_.resize(n > i ? n : i + 1, EVP::empty_value());
+    }
+    return slots_[i];
+  }
+
+  // calls f(i, slot) for each slot with a value, in increasing order of i
+  template <typename F>
+  void for_each_slot(F f) const
+  {
+    const storage_type* p = slots_.data();
+    for_each_engaged<EVP>(p, slots_.size(), [&](size_type i) { f(i, p[i]); });
+  }
+
+  void clear_slots() { fill_empty<EVP>(slots_.data(), slots_.size()); }
+
+public:
+  // the number of slots; indices from slot_count() on need growth
+  size_type slot_count() const { return slots_.size(); }
+  std::size_t memory_usage() const { return slots_.capacity() * sizeof(storage_type); }
+
+  void reserve(size_type n)
+  {
+    if (n > slots_.size())
+      slots_.resize(n, EVP::empty_value());
+  }
+};
+
+constexpr unsigned floor_log2(std::size_t n) { return n <= 1 ? 0 : 1 + floor_log2(n / 2); }
+
+template <typename EVP>
+class slot_store<EVP, array_map_paged>
+{
+public:
+  typedef typename EVP::storage_type storage_type;
+  typedef std::size_t size_type;
+
+  static const std::size_t page_bytes = 4096;
+  static const unsigned page_shift = floor_log2(sizeof(storage_type) < page_bytes ? page_bytes / sizeof(storage_type) : 1);
+  static const size_type page_slots = size_type(1) << page_shift;
+
+protected:
+  std::vector< std::unique_ptr<storage_type[]> > pages_; // null: all slots empty
+  size_type page_count_;
+
+  slot_store() : page_count_(0) {}
+
+  const storage_type* find_slot(size_type i) const
+  {
+    const size_type p = i >> page_shift;
+    return p < pages_.size() && pages_[p] ? &pages_[p][i & (page_slots - 1)] : nullptr;
+  }
+
+  storage_type* find_slot(size_type i)
+  {
+    const size_type p = i >> page_shift;
+    return p < pages_.size() && pages_[p] ? &pages_[p][i & (page_slots - 1)] : nullptr;
+  }
+
+  storage_type& slot_for_write(size_type i)
+  {
+    const size_type p = i >> page_shift;
+    if (p >= pages_.max_size())
+      throw std::length_error("compact_optional_array_map: key too large");
+    if (p >= pages_.size())
+      pages_.resize(p + 1);
+    if (!pages_[p])
+    {
+      pages_[p].reset(new storage_type[page_slots]);
+      fill_empty<EVP>(pages_[p].get(), page_slots);
+      ++page_count_;
+    }
+    return pages_[p][i & (page_slots - 1)];
+  }
+
+  template <typename F>
+  void for_each_slot(F f) const
+  {
+    for (size_type p = 0; p != pages_.size(); ++p)
+      if (const storage_type* page = pages_[p].get())
+        for_each_engaged<EVP>(page, page_slots, [&](size_type j) { f((p << page_shift) + j, page[j]); });
+  }
+
+  void clear_slots()
+  {
+    std::vector< std::unique_ptr<storage_type[]> >().swap(pages_);
+    page_count_ = 0;
+  }
+
+public:
+  size_type slot_count() const { return pages_.size() << page_shift; }
+  size_type page_count() const { return page_count_; }
+
+  std::size_t memory_usage() const
+  {
+    return page_count_ * page_slots * sizeof(storage_type) + pages_.capacity() * sizeof(pages_[0]);
+  }
+
+  // frees the pages in which every slot is empty
+  void shrink_to_fit()
+  {
+    for (size_type p = 0; p != pages_.size(); ++p)
+      if (pages_[p] && count_engaged<EVP>(pages_[p].get(), page_slots) == 0)
+      {
+        pages_[p].reset();
+        --page_count_;
+      }
+    while (!pages_.empty() && !pages_.back())
+      pages_.pop_back();
+  }
+};
+
+} // namespace detail_
+
+// A map from small non-negative integers to values of EVP::value_type, kept
+// as an array of compact_optional<EVP> indexed directly by the key: lookup
+// is one load and one is_empty_value test, with no hashing and no flags
+// beside the slots. The array grows to fit the largest key written. With
+// array_map_paged, slots are allocated in 4 KB pages, on the first write
+// into the page, so that a large but sparse key space costs memory only
+// where it is used.
+template <typename EVP, typename Layout = array_map_dense>
+class compact_optional_array_map : public detail_::slot_store<EVP, Layout>
+{
+  typedef detail_::slot_store<EVP, Layout> base;
+
+public:
+  typedef std::size_t key_type;
+  typedef typename EVP::value_type mapped_type;
+  typedef compact_optional<EVP> optional_type;
+  typedef typename EVP::storage_type storage_type;
+  typedef std::size_t size_type;
+
+#ifndef AK_TOOLBOX_NO_ARVANCED_CXX11
+  static_assert(std::is_trivially_copyable<storage_type>::value && std::is_trivially_copyable<mapped_type>::value,
+                "compact_optional_array_map requires a policy with trivially copyable value and storage");
+#endif // AK_TOOLBOX_NO_ARVANCED_CXX11
+
+private:
+  size_type size_;
+
+  static optional_type to_optional(const storage_type& s)
+  {
+    return EVP::is_empty_value(s) ? optional_type() : optional_type(EVP::access_value(s));
+  }
+
+  static bool rejected()
+  {
+    detail_::report_collision<EVP>();
+    return false;
+  }
+
+public:
+  compact_optional_array_map() : size_(0) {}
+
+  // the number of keys with a value
+  size_type size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  bool contains(key_type k) const
+  {
+    const storage_type* s = this->find_slot(k);
+    return s && !EVP::is_empty_value(*s);
+  }
+
+  size_type count(key_type k) const { return contains(k) ? 1 : 0; }
+
+  // the value for k, if any; keys past the slots are simply absent
+  optional_type operator[](key_type k) const
+  {
+    const storage_type* s = this->find_slot(k);
+    return s ? to_optional(*s) : optional_type();
+  }
+
+  // stores v under k unless k already has a value, or v is the empty value
+  // (reported in the policy's collision mode); returns whether it did
+  bool insert(key_type k, const mapped_type& v)
+  {
+    if (EVP::is_empty_value(EVP::store_value(v)))
+      return rejected();
+    storage_type& s = this->slot_for_write(k);
+    if (!EVP::is_empty_value(s))
+      return false;
+    s = EVP::store_value(v);
+    ++size_;
+    return true;
+  }
+
+  // stores v under k, replacing the previous value if any; returns false,
+  // leaving the map unchanged, if v is the empty value
+  bool set(key_type k, const mapped_type& v)
+  {
+    if (EVP::is_empty_value(EVP::store_value(v)))
+      return rejected();
+    storage_type& s = this->slot_for_write(k);
+    size_ += EVP::is_empty_value(s);
+    s = EVP::store_value(v);
+    return true;
+  }
+
+  bool erase(key_type k)
+  {
+    storage_type* s = this->find_slot(k);
+    if (!s || EVP::is_empty_value(*s))
+      return false;
+    *s = EVP::empty_value();
+    --size_;
+    return true;
+  }
+
+  void clear()
+  {
+    this->clear_slots();
+    size_ = 0;
+  }
+
+  // calls f(key, value) for every key with a value, in increasing order of keys
+  template <typename F>
+  void for_each(F f) const
+  {
+    this->for_each_slot([&](key_type k, const storage_type& s) { f(k, EVP::access_value(s)); });
+  }
+};
+
+} // namespace compact_optional_ns
+
+using compact_optional_ns::array_map_dense;
+using compact_optional_ns::array_map_paged;
+using compact_optional_ns::compact_optional_array_map;
+
+} // namespace ak_toolbox
+
+#endif //AK_TOOLBOX_COMPACT_OPTIONAL_ARRAY_MAP_HEADER_GUARD_
@@ -0,0 +1,134 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef AK_TOOLBOX_COMPACT_OPTIONAL_ARROW_HEADER_GUARD_
+#define AK_TOOLBOX_COMPACT_OPTIONAL_ARROW_HEADER_GUARD_
+
+#include "compact_optional.hpp"
+#include "compact_optional_simd.hpp"
+#include <cstddef>
+#include <cstdint>
+
+// Conversions between arrays of compact_optional and the Apache Arrow memory
+// layout for primitive columns: a values buffer plus a validity bitmap, where
+// bit i % 8 of byte i / 8 (least significant bit first) is set iff element i
+// is not null. Only the documented layout is used; Arrow itself is not needed.
+
+namespace ak_toolbox {
+namespace compact_optional_ns {
+namespace detail_ {
+
+// The values buffer can be shared with Arrow only if storage_type is the
+// Arrow representation of value_type: true for arithmetic types stored as
+// themselves, and for enums stored as their underlying type. (Arrow packs
+// booleans into bits, so evp_bool does not qualify.)
+template <typename EVP>
+struct arrow_compatible
+{
+  typedef typename EVP::value_type value_type;
+  typedef typename EVP::storage_type storage_type;
+
+  static const bool value = std::is_arithmetic<storage_type>::value
+                            && (std::is_same<value_type, storage_type>::value
+                                || (std::is_enum<value_type>::value && sizeof(value_type) == sizeof(storage_type)));
+};
+
+template <typename EVP, typename Tag>
+const typename EVP::storage_type* raw_storage(const compact_optional<EVP, Tag>* p)
+{
+  typedef compact_optional<EVP, Tag> opt_t;
+  static_assert(sizeof(opt_t) == sizeof(typename EVP::storage_type) && std::is_standard_layout<opt_t>::value,
+                "compact_optional must have the layout of its storage_type");
+  return reinterpret_cast<const typename EVP::storage_type*>(p);
+}
+
+template <typename EVP, typename Tag>
+typename EVP::storage_type* raw_storage(compact_optional<EVP, Tag>* p)
+{
+  return const_cast<typename EVP::storage_type*>(raw_storage(static_cast<const compact_optional<EVP, Tag>*>(p)));
+}
+
+// reads the validity bits of elements [i, i + len), len <= 64, i % 8 == 0
+inline std::uint64_t load_validity64(const std::uint8_t* bitmap, std::size_t i, std::size_t len)
+{
+  if (!bitmap)
+    return low_bits64(len);
+  std::uint64_t m = 0;
+  for (std::size_t b = 0; b * 8 < len; ++b)
+    m |= std::uint64_t(bitmap[i / 8 + b]) << (8 * b);
+  return m & low_bits64(len);
+}
+
+} // namespace detail_
+
+// Returns the Arrow values buffer for n optionals starting at first: the same
+// memory, reinterpreted. Null slots keep the sentinel, which Arrow ignores.
+template <typename EVP, typename Tag>
+const typename EVP::storage_type* arrow_values(const compact_optional<EVP, Tag>* first)
+{
+  static_assert(detail_::arrow_compatible<EVP>::value, "storage_type is not an Arrow primitive layout");
+  return detail_::raw_storage(first);
+}
+
+// Writes the Arrow validity bitmap ((n + 7) / 8 bytes) for n optionals
+// starting at first. Returns the null count.
+template <typename EVP, typename Tag>
+std::size_t to_arrow_validity(const compact_optional<EVP, Tag>* first, std::size_t n, std::uint8_t* bitmap)
+{
+  const typename EVP::storage_type* p = detail_::raw_storage(first);
+  std::size_t valid = 0;
+  for (std::size_t i = 0; i < n; i += 64)
+  {
+    std::size_t len = n - i < 64 ? n - i : 64;
+    std::uint64_t m = detail_::engaged_scan<EVP>::mask64(p + i, len);
+    valid += detail_::popcount64(m);
+    for (std::size_t b = 0; b * 8 < len; ++b)
+      bitmap[i / 8 + b] = static_cast<std::uint8_t>(m >> (8 * b));
+  }
+  return n - valid;
+}
+
+// Fills n optionals at out from an Arrow values buffer and validity bitmap
+// (a null bitmap means that all values are valid): null slots get the empty
+// value. `values` may alias `out`, for in-place conversion.
+// Returns the index of the first valid value that equals the empty value
+// (and therefore reads back as empty), or n if there is no such collision.
+template <typename EVP, typename Tag>
+std::size_t from_arrow(const typename EVP::storage_type* values, const std::uint8_t* validity, std::size_t n,
+                       compact_optional<EVP, Tag>* out)
+{
+  static_assert(detail_::arrow_compatible<EVP>::value, "storage_type is not an Arrow primitive layout");
+  typedef typename EVP::storage_type storage_type;
+  storage_type* o = detail_::raw_storage(out);
+  const storage_type e = EVP::empty_value();
+  std::size_t collision = n;
+
+  for (std::size_t i = 0; i < n; i += 64)
+  {
+    std::size_t len = n - i < 64 ? n - i : 64;
+    std::uint64_t m = detail_::load_validity64(validity, i, len);
+    for (std::size_t k = 0; k != len; ++k)
+      o[i + k] = ((m >> k) & 1u) ? values[i + k] : e;
+
+    if (collision == n)
+    {
+      std::uint64_t lost = m & ~detail_::engaged_scan<EVP>::mask64(o + i, len);
+      if (lost)
+        collision = i + detail_::lowest_bit64(lost);
+    }
+  }
+  return collision;
+}
+
+} // namespace compact_optional_ns
+
+using compact_optional_ns::arrow_values;
+using compact_optional_ns::to_arrow_validity;
+using compact_optional_ns::from_arrow;
+
+} // namespace ak_toolbox
+
+#endif //AK_TOOLBOX_COMPACT_OPTIONAL_ARROW_HEADER_GUARD_
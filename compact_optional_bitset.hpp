@@ -0,0 +1,193 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef AK_TOOLBOX_COMPACT_OPTIONAL_BITSET_HEADER_GUARD_
+#define AK_TOOLBOX_COMPACT_OPTIONAL_BITSET_HEADER_GUARD_
+
+#include "compact_optional.hpp"
+#include "compact_optional_simd.hpp"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ak_toolbox {
+namespace compact_optional_ns {
+
+// A sequence of optional bools packed into two bit planes: a validity plane
+// (bit set iff the element has a value) and a value plane (bit set iff the
+// element is true; always clear for empty elements). Each element takes two
+// bits, rather than the char of compact_optional<evp_bool>.
+class compact_optional_bitset
+{
+public:
+  typedef compact_optional<evp_bool> optional_type;
+  typedef std::size_t size_type;
+
+private:
+  std::vector<std::uint64_t> valid_;
+  std::vector<std::uint64_t> value_;
+  size_type size_;
+
+  static size_type words(size_type n) { return (n + 63) / 64; }
+  static std::uint64_t bit(size_type i) { return std::uint64_t(1) << (i % 64); }
+
+  // clears the bits past size() in the last word
+  void trim()
+  {
+    if (size_ % 64 != 0)
+    {
+      valid_.back() &= detail_::low_bits64(size_ % 64);
+      value_.back() &= detail_::low_bits64(size_ % 64);
+    }
+  }
+
+public:
+  explicit compact_optional_bitset(size_type n = 0)
+    : valid_(words(n)), value_(words(n)), size_(n) {}
+
+  size_type size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  void resize(size_type n) // new elements are empty
+  {
+    valid_.resize(words(n));
+    value_.resize(words(n));
+    size_ = n;
+    trim();
+  }
+
+  void push_back(const optional_type& o)
+  {
+    if (size_ % 64 == 0)
+    {
+      valid_.push_back(0);
+      value_.push_back(0);
+    }
+    set(size_++, o);
+  }
+
+  optional_type operator[](size_type i) const
+  {
+    assert (i < size_);
+    return (valid_[i / 64] & bit(i)) ? optional_type((value_[i / 64] & bit(i)) != 0) : optional_type();
+  }
+
+  void set(size_type i, const optional_type& o)
+  {
+    assert (i < size_);
+    char raw = o.unsafe_raw_value();
+    if (evp_bool::is_empty_value(raw))
+      reset(i);
+    else
+      set(i, evp_bool::access_value(raw));
+  }
+
+  void set(size_type i, bool v)
+  {
+    assert (i < size_);
+    valid_[i / 64] |= bit(i);
+    if (v)
+      value_[i / 64] |= bit(i);
+    else
+      value_[i / 64] &= ~bit(i);
+  }
+
+  void reset(size_type i)
+  {
+    assert (i < size_);
+    valid_[i / 64] &= ~bit(i);
+    value_[i / 64] &= ~bit(i);
+  }
+
+  size_type count_true() const
+  {
+    size_type c = 0;
+    for (size_type w = 0; w != value_.size(); ++w)
+      c += detail_::popcount64(value_[w]);
+    return c;
+  }
+
+  size_type count_false() const
+  {
+    size_type c = 0;
+    for (size_type w = 0; w != valid_.size(); ++w)
+      c += detail_::popcount64(valid_[w] & ~value_[w]);
+    return c;
+  }
+
+  size_type count_empty() const
+  {
+    size_type c = 0;
+    for (size_type w = 0; w != valid_.size(); ++w)
+      c += detail_::popcount64(valid_[w]);
+    return size_ - c;
+  }
+
+  // Three-valued (Kleene) logic: false && empty == false,
+  // true || empty == true, otherwise empty propagates.
+
+  compact_optional_bitset& operator&=(const compact_optional_bitset& rhs)
+  {
+    assert (size_ == rhs.size_);
+    for (size_type w = 0; w != valid_.size(); ++w)
+    {
+      std::uint64_t t = value_[w] & rhs.value_[w];
+      std::uint64_t f = (valid_[w] & ~value_[w]) | (rhs.valid_[w] & ~rhs.value_[w]);
+      value_[w] = t;
+      valid_[w] = t | f;
+    }
+    return *this;
+  }
+
+  compact_optional_bitset& operator|=(const compact_optional_bitset& rhs)
+  {
+    assert (size_ == rhs.size_);
+    for (size_type w = 0; w != valid_.size(); ++w)
+    {
+      std::uint64_t t = value_[w] | rhs.value_[w];
+      std::uint64_t f = (valid_[w] & ~value_[w]) & (rhs.valid_[w] & ~rhs.value_[w]);
+      value_[w] = t;
+      valid_[w] = t | f;
+    }
+    return *this;
+  }
+
+  // negates every element that has a value
+  compact_optional_bitset& flip()
+  {
+    for (size_type w = 0; w != valid_.size(); ++w)
+      value_[w] = valid_[w] & ~value_[w];
+    return *this;
+  }
+
+  friend compact_optional_bitset operator&(compact_optional_bitset l, const compact_optional_bitset& r)
+  {
+    return l &= r;
+  }
+
+  friend compact_optional_bitset operator|(compact_optional_bitset l, const compact_optional_bitset& r)
+  {
+    return l |= r;
+  }
+
+  friend compact_optional_bitset operator~(compact_optional_bitset b)
+  {
+    return b.flip();
+  }
+
+  // raw planes: (size() + 63) / 64 words each, bit i % 64 of word i / 64 for element i
+  const std::uint64_t* validity_words() const { return valid_.data(); }
+  const std::uint64_t* value_words() const { return value_.data(); }
+};
+
+} // namespace compact_optional_ns
+
+using compact_optional_ns::compact_optional_bitset;
+
+} // namespace ak_toolbox
+
+#endif //AK_TOOLBOX_COMPACT_OPTIONAL_BITSET_HEADER_GUARD_
@@ -0,0 +1,93 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef AK_TOOLBOX_COMPACT_OPTIONAL_CHRONO_HEADER_GUARD_
+#define AK_TOOLBOX_COMPACT_OPTIONAL_CHRONO_HEADER_GUARD_
+
+#include "compact_optional.hpp"
+#include "compact_optional_algorithm.hpp"
+#include "compact_optional_simd.hpp"
+#include <chrono>
+#include <limits>
+#include <type_traits>
+
+// Policies for std::chrono::duration and std::chrono::time_point with an
+// integral rep: the object is stored as its rep, and the smallest rep value
+// (Duration::min(), or the time point Duration::min() after the epoch) is
+// the empty value. They are member-storage policies over the rep, not
+// buffer-storage ones like compact_optional_pod_storage_type, so the batch
+// kernels and the gap-filling algorithms treat them as integers.
+
+namespace ak_toolbox {
+namespace compact_optional_ns {
+
+template <typename Duration>
+struct evp_duration : compact_optional_type<Duration, typename Duration::rep, Duration>
+{
+  typedef typename Duration::rep rep;
+  static_assert(std::is_integral<rep>::value, "evp_duration requires a duration with an integral rep");
+
+  static AK_TOOLBOX_CONSTEXPR rep empty_value() AK_TOOLBOX_NOEXCEPT { return std::numeric_limits<rep>::min(); }
+  static AK_TOOLBOX_CONSTEXPR bool is_empty_value(rep r) { return r == std::numeric_limits<rep>::min(); }
+
+  static AK_TOOLBOX_CONSTEXPR Duration access_value(rep r) { return Duration(r); }
+  static AK_TOOLBOX_CONSTEXPR rep store_value(Duration d) { return d.count(); }
+};
+
+template <typename TimePoint>
+struct evp_time_point : compact_optional_type<TimePoint, typename TimePoint::rep, TimePoint>
+{
+  typedef typename TimePoint::rep rep;
+  typedef typename TimePoint::duration duration;
+  static_assert(std::is_integral<rep>::value, "evp_time_point requires a time_point with an integral rep");
+
+  static AK_TOOLBOX_CONSTEXPR rep empty_value() AK_TOOLBOX_NOEXCEPT { return std::numeric_limits<rep>::min(); }
+  static AK_TOOLBOX_CONSTEXPR bool is_empty_value(rep r) { return r == std::numeric_limits<rep>::min(); }
+
+  static AK_TOOLBOX_CONSTEXPR TimePoint access_value(rep r) { return TimePoint(duration(r)); }
+  static AK_TOOLBOX_CONSTEXPR rep store_value(TimePoint t) { return t.time_since_epoch().count(); }
+};
+
+namespace detail_ {
+
+template <typename Duration>
+struct engaged_scan< evp_duration<Duration> >
+  : sentinel_engaged_scan<typename Duration::rep, std::numeric_limits<typename Duration::rep>::min()> {};
+
+template <typename TimePoint>
+struct engaged_scan< evp_time_point<TimePoint> >
+  : sentinel_engaged_scan<typename TimePoint::rep, std::numeric_limits<typename TimePoint::rep>::min()> {};
+
+// positions and intermediate values for interpolate_linear
+template <typename Rep, typename Period>
+struct interpolation<std::chrono::duration<Rep, Period>, void>
+{
+  typedef std::chrono::duration<Rep, Period> D;
+  static double position(D d) { return double(d.count()); }
+  static D between(D a, D b, double t) { return D(interpolation<Rep, void>::between(a.count(), b.count(), t)); }
+};
+
+template <typename Clock, typename Duration>
+struct interpolation<std::chrono::time_point<Clock, Duration>, void>
+{
+  typedef std::chrono::time_point<Clock, Duration> TP;
+  static double position(TP p) { return interpolation<Duration, void>::position(p.time_since_epoch()); }
+  static TP between(TP a, TP b, double t)
+  {
+    return TP(interpolation<Duration, void>::between(a.time_since_epoch(), b.time_since_epoch(), t));
+  }
+};
+
+} // namespace detail_
+
+} // namespace compact_optional_ns
+
+using compact_optional_ns::evp_duration;
+using compact_optional_ns::evp_time_point;
+
+} // namespace ak_toolbox
+
+#endif //AK_TOOLBOX_COMPACT_OPTIONAL_CHRONO_HEADER_GUARD_
@@ -0,0 +1,368 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef AK_TOOLBOX_COMPACT_OPTIONAL_CONVERT_HEADER_GUARD_
+#define AK_TOOLBOX_COMPACT_OPTIONAL_CONVERT_HEADER_GUARD_
+
+#include "compact_optional.hpp"
+#include "compact_optional_chrono.hpp"
+#include "compact_optional_simd.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if __cplusplus >= 201703L && defined __has_include
+#  if __has_include(<optional>)
+#    include <optional>
+#    define AK_TOOLBOX_STD_OPTIONAL
+#  endif
+#endif
+
+#if defined AK_TOOLBOX_STD_OPTIONAL
+
+// Bulk conversion between arrays of std::optional<T> and of compact_optional.
+// For the shipped scalar policies whose value and storage have 1, 4 or 8
+// bytes (evp_int, evp_enum, evp_bool, evp_fp_nan, evp_duration,
+// evp_time_point), 16 bytes are converted at a time with SSE2, reading the
+// value and the engaged flag of std::optional directly. This is done where
+// std::optional<T> is laid out as the value followed by a bool flag, which
+// is checked once at run time; other policies and layouts take a loop over
+// the elements. Either way the result is the same.
+//
+// Both directions may convert in place: `out` may point to the same memory
+// as `first`. Other overlaps are not supported.
+
+namespace ak_toolbox {
+namespace compact_optional_ns {
+namespace detail_ {
+
+// true if std::optional<T> is T followed by a bool flag, and twice the size of T
+template <typename T>
+bool plain_optional_layout()
+{
+  static const bool plain = [] {
+    if (sizeof(std::optional<T>) != 2 * sizeof(T))
+      return false;
+    const std::optional<T> e, v (T{});
+    unsigned char be[sizeof(e)], bv[sizeof(v)];
+    std::memcpy(be, &e, sizeof(e));
+    std::memcpy(bv, &v, sizeof(v));
+    return static_cast<const void*>(&*v) == static_cast<const void*>(&v) && be[sizeof(T)] == 0 && bv[sizeof(T)] == 1;
+  }();
+  return plain;
+}
+
+// Element by element. Going forwards in to_compact and backwards in
+// from_compact, each element is read before the bytes it occupies are
+// overwritten, also when out and in are the same address.
+
+template <typename EVP>
+std::size_t scalar_to_compact(const unsigned char* in, std::size_t from, std::size_t n, unsigned char* out)
+{
+  typedef typename EVP::storage_type storage_type;
+  typedef std::optional<typename EVP::value_type> opt_t;
+  std::size_t collision = n;
+  for (std::size_t i = from; i != n; ++i)
+  {
+    opt_t o;
+    std::memcpy(static_cast<void*>(&o), in + i * sizeof(opt_t), sizeof(opt_t));
+    const storage_type s = o ? storage_type(EVP::store_value(*o)) : storage_type(EVP::empty_value());
+    if (o && collision == n && EVP::is_empty_value(s))
+      collision = i;
+    std::memcpy(out + i * sizeof(storage_type), &s, sizeof(storage_type));
+  }
+  return collision;
+}
+
+template <typename EVP>
+void scalar_from_compact(const unsigned char* in, std::size_t n, unsigned char* out)
+{
+  typedef typename EVP::storage_type storage_type;
+  typedef std::optional<typename EVP::value_type> opt_t;
+  for (std::size_t i = n; i-- != 0; )
+  {
+    storage_type s;
+    std::memcpy(&s, in + i * sizeof(storage_type), sizeof(storage_type));
+    const opt_t o = EVP::is_empty_value(s) ? opt_t() : opt_t(EVP::access_value(s));
+    std::memcpy(out + i * sizeof(opt_t), static_cast<const void*>(&o), sizeof(opt_t));
+  }
+}
+
+// Which policies have the kernels: Size is the size of the value, NaN
+// whether any NaN is empty (otherwise the empty value is one bit pattern).
+template <std::size_t Size, bool NaN>
+struct optional_kernel_of
+{
+  static const bool enabled = Size == 1 || Size == 4 || Size == 8;
+  static const std::size_t size = Size;
+  static const bool nan = NaN;
+};
+
+template <typename EVP>
+struct optional_kernel { static const bool enabled = false; };
+
+template <typename T, T Val>
+struct optional_kernel< evp_int<T, Val> > : optional_kernel_of<sizeof(T), false> {};
+
+template <typename FPT>
+struct optional_kernel< evp_fp_nan<FPT> > : optional_kernel_of<sizeof(FPT), true> {};
+
+template <>
+struct optional_kernel<evp_bool> : optional_kernel_of<1, false> {};
+
+#ifndef AK_TOOLBOX_NO_UNDERLYING_TYPE
+template <typename Enum, typename std::underlying_type<Enum>::type Val>
+struct optional_kernel< evp_enum<Enum, Val> > : optional_kernel_of<sizeof(Enum), false> {};
+#else
+template <typename Enum, int Val>
+struct optional_kernel< evp_enum<Enum, Val> > : optional_kernel_of<sizeof(Enum) == sizeof(int) ? sizeof(int) : 0, false> {};
+#endif // AK_TOOLBOX_NO_UNDERLYING_TYPE
+
+template <typename Duration>
+struct optional_kernel< evp_duration<Duration> > : optional_kernel_of<sizeof(Duration), false> {};
+
+template <typename TimePoint>
+struct optional_kernel< evp_time_point<TimePoint> > : optional_kernel_of<sizeof(TimePoint), false> {};
+
+#if defined AK_TOOLBOX_SIMD_SSE2
+
+inline __m128i load16(const unsigned char* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+inline void store16(unsigned char* p, __m128i v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+
+// the empty value in every lane where it is empty, v elsewhere
+inline __m128i select_empty(__m128i empty, __m128i s, __m128i v)
+{
+  return _mm_or_si128(_mm_and_si128(empty, s), _mm_andnot_si128(empty, v));
+}
+
+// to_compact converts `width` elements and returns a bit per element whose
+// value is the empty value; from_compact converts `width` elements back.
+// Both load everything before storing anything.
+template <std::size_t Size, bool NaN>
+struct optional_lanes;
+
+template <>
+struct optional_lanes<1, false>
+{
+  static const std::size_t width = 16;
+
+  static __m128i broadcast(const void* s) { char c; std::memcpy(&c, s, 1); return _mm_set1_epi8(c); }
+
+  static unsigned to_compact(const unsigned char* in, unsigned char* out, __m128i s)
+  {
+    const __m128i a = load16(in), b = load16(in + 16);
+    const __m128i low = _mm_set1_epi16(0xFF);
+    const __m128i v = _mm_packus_epi16(_mm_and_si128(a, low), _mm_and_si128(b, low));
+    const __m128i f = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+    const __m128i empty = _mm_cmpeq_epi8(f, _mm_setzero_si128());
+    store16(out, select_empty(empty, s, v));
+    return unsigned(_mm_movemask_epi8(_mm_andnot_si128(empty, _mm_cmpeq_epi8(v, s))));
+  }
+
+  static void from_compact(const unsigned char* in, unsigned char* out, __m128i s)
+  {
+    const __m128i v = load16(in);
+    const __m128i f = _mm_andnot_si128(_mm_cmpeq_epi8(v, s), _mm_set1_epi8(1));
+    const __m128i lo = _mm_unpacklo_epi8(v, f), hi = _mm_unpackhi_epi8(v, f);
+    store16(out, lo);
+    store16(out + 16, hi);
+  }
+};
+
+template <bool NaN>
+struct optional_lanes<4, NaN>
+{
+  static const std::size_t width = 4;
+
+  static __m128i broadcast(const void* s) { int i; std::memcpy(&i, s, 4); return _mm_set1_epi32(i); }
+
+  static __m128i is_empty(__m128i v, __m128i s)
+  {
+    if (NaN)
+      return _mm_castps_si128(_mm_cmpunord_ps(_mm_castsi128_ps(v), _mm_castsi128_ps(v)));
+    return _mm_cmpeq_epi32(v, s);
+  }
+
+  static unsigned to_compact(const unsigned char* in, unsigned char* out, __m128i s)
+  {
+    const __m128 a = _mm_castsi128_ps(load16(in)), b = _mm_castsi128_ps(load16(in + 16));
+    const __m128i v = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+    const __m128i f = _mm_and_si128(_mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))), _mm_set1_epi32(0xFF));
+    const __m128i empty = _mm_cmpeq_epi32(f, _mm_setzero_si128());
+    store16(out, select_empty(empty, s, v));
+    return unsigned(_mm_movemask_ps(_mm_castsi128_ps(_mm_andnot_si128(empty, is_empty(v, s)))));
+  }
+
+  static void from_compact(const unsigned char* in, unsigned char* out, __m128i s)
+  {
+    const __m128i v = load16(in);
+    const __m128i f = _mm_andnot_si128(is_empty(v, s), _mm_set1_epi32(1));
+    const __m128i lo = _mm_unpacklo_epi32(v, f), hi = _mm_unpackhi_epi32(v, f);
+    store16(out, lo);
+    store16(out + 16, hi);
+  }
+};
+
+template <bool NaN>
+struct optional_lanes<8, NaN>
+{
+  static const std::size_t width = 2;
+
+  static __m128i broadcast(const void* s) { long long i; std::memcpy(&i, s, 8); return _mm_set1_epi64x(i); }
+
+  static __m128i is_empty(__m128i v, __m128i s)
+  {
+    if (NaN)
+      return _mm_castpd_si128(_mm_cmpunord_pd(_mm_castsi128_pd(v), _mm_castsi128_pd(v)));
+    const __m128i e = _mm_cmpeq_epi32(v, s);
+    return _mm_and_si128(e, _mm_shuffle_epi32(e, _MM_SHUFFLE(2, 3, 0, 1)));
+  }
+
+  static unsigned to_compact(const unsigned char* in, unsigned char* out, __m128i s)
+  {
+    const __m128i a = load16(in), b = load16(in + 16);
+    const __m128i v = _mm_unpacklo_epi64(a, b);
+    const __m128i f = _mm_and_si128(_mm_unpackhi_epi64(a, b), _mm_set_epi32(0, 0xFF, 0, 0xFF));
+    const __m128i empty = _mm_shuffle_epi32(_mm_cmpeq_epi32(f, _mm_setzero_si128()), _MM_SHUFFLE(2, 2, 0, 0));
+    store16(out, select_empty(empty, s, v));
+    return unsigned(_mm_movemask_pd(_mm_castsi128_pd(_mm_andnot_si128(empty, is_empty(v, s)))));
+  }
+
+  static void from_compact(const unsigned char* in, unsigned char* out, __m128i s)
+  {
+    const __m128i v = load16(in);
+    const __m128i f = _mm_andnot_si128(is_empty(v, s), _mm_set_epi32(0, 1, 0, 1));
+    const __m128i lo = _mm_unpacklo_epi64(v, f), hi = _mm_unpackhi_epi64(v, f);
+    store16(out, lo);
+    store16(out + 16, hi);
+  }
+};
+
+template <typename EVP>
+std::size_t to_compact(const unsigned char* in, std::size_t n, unsigned char* out, std::true_type)
+{
+  typedef optional_kernel<EVP> kernel;
+  typedef optional_lanes<kernel::size, kernel::nan> lanes;
+  typedef typename EVP::storage_type storage_type;
+  typedef typename EVP::value_type value_type;
+
+  std::size_t i = 0, collision = n;
+  if (plain_optional_layout<value_type>())
+  {
+    const storage_type e = EVP::empty_value();
+    const __m128i s = lanes::broadcast(&e);
+    for (; i + lanes::width <= n; i += lanes::width)
+    {
+      const unsigned c = lanes::to_compact(in + i * 2 * sizeof(storage_type), out + i * sizeof(storage_type), s);
+      if (c != 0 && collision == n)
+        collision = i + lowest_bit64(c);
+    }
+  }
+  const std::size_t tail = scalar_to_compact<EVP>(in, i, n, out);
+  return collision != n ? collision : tail;
+}
+
+template <typename EVP>
+void from_compact(const unsigned char* in, std::size_t n, unsigned char* out, std::true_type)
+{
+  typedef optional_kernel<EVP> kernel;
+  typedef optional_lanes<kernel::size, kernel::nan> lanes;
+  typedef typename EVP::storage_type storage_type;
+
+  if (!plain_optional_layout<typename EVP::value_type>())
+    return scalar_from_compact<EVP>(in, n, out);
+
+  // backwards: the tail first, then whole blocks
+  const std::size_t blocks = n - n % lanes::width;
+  scalar_from_compact<EVP>(in + blocks * sizeof(storage_type), n - blocks, out + blocks * 2 * sizeof(storage_type));
+  const storage_type e = EVP::empty_value();
+  const __m128i s = lanes::broadcast(&e);
+  for (std::size_t i = blocks; i != 0; )
+  {
+    i -= lanes::width;
+    lanes::from_compact(in + i * sizeof(storage_type), out + i * 2 * sizeof(storage_type), s);
+  }
+}
+
+#endif // AK_TOOLBOX_SIMD_SSE2
+
+template <typename EVP>
+std::size_t to_compact(const unsigned char* in, std::size_t n, unsigned char* out, std::false_type)
+{
+  return scalar_to_compact<EVP>(in, 0, n, out);
+}
+
+template <typename EVP>
+void from_compact(const unsigned char* in, std::size_t n, unsigned char* out, std::false_type)
+{
+  scalar_from_compact<EVP>(in, n, out);
+}
+
+template <typename EVP>
+struct use_optional_kernel : std::integral_constant<bool,
+#if defined AK_TOOLBOX_SIMD_SSE2
+  optional_kernel<EVP>::enabled && sizeof(typename EVP::value_type) == sizeof(typename EVP::storage_type)
+#else
+  false
+#endif // AK_TOOLBOX_SIMD_SSE2
+  > {};
+
+template <typename EVP, typename Tag>
+void check_convertible()
+{
+  typedef compact_optional<EVP, Tag> opt_t;
+  static_assert(std::is_trivially_copyable<typename EVP::value_type>::value
+             && std::is_trivially_copyable<std::optional<typename EVP::value_type>>::value
+             && std::is_trivially_copyable<opt_t>::value,
+                "bulk conversion requires trivially copyable values and compact_optional");
+  static_assert(sizeof(opt_t) == sizeof(typename EVP::storage_type) && std::is_standard_layout<opt_t>::value,
+                "compact_optional must have the layout of its storage_type");
+  static_assert(sizeof(opt_t) <= sizeof(std::optional<typename EVP::value_type>),
+                "in-place conversion needs compact_optional no larger than std::optional");
+}
+
+} // namespace detail_
+
+// Converts [first, last) into compact_optional objects starting at out.
+// Returns the first element whose value is the empty value of EVP, which is
+// stored as an empty object, or last if there is none; the other elements
+// are converted regardless.
+template <typename EVP, typename Tag>
+const std::optional<typename EVP::value_type>* to_compact(const std::optional<typename EVP::value_type>* first,
+                                                         const std::optional<typename EVP::value_type>* last,
+                                                         compact_optional<EVP, Tag>* out)
+{
+  detail_::check_convertible<EVP, Tag>();
+  const std::size_t n = last - first;
+  return first + detail_::to_compact<EVP>(reinterpret_cast<const unsigned char*>(first), n,
+                                          reinterpret_cast<unsigned char*>(out), detail_::use_optional_kernel<EVP>());
+}
+
+// Converts [first, last) into std::optional objects starting at out;
+// returns the end of the output.
+template <typename EVP, typename Tag>
+std::optional<typename EVP::value_type>* from_compact(const compact_optional<EVP, Tag>* first,
+                                                      const compact_optional<EVP, Tag>* last,
+                                                      std::optional<typename EVP::value_type>* out)
+{
+  detail_::check_convertible<EVP, Tag>();
+  const std::size_t n = last - first;
+  detail_::from_compact<EVP>(reinterpret_cast<const unsigned char*>(first), n,
+                             reinterpret_cast<unsigned char*>(out), detail_::use_optional_kernel<EVP>());
+  return out + n;
+}
+
+} // namespace compact_optional_ns
+
+using compact_optional_ns::to_compact;
+using compact_optional_ns::from_compact;
+
+} // namespace ak_toolbox
+
+#endif // AK_TOOLBOX_STD_OPTIONAL
+
+#endif //AK_TOOLBOX_COMPACT_OPTIONAL_CONVERT_HEADER_GUARD_
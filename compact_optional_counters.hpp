@@ -0,0 +1,147 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef AK_TOOLBOX_COMPACT_OPTIONAL_COUNTERS_HEADER_GUARD_
+#define AK_TOOLBOX_COMPACT_OPTIONAL_COUNTERS_HEADER_GUARD_
+
+#include "compact_optional.hpp"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+// The check_count mode: per-policy counts of what happens to compact_optional
+// objects, for finding sentinel collisions and empty accesses in production.
+// Each thread counts into its own block, without locking or atomic
+// read-modify-write; compact_optional_counters<EVP>() sums the blocks of the
+// live threads and the totals of the finished ones.
+//
+// Select it for one policy with `typedef check_count collision_check;` or for
+// all with -DAK_TOOLBOX_COLLISION_CHECK=check_count, and include this header
+// before the first use of compact_optional. In this mode compact_optional is
+// neither trivially copyable nor usable in constant expressions.
+
+namespace ak_toolbox {
+namespace compact_optional_ns {
+
+struct compact_optional_counts
+{
+  std::uint64_t collisions;     // stored values equal to the empty value
+  std::uint64_t empty_accesses; // value() on an empty object
+  std::uint64_t constructions;  // other than copies and moves
+  std::uint64_t copies;         // copy constructions and assignments
+  std::uint64_t moves;          // move constructions and assignments
+};
+
+namespace detail_ {
+
+const int counter_kinds = 5;
+
+struct counter_block
+{
+  std::atomic<std::uint64_t> counts[counter_kinds];
+  counter_block* prev;
+  counter_block* next;
+
+  // only the owning thread writes: a plain load and store is enough
+  void bump(int kind) AK_TOOLBOX_NOEXCEPT
+  {
+    counts[kind].store(counts[kind].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+};
+
+struct counter_registry
+{
+  std::mutex mutex;
+  counter_block* live;
+  std::uint64_t finished[counter_kinds];
+
+  counter_registry() : live(0)
+  {
+    for (int k = 0; k != counter_kinds; ++k)
+      finished[k] = 0;
+  }
+};
+
+template <typename EVP>
+counter_registry& registry_of()
+{
+  static counter_registry r;
+  return r;
+}
+
+template <typename EVP>
+struct thread_counters : counter_block
+{
+  thread_counters()
+  {
+    for (int k = 0; k != counter_kinds; ++k)
+      counts[k].store(0, std::memory_order_relaxed);
+    counter_registry& r = registry_of<EVP>();
+    std::lock_guard<std::mutex> lock (r.mutex);
+    prev = 0;
+    next = r.live;
+    if (next)
+      next->prev = this;
+    r.live = this;
+  }
+
+  ~thread_counters()
+  {
+    counter_registry& r = registry_of<EVP>();
+    std::lock_guard<std::mutex> lock (r.mutex);
+    for (int k = 0; k != counter_kinds; ++k)
+      r.finished[k] += counts[k].load(std::memory_order_relaxed);
+    (prev ? prev->next : r.live) = next;
+    if (next)
+      next->prev = prev;
+  }
+};
+
+template <typename EVP>
+counter_block& local_counters()
+{
+  static thread_local thread_counters<EVP> block;
+  return block;
+}
+
+} // namespace detail_
+
+struct check_count
+{
+  template <typename EVP> static void collision() { detail_::local_counters<EVP>().bump(0); }
+  template <typename EVP> static void empty_access() { detail_::local_counters<EVP>().bump(1); }
+  template <typename EVP> static void constructed() { detail_::local_counters<EVP>().bump(2); }
+  template <typename EVP> static void copied() { detail_::local_counters<EVP>().bump(3); }
+  template <typename EVP> static void moved() { detail_::local_counters<EVP>().bump(4); }
+};
+
+// Counts so far, in all threads, for objects with policy EVP. For
+// compact_optional<compact_optional<E>>, EVP is evp_nested<E, Tag>.
+template <typename EVP>
+compact_optional_counts compact_optional_counters()
+{
+  std::uint64_t sum[detail_::counter_kinds];
+  detail_::counter_registry& r = detail_::registry_of<EVP>();
+  {
+    std::lock_guard<std::mutex> lock (r.mutex);
+    for (int k = 0; k != detail_::counter_kinds; ++k)
+      sum[k] = r.finished[k];
+    for (const detail_::counter_block* b = r.live; b; b = b->next)
+      for (int k = 0; k != detail_::counter_kinds; ++k)
+        sum[k] += b->counts[k].load(std::memory_order_relaxed);
+  }
+  compact_optional_counts c = { sum[0], sum[1], sum[2], sum[3], sum[4] };
+  return c;
+}
+
+} // namespace compact_optional_ns
+
+using compact_optional_ns::compact_optional_counts;
+using compact_optional_ns::compact_optional_counters;
+
+} // namespace ak_toolbox
+
+#endif //AK_TOOLBOX_COMPACT_OPTIONAL_COUNTERS_HEADER_GUARD_
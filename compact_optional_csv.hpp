@@ -0,0 +1,448 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef AK_TOOLBOX_COMPACT_OPTIONAL_CSV_HEADER_GUARD_
+#define AK_TOOLBOX_COMPACT_OPTIONAL_CSV_HEADER_GUARD_
+
+#include "compact_optional.hpp"
+#include "compact_optional_mapped_file.hpp"
+#include <cerrno>
+#include <clocale>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <tuple>
+
+#if __cplusplus >= 201703L && defined __has_include
+#  if __has_include(<charconv>)
+#    include <charconv>
+#    if defined __cpp_lib_to_chars
+#      define AK_TOOLBOX_CSV_FROM_CHARS
+#    endif
+#  endif
+#endif
+
+// Streaming parser of delimited text (CSV and the like) into preallocated
+// arrays of compact_optional, one array per column. Empty fields and the
+// null token (by default NULL) are stored as the empty value; a field whose
+// value would be stored as the empty value is reported as an error, rather
+// than silently read back as missing.
+//
+// Fields are not quoted and contain no delimiters or line breaks. Lines end
+// with "\n" or "\r\n"; blank lines are skipped.
+
+namespace ak_toolbox {
+namespace compact_optional_ns {
+
+enum csv_error
+{
+  csv_ok = 0,
+  csv_bad_value,          // the field is not a valid value_type
+  csv_sentinel_collision, // the value is the policy's empty value
+  csv_too_few_fields,
+  csv_too_many_fields,
+  csv_columns_full,       // more rows than the columns can hold
+  csv_file_error          // parse_csv_file could not read the file
+};
+
+// `line` counts from 1 and includes the header line; `column` counts from 0
+struct csv_status
+{
+  csv_error error;
+  std::size_t line;
+  std::size_t column;
+
+  bool ok() const { return error == csv_ok; }
+};
+
+struct csv_options
+{
+  char delimiter;
+  const char* null_token; // null or "" for none
+  bool header;            // skip the first line
+
+  csv_options() : delimiter(','), null_token("NULL"), header(false) {}
+};
+
+namespace detail_ {
+
+// Field parsers: parse(b, e, out) returns false unless all of [b, e) is a
+// valid value.
+
+template <typename T, typename = void>
+struct csv_field
+{
+  static_assert(sizeof(T) == 0, "csv: unsupported value_type");
+};
+
+template <typename T>
+struct csv_field<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type>
+{
+  static bool parse(const char* b, const char* e, T& out)
+  {
+    typedef typename std::make_unsigned<T>::type U;
+    bool neg = false;
+    if (b != e && (*b == '-' || *b == '+'))
+    {
+      neg = *b == '-';
+      ++b;
+      if (neg && !std::is_signed<T>::value)
+        return false;
+    }
+    if (b == e)
+      return false;
+
+    const std::uint64_t limit = neg ? std::uint64_t(U(std::numeric_limits<T>::max())) + 1
+                                    : std::uint64_t(std::numeric_limits<T>::max());
+    std::uint64_t v = 0;
+    for (; b != e; ++b)
+    {
+      const unsigned d = unsigned(*b) - unsigned('0');
+      if (d > 9 || v > (limit - d) / 10)
+        return false;
+      v = v * 10 + d;
+    }
+    out = neg ? T(U(0) - U(v)) : T(v);
+    return true;
+  }
+};
+
+template <>
+struct csv_field<bool>
+{
+  static bool parse(const char* b, const char* e, bool& out)
+  {
+    const std::size_t n = e - b;
+    if ((n == 1 && *b == '1') || (n == 4 && std::memcmp(b, "true", 4) == 0))
+      out = true;
+    else if ((n == 1 && *b == '0') || (n == 5 && std::memcmp(b, "false", 5) == 0))
+      out = false;
+    else
+      return false;
+    return true;
+  }
+};
+
+inline bool csv_is_digit(char c) { return unsigned(c) - unsigned('0') < 10; }
+
+inline bool csv_matches_nocase(const char* b, const char* e, const char* word)
+{
+  for (; b != e && *word; ++b, ++word)
+    if ((*b | 0x20) != *word)
+      return false;
+  return b == e && !*word;
+}
+
+// The syntax from_chars accepts in chars_format::general, after an optional
+// '-': inf, infinity, nan and nan(chars) in any case, or decimal digits with
+// an optional point and exponent. No hex floats and no spaces.
+inline bool csv_float_syntax(const char* b, const char* e)
+{
+  if (b != e && *b == '-')
+    ++b;
+  if (csv_matches_nocase(b, e, "inf") || csv_matches_nocase(b, e, "infinity") || csv_matches_nocase(b, e, "nan"))
+    return true;
+  if (e - b >= 5 && csv_matches_nocase(b, b + 4, "nan(") && e[-1] == ')')
+  {
+    for (b += 4; b != e - 1; ++b)
+      if (!csv_is_digit(*b) && ((*b | 0x20) < 'a' || (*b | 0x20) > 'z') && *b != '_')
+        return false;
+    return true;
+  }
+
+  std::size_t digits = 0;
+  for (; b != e && csv_is_digit(*b); ++b)
+    ++digits;
+  if (b != e && *b == '.')
+    for (++b; b != e && csv_is_digit(*b); ++b)
+      ++digits;
+  if (digits == 0)
+    return false;
+  if (b != e && (*b == 'e' || *b == 'E'))
+  {
+    ++b;
+    if (b != e && (*b == '-' || *b == '+'))
+      ++b;
+    if (b == e)
+      return false;
+    for (; b != e; ++b)
+      if (!csv_is_digit(*b))
+        return false;
+  }
+  return b == e;
+}
+
+inline void csv_strto(const char* s, char** end, float& out) { out = std::strtof(s, end); }
+inline void csv_strto(const char* s, char** end, double& out) { out = std::strtod(s, end); }
+inline void csv_strto(const char* s, char** end, long double& out) { out = std::strtold(s, end); }
+
+template <typename T>
+struct csv_field<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+{
+  static bool parse(const char* b, const char* e, T& out)
+  {
+    if (b != e && *b == '+' && e - b > 1 && b[1] != '-')
+      ++b;
+    if (b == e)
+      return false;
+#if defined AK_TOOLBOX_CSV_FROM_CHARS
+    std::from_chars_result r = std::from_chars(b, e, out);
+    return r.ec == std::errc() && r.ptr == e;
+#else
+    // strtod accepts more than from_chars (hex floats, leading spaces), so the
+    // syntax is checked first. It needs a terminated string, and reads the
+    // decimal point of the C locale, which replaces the '.' in the copy.
+    char buf[64];
+    const std::size_t n = e - b;
+    if (n >= sizeof buf || !csv_float_syntax(b, e))
+      return false;
+    std::memcpy(buf, b, n);
+    buf[n] = '\0';
+    const char point = *std::localeconv()->decimal_point;
+    if (char* p = static_cast<char*>(std::memchr(buf, '.', n)))
+      *p = point;
+    char* end;
+    errno = 0;
+    csv_strto(buf, &end, out); // overflow and underflow: ERANGE, as from_chars' result_out_of_range
+    return end == buf + n && errno != ERANGE;
+#endif
+  }
+};
+
+// enums are read as their underlying type, so that out-of-range values are errors
+template <typename T>
+struct csv_field<T, typename std::enable_if<std::is_enum<T>::value>::type>
+{
+  static bool parse(const char* b, const char* e, T& out)
+  {
+    typename enum_integer<T>::type v;
+    if (!csv_field<typename enum_integer<T>::type>::parse(b, e, v))
+      return false;
+    out = static_cast<T>(v);
+    return true;
+  }
+};
+
+template <>
+struct csv_field<std::string>
+{
+  static bool parse(const char* b, const char* e, std::string& out)
+  {
+    out.assign(b, e);
+    return true;
+  }
+};
+
+template <typename EVP, typename Tag>
+csv_error store_field(compact_optional<EVP, Tag>& out, const char* b, const char* e)
+{
+  typedef typename EVP::value_type value_type;
+  value_type v;
+  if (!csv_field<value_type>::parse(b, e, v))
+    return csv_bad_value;
+  if (EVP::is_empty_value(EVP::store_value(v)))
+    return csv_sentinel_collision;
+  out = compact_optional<EVP, Tag>(std::move(v));
+  return csv_ok;
+}
+
+} // namespace detail_
+
+// Parses rows into the arrays given in the constructor, which have room for
+// `capacity` rows. Input may come in chunks of any size (e.g. as read from a
+// socket); a line split between chunks is buffered. The first error stops
+// the parsing: later calls return the same status. Rows before the failing
+// one are complete; the failing row may be partly written.
+template <typename... EVPs>
+class csv_column_reader
+{
+  static const std::size_t columns = sizeof...(EVPs);
+  static_assert(columns != 0, "csv_column_reader needs at least one column");
+
+  std::tuple<compact_optional<EVPs>*...> columns_;
+  std::size_t capacity_;
+  csv_options options_;
+  std::size_t null_length_;
+  std::size_t rows_;
+  std::size_t line_;
+  csv_status status_;
+  std::string carry_; // the unfinished line of the previous chunk
+
+  bool fail(csv_error err, std::size_t column)
+  {
+    status_.error = err;
+    status_.line = line_;
+    status_.column = column;
+    return false;
+  }
+
+  bool is_null(const char* b, const char* e) const
+  {
+    return b == e || (std::size_t(e - b) == null_length_ && null_length_ != 0
+                      && std::memcmp(b, options_.null_token, null_length_) == 0);
+  }
+
+  template <std::size_t I>
+  bool parse_field(const char* b, const char* e)
+  {
+    compact_optional< typename std::tuple_element<I, std::tuple<EVPs...> >::type >& out = std::get<I>(columns_)[rows_];
+    if (is_null(b, e))
+    {
+      out.reset();
+      return true;
+    }
+    csv_error err = detail_::store_field(out, b, e);
+    return err == csv_ok || fail(err, I);
+  }
+
+  template <std::size_t I>
+  bool parse_fields(const char* b, const char* e, std::true_type /*last*/)
+  {
+    const char* d = b;
+    while (d != e && *d != options_.delimiter)
+      ++d;
+    if (d != e)
+      return fail(csv_too_many_fields, columns);
+    return parse_field<I>(b, e);
+  }
+
+  template <std::size_t I>
+  bool parse_fields(const char* b, const char* e, std::false_type)
+  {
+    const char* d = b;
+    while (d != e && *d != options_.delimiter)
+      ++d;
+    if (d == e)
+      return fail(csv_too_few_fields, I + 1);
+    return parse_field<I>(b, d)
+        && parse_fields<I + 1>(d + 1, e, std::integral_constant<bool, I + 2 == columns>());
+  }
+
+  bool parse_line(const char* b, const char* e)
+  {
+    ++line_;
+    if (e != b && e[-1] == '\r')
+      --e;
+    if ((line_ == 1 && options_.header) || b == e)
+      return true;
+    if (rows_ == capacity_)
+      return fail(csv_columns_full, 0);
+    if (!parse_fields<0>(b, e, std::integral_constant<bool, columns == 1>()))
+      return false;
+    ++rows_;
+    return true;
+  }
+
+  void init()
+  {
+    null_length_ = options_.null_token ? std::strlen(options_.null_token) : 0;
+    rows_ = 0;
+    line_ = 0;
+    status_.error = csv_ok;
+    status_.line = 0;
+    status_.column = 0;
+  }
+
+public:
+  csv_column_reader(std::size_t capacity, compact_optional<EVPs>*... cols)
+    : columns_(cols...), capacity_(capacity)
+  {
+    init();
+  }
+
+  csv_column_reader(const csv_options& options, std::size_t capacity, compact_optional<EVPs>*... cols)
+    : columns_(cols...), capacity_(capacity), options_(options)
+  {
+    init();
+  }
+
+  // parses the complete lines in [data, data + len)
+  csv_status feed(const char* data, std::size_t len)
+  {
+    if (!status_.ok() || len == 0)
+      return status_;
+
+    const char* p = data;
+    const char* end = data + len;
+    if (!carry_.empty())
+    {
+      const char* nl = static_cast<const char*>(std::memchr(p, '\n', len));
+      if (!nl)
+      {
+        carry_.append(p, end);
+        return status_;
+      }
+      carry_.append(p, nl);
+      p = nl + 1;
+      bool ok = parse_line(carry_.data(), carry_.data() + carry_.size());
+      carry_.clear();
+      if (!ok)
+        return status_;
+    }
+
+    while (p != end)
+    {
+      const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+      if (!nl)
+      {
+        carry_.assign(p, end);
+        break;
+      }
+      if (!parse_line(p, nl))
+        return status_;
+      p = nl + 1;
+    }
+    return status_;
+  }
+
+  // parses the last line, if the input does not end with a line break
+  csv_status finish()
+  {
+    if (status_.ok() && !carry_.empty())
+      parse_line(carry_.data(), carry_.data() + carry_.size());
+    carry_.clear();
+    return status_;
+  }
+
+  csv_status status() const { return status_; }
+  std::size_t rows() const { return rows_; }
+};
+
+// Parses a whole file, mapped into memory where possible.
+template <typename... EVPs>
+csv_status parse_csv_file(const char* path, csv_column_reader<EVPs...>& reader)
+{
+  mapped_file f (path);
+  if (!f.is_open())
+  {
+    csv_status s = { csv_file_error, 0, 0 };
+    return s;
+  }
+  reader.feed(f.data(), f.size());
+  return reader.finish();
+}
+
+} // namespace compact_optional_ns
+
+using compact_optional_ns::csv_error;
+using compact_optional_ns::csv_ok;
+using compact_optional_ns::csv_bad_value;
+using compact_optional_ns::csv_sentinel_collision;
+using compact_optional_ns::csv_too_few_fields;
+using compact_optional_ns::csv_too_many_fields;
+using compact_optional_ns::csv_columns_full;
+using compact_optional_ns::csv_file_error;
+using compact_optional_ns::csv_status;
+using compact_optional_ns::csv_options;
+using compact_optional_ns::csv_column_reader;
+using compact_optional_ns::parse_csv_file;
+
+} // namespace ak_toolbox
+
+#endif //AK_TOOLBOX_COMPACT_OPTIONAL_CSV_HEADER_GUARD_
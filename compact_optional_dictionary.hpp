@@ -0,0 +1,344 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef AK_TOOLBOX_COMPACT_OPTIONAL_DICTIONARY_HEADER_GUARD_
+#define AK_TOOLBOX_COMPACT_OPTIONAL_DICTIONARY_HEADER_GUARD_
+
+#include "compact_optional.hpp"
+#include "compact_optional_simd.hpp"
+#include "compact_optional_vector.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if __cplusplus >= 201703L && defined __has_include
+#  if __has_include(<string_view>)
+#    include <string_view>
+#    define AK_TOOLBOX_DICTIONARY_STRING_VIEW
+#  endif
+#endif
+
+// Dictionary-encoded optional strings. A string_dictionary owns one copy of
+// each distinct string, in an arena of large blocks, and numbers them from
+// 0. A dictionary_column stores one compact_optional<evp_dictionary_id> (4
+// bytes) per element instead of a string, so a column of repetitive strings
+// costs 4 bytes per row plus the distinct strings once. Comparing elements
+// with a string is comparing ids, and needs no string compares.
+
+namespace ak_toolbox {
+namespace compact_optional_ns {
+
+#if defined AK_TOOLBOX_DICTIONARY_STRING_VIEW
+
+typedef std::string_view string_ref;
+
+#else
+
+// a stand-in for std::string_view before C++17
+class string_ref
+{
+  const char* data_;
+  std::size_t size_;
+
+public:
+  string_ref() : data_(""), size_(0) {}
+  string_ref(const char* s) : data_(s), size_(std::strlen(s)) {}
+  string_ref(const char* s, std::size_t n) : data_(s), size_(n) {}
+  string_ref(const std::string& s) : data_(s.data()), size_(s.size()) {}
+
+  const char* data() const { return data_; }
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const char* begin() const { return data_; }
+  const char* end() const { return data_ + size_; }
+
+  explicit operator std::string() const { return std::string(data_, size_); }
+
+  friend bool operator==(string_ref a, string_ref b)
+  {
+    return a.size_ == b.size_ && std::memcmp(a.data_, b.data_, a.size_) == 0;
+  }
+  friend bool operator!=(string_ref a, string_ref b) { return !(a == b); }
+};
+
+#endif // AK_TOOLBOX_DICTIONARY_STRING_VIEW
+
+typedef evp_int<std::uint32_t, UINT32_MAX> evp_dictionary_id;
+typedef compact_optional<evp_dictionary_id> dictionary_id;
+
+namespace detail_ {
+
+inline std::uint32_t fnv1a32(const char* p, std::size_t n)
+{
+  std::uint32_t h = 2166136261u;
+  for (std::size_t i = 0; i != n; ++i)
+    h = (h ^ static_cast<unsigned char>(p[i])) * 16777619u;
+  return h;
+}
+
+} // namespace detail_
+
+class string_dictionary
+{
+public:
+  typedef std::uint32_t id_type;
+
+private:
+  static const std::uint32_t no_id = UINT32_MAX;
+
+  std::size_t block_bytes_;
+  std::vector< std::unique_ptr<char[]> > blocks_; // kept by reset(), for the next batch
+  std::size_t block_;                             // the block being filled
+  std::size_t used_;                              // bytes used in blocks_[block_]
+  std::vector< std::unique_ptr<char[]> > large_;  // strings over a quarter of a block
+  std::size_t large_bytes_;
+
+  std::vector<string_ref> strings_;    // by id
+  std::vector<std::uint32_t> hashes_;  // by id
+  std::vector<std::uint32_t> index_;   // ids, or no_id; linear probing, at most half full
+
+  const char* copy(string_ref s)
+  {
+    const std::size_t n = s.size();
+    char* p;
+    if (n > block_bytes_ / 4)
+    {
+      large_.push_back(std::unique_ptr<char[]>(new char[n]));
+      large_bytes_ += n;
+      p = large_.back().get();
+    }
+    else
+    {
+      if (blocks_.empty() || used_ + n > block_bytes_)
+      {
+        if (!blocks_.empty())
+          ++block_;
+        if (block_ == blocks_.size())
+          blocks_.push_back(std::unique_ptr<char[]>(new char[block_bytes_]));
+        used_ = 0;
+      }
+      p = blocks_[block_].get() + used_;
+      used_ += n;
+    }
+    if (n != 0)
+      std::memcpy(p, s.data(), n);
+    return p;
+  }
+
+  // the index slot holding s, or the free slot where s belongs
+  std::size_t slot_of(string_ref s, std::uint32_t h) const
+  {
+    const std::size_t mask = index_.size() - 1;
+    std::size_t i = h & mask;
+    while (index_[i] != no_id && !(hashes_[index_[i]] == h && strings_[index_[i]] == s))
+      i = (i + 1) & mask;
+    return i;
+  }
+
+  void grow_index()
+  {
+    std::vector<std::uint32_t> index (index_.empty() ? 64 : index_.size() * 2, std::uint32_t(no_id));
+    const std::size_t mask = index.size() - 1;
+    for (std::uint32_t id = 0; id != strings_.size(); ++id)
+    {
+      std::size_t i = hashes_[id] & mask;
+      while (index[i] != no_id)
+        i = (i + 1) & mask;
+      index[i] = id;
+    }
+    index_.swap(index);
+  }
+
+public:
+  explicit string_dictionary(std::size_t block_bytes = 64 * 1024)
+    : block_bytes_(block_bytes), block_(0), used_(0), large_bytes_(0)
+  {
+    assert (block_bytes_ >= 4);
+  }
+
+  // the number of distinct strings
+  std::size_t size() const { return strings_.size(); }
+
+  // the id of s, adding a copy of s if it is new; throws std::length_error
+  // when all ids but the empty one are taken
+  id_type intern(string_ref s)
+  {
+    if (2 * (strings_.size() + 1) > index_.size())
+      grow_index();
+    const std::uint32_t h = detail_::fnv1a32(s.data(), s.size());
+    const std::size_t i = slot_of(s, h);
+    if (index_[i] != no_id)
+      return index_[i];
+
+    if (strings_.size() >= no_id) // the next id would be the empty dictionary_id
+      throw std::length_error("string_dictionary: out of ids");
+    const id_type id = id_type(strings_.size());
+    strings_.push_back(string_ref(copy(s), s.size()));
+    hashes_.push_back(h);
+    index_[i] = id;
+    return id;
+  }
+
+  // the id of s, or an empty id if s has not been interned
+  dictionary_id find(string_ref s) const
+  {
+    if (strings_.empty())
+      return dictionary_id();
+    const std::size_t i = slot_of(s, detail_::fnv1a32(s.data(), s.size()));
+    return index_[i] == no_id ? dictionary_id() : dictionary_id(index_[i]);
+  }
+
+  // valid until reset() or the destruction of the dictionary
+  string_ref operator[](id_type id) const
+  {
+    assert (id < strings_.size());
+    return strings_[id];
+  }
+
+  // Forgets all strings, invalidating every id and string_ref obtained so
+  // far, but keeps the blocks and the index for the next batch.
+  void reset()
+  {
+    strings_.clear();
+    hashes_.clear();
+    std::fill(index_.begin(), index_.end(), std::uint32_t(no_id));
+    large_.clear();
+    large_bytes_ = 0;
+    block_ = 0;
+    used_ = 0;
+  }
+
+  std::size_t memory_usage() const
+  {
+    return blocks_.size() * block_bytes_ + large_bytes_ + strings_.capacity() * sizeof(string_ref)
+         + (hashes_.capacity() + index_.capacity()) * sizeof(std::uint32_t);
+  }
+};
+
+// an element of a dictionary_column
+class interned_string
+{
+  const string_dictionary* dictionary_;
+  dictionary_id id_;
+
+public:
+  interned_string(const string_dictionary& d, dictionary_id id) : dictionary_(&d), id_(id) {}
+
+  bool has_value() const { return id_.has_value(); }
+  dictionary_id id() const { return id_; }
+
+  string_ref value() const
+  {
+    assert (has_value());
+    return (*dictionary_)[id_.value()];
+  }
+};
+
+// A column of optional strings stored as ids into a string_dictionary. The
+// dictionary is not owned, and may be shared by several columns.
+class dictionary_column
+{
+public:
+  typedef std::size_t size_type;
+
+private:
+  string_dictionary* dictionary_;
+  compact_optional_vector<evp_dictionary_id> ids_;
+
+public:
+  explicit dictionary_column(string_dictionary& d) : dictionary_(&d) {}
+
+  string_dictionary& dictionary() const { return *dictionary_; }
+  const compact_optional_vector<evp_dictionary_id>& ids() const { return ids_; }
+
+  size_type size() const { return ids_.size(); }
+  bool empty() const { return ids_.empty(); }
+  void reserve(size_type n) { ids_.reserve(n); }
+  void clear() { ids_.clear(); }
+
+  void push_back(string_ref s) { ids_.push_back(dictionary_->intern(s)); }
+  void push_back(dictionary_id id) { ids_.push_back(id); }
+  void push_back_empty() { ids_.push_back_empty(); }
+
+  // appends the strings in [first, last), each convertible to string_ref
+  template <typename It>
+  void append(It first, It last)
+  {
+    ids_.reserve(ids_.size() + std::distance(first, last));
+    for (; first != last; ++first)
+      ids_.push_back(dictionary_->intern(string_ref(*first)));
+  }
+
+  bool has_value(size_type i) const { return ids_.has_value(i); }
+  dictionary_id id(size_type i) const { return ids_[i]; }
+  interned_string operator[](size_type i) const { return interned_string(*dictionary_, ids_[i]); }
+
+  // Equality filters: s is looked up in the dictionary once, and the rest
+  // compares 4-byte ids. Empty elements never match.
+
+  size_type count_equal(string_ref s) const { return count_equal(dictionary_->find(s)); }
+
+  size_type count_equal(dictionary_id id) const
+  {
+    if (!id.has_value())
+      return 0;
+    size_type c = 0;
+    const std::uint32_t* p = ids_.data();
+    for (size_type i = 0; i < ids_.size(); i += 64)
+      c += detail_::popcount64(mask64(p + i, ids_.size() - i, id.value()));
+    return c;
+  }
+
+  // writes (size() + 63) / 64 words; bit i % 64 of word i / 64 is set iff element i equals s
+  void mask_equal(string_ref s, std::uint64_t* out) const
+  {
+    const dictionary_id id = dictionary_->find(s);
+    const std::uint32_t* p = ids_.data();
+    for (size_type i = 0; i < ids_.size(); i += 64)
+      out[i / 64] = id.has_value() ? mask64(p + i, ids_.size() - i, id.value()) : 0;
+  }
+
+  // calls f(i) for each element equal to s, in increasing order of i
+  template <typename F>
+  void for_each_equal(string_ref s, F f) const
+  {
+    const dictionary_id id = dictionary_->find(s);
+    if (!id.has_value())
+      return;
+    const std::uint32_t* p = ids_.data();
+    for (size_type i = 0; i < ids_.size(); i += 64)
+      for (std::uint64_t m = mask64(p + i, ids_.size() - i, id.value()); m; m &= m - 1)
+        f(i + detail_::lowest_bit64(m));
+  }
+
+  std::size_t memory_usage() const { return ids_.capacity() * sizeof(std::uint32_t); }
+
+private:
+  static std::uint64_t mask64(const std::uint32_t* p, size_type left, std::uint32_t id)
+  {
+    return detail_::sentinel_equal_scan<std::uint32_t>::mask64(p, left < 64 ? left : 64, id);
+  }
+};
+
+} // namespace compact_optional_ns
+
+using compact_optional_ns::string_ref;
+using compact_optional_ns::evp_dictionary_id;
+using compact_optional_ns::dictionary_id;
+using compact_optional_ns::string_dictionary;
+using compact_optional_ns::interned_string;
+using compact_optional_ns::dictionary_column;
+
+} // namespace ak_toolbox
+
+#endif //AK_TOOLBOX_COMPACT_OPTIONAL_DICTIONARY_HEADER_GUARD_
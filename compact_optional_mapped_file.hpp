@@ -0,0 +1,135 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef AK_TOOLBOX_COMPACT_OPTIONAL_MAPPED_FILE_HEADER_GUARD_
+#define AK_TOOLBOX_COMPACT_OPTIONAL_MAPPED_FILE_HEADER_GUARD_
+
+#include <cstddef>
+#include <utility>
+
+#if defined __unix__ || defined __APPLE__
+#  define AK_TOOLBOX_MAPPED_FILE_POSIX
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#else
+#  include <cstdio>
+#  include <vector>
+#endif
+
+// A read-only view of a whole file. On POSIX systems the file is mapped into
+// memory; elsewhere it is read into a buffer.
+
+namespace ak_toolbox {
+namespace compact_optional_ns {
+
+class mapped_file
+{
+  const char* data_;
+  std::size_t size_;
+  bool open_;
+#if !defined AK_TOOLBOX_MAPPED_FILE_POSIX
+  std::vector<char> buffer_;
+#endif
+
+  void close()
+  {
+#if defined AK_TOOLBOX_MAPPED_FILE_POSIX
+    if (size_ != 0)
+      ::munmap(const_cast<char*>(data_), size_);
+#endif
+    data_ = 0;
+    size_ = 0;
+    open_ = false;
+  }
+
+public:
+  mapped_file() : data_(0), size_(0), open_(false) {}
+
+  // check is_open() for success
+  explicit mapped_file(const char* path) : data_(0), size_(0), open_(false)
+  {
+#if defined AK_TOOLBOX_MAPPED_FILE_POSIX
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+      return;
+    struct stat st;
+    if (::fstat(fd, &st) == 0)
+    {
+      if (st.st_size == 0)
+        open_ = true; // mmap rejects empty mappings
+      else
+      {
+        void* p = ::mmap(0, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED)
+        {
+          data_ = static_cast<const char*>(p);
+          size_ = static_cast<std::size_t>(st.st_size);
+          open_ = true;
+#  if defined MADV_SEQUENTIAL
+          ::madvise(p, size_, MADV_SEQUENTIAL);
+#  endif
+        }
+      }
+    }
+    ::close(fd);
+#else
+    std::FILE* f = std::fopen(path, "rb");
+    if (!f)
+      return;
+    char chunk[1 << 16];
+    for (std::size_t n; (n = std::fread(chunk, 1, sizeof chunk, f)) != 0; )
+      buffer_.insert(buffer_.end(), chunk, chunk + n);
+    open_ = !std::ferror(f);
+    std::fclose(f);
+    data_ = buffer_.empty() ? 0 : &buffer_[0];
+    size_ = buffer_.size();
+#endif
+  }
+
+  mapped_file(mapped_file&& rhs) : data_(rhs.data_), size_(rhs.size_), open_(rhs.open_)
+#if !defined AK_TOOLBOX_MAPPED_FILE_POSIX
+    , buffer_(std::move(rhs.buffer_))
+#endif
+  {
+    rhs.data_ = 0;
+    rhs.size_ = 0;
+    rhs.open_ = false;
+  }
+
+  mapped_file& operator=(mapped_file&& rhs)
+  {
+    if (this != &rhs)
+    {
+      close();
+      std::swap(data_, rhs.data_);
+      std::swap(size_, rhs.size_);
+      std::swap(open_, rhs.open_);
+#if !defined AK_TOOLBOX_MAPPED_FILE_POSIX
+      buffer_ = std::move(rhs.buffer_);
+#endif
+    }
+    return *this;
+  }
+
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+
+  ~mapped_file() { close(); }
+
+  bool is_open() const { return open_; }
+  const char* data() const { return data_; }
+  std::size_t size() const { return size_; }
+};
+
+} // namespace compact_optional_ns
+
+using compact_optional_ns::mapped_file;
+
+} // namespace ak_toolbox
+
+#endif //AK_TOOLBOX_COMPACT_OPTIONAL_MAPPED_FILE_HEADER_GUARD_
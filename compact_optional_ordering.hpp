@@ -0,0 +1,236 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef AK_TOOLBOX_COMPACT_OPTIONAL_ORDERING_HEADER_GUARD_
+#define AK_TOOLBOX_COMPACT_OPTIONAL_ORDERING_HEADER_GUARD_
+
+#include "compact_optional.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+
+// Opt-in comparisons and hashing for compact_optional. compact_optional has
+// no relational operators, because it is not obvious where the empty value
+// belongs; the function objects below state it explicitly. Where the policy
+// allows, they compare unsafe_raw_value() directly, without branching on
+// has_value().
+
+namespace ak_toolbox {
+namespace compact_optional_ns {
+
+// Customization point: true if storage_type values compare (with == and <)
+// exactly like the values they represent, and the empty state has a single
+// representation, empty_value(). Specialize it for your own policies.
+template <typename EVP>
+struct is_raw_comparable : std::false_type {};
+
+template <typename T, T Val>
+struct is_raw_comparable< evp_int<T, Val> > : std::is_integral<T> {};
+
+template <typename T, T Val>
+struct is_raw_comparable< empty_scalar_value<T, Val> > : std::is_integral<T> {};
+
+template <>
+struct is_raw_comparable<evp_bool> : std::true_type {}; // false = 0, true = 1
+
+#ifndef AK_TOOLBOX_NO_UNDERLYING_TYPE
+template <typename Enum, typename std::underlying_type<Enum>::type Val>
+struct is_raw_comparable< evp_enum<Enum, Val> > : std::true_type {};
+#else
+// stored as int, which preserves the order of the underlying values if they
+// all fit: in narrower enums and in signed ones
+template <typename Enum, int Val>
+struct is_raw_comparable< evp_enum<Enum, Val> >
+  : std::integral_constant<bool, sizeof(Enum) < sizeof(int) || !detail_::enum_is_unsigned<Enum>::value> {};
+#endif // AK_TOOLBOX_NO_UNDERLYING_TYPE
+
+template <typename T>
+struct is_raw_comparable< auto_evp<T> > : is_raw_comparable<typename detail_::niche_policy<T>::type> {};
+
+namespace detail_ {
+
+enum raw_order_kind
+{
+  by_value,     // no raw comparison: branch on has_value()
+  by_sentinel,  // integral storage: combine the two emptiness flags without branches
+  by_raw_value  // the empty value is the end of the storage domain that empties sort to
+};
+
+// whether the empty value is the lowest (EmptyFirst) or highest storage value;
+// only evaluated for raw-comparable policies, whose empty_value() is constexpr
+template <typename EVP, bool EmptyFirst, bool RawComparable = is_raw_comparable<EVP>::value>
+struct sentinel_at_end
+{
+  typedef typename EVP::storage_type storage_type;
+#ifndef AK_TOOLBOX_NO_ARVANCED_CXX11
+  static const bool value = EmptyFirst ? EVP::empty_value() == std::numeric_limits<storage_type>::min()
+                                       : EVP::empty_value() == std::numeric_limits<storage_type>::max();
+#else
+  static const bool value = false;
+#endif // AK_TOOLBOX_NO_ARVANCED_CXX11
+};
+
+template <typename EVP, bool EmptyFirst>
+struct sentinel_at_end<EVP, EmptyFirst, false> { static const bool value = false; };
+
+template <typename EVP, bool EmptyFirst>
+struct raw_order
+{
+  static const raw_order_kind value = !is_raw_comparable<EVP>::value ? by_value
+                                    : sentinel_at_end<EVP, EmptyFirst>::value ? by_raw_value
+                                    : by_sentinel;
+
+  typedef std::integral_constant<raw_order_kind, value> type;
+};
+
+template <typename EVP, bool EmptyFirst, typename O>
+bool ordered_less(const O& l, const O& r, std::integral_constant<raw_order_kind, by_raw_value>)
+{
+  return l.unsafe_raw_value() < r.unsafe_raw_value();
+}
+
+// Storage narrower than 64 bits is widened to an order-preserving unsigned
+// key with room for the empty value below (0) or above (all ones) the others.
+template <typename EVP, bool EmptyFirst>
+std::uint64_t sentinel_key(typename EVP::storage_type v)
+{
+  typedef typename EVP::storage_type storage_type;
+  typedef typename std::make_unsigned<storage_type>::type unsigned_type;
+  const unsigned_type bias = std::is_signed<storage_type>::value ? unsigned_type(~(unsigned_type(-1) >> 1)) : 0;
+  const std::uint64_t key = std::uint64_t(unsigned_type(unsigned_type(v) ^ bias));
+  const std::uint64_t empty = std::uint64_t(0) - std::uint64_t(v == EVP::empty_value());
+  return EmptyFirst ? (key + 1) & ~empty : key | empty;
+}
+
+template <typename EVP, bool EmptyFirst, typename O>
+bool sentinel_less(const O& l, const O& r, std::true_type)
+{
+  return sentinel_key<EVP, EmptyFirst>(l.unsafe_raw_value()) < sentinel_key<EVP, EmptyFirst>(r.unsafe_raw_value());
+}
+
+template <typename EVP, bool EmptyFirst, typename O>
+bool sentinel_less(const O& l, const O& r, std::false_type)
+{
+  // compares the pairs (has_value, raw) for empty first, (!has_value, raw) for empty last
+  const bool le = (l.unsafe_raw_value() == EVP::empty_value()) != EmptyFirst;
+  const bool re = (r.unsafe_raw_value() == EVP::empty_value()) != EmptyFirst;
+  return (le < re) | ((le == re) & (l.unsafe_raw_value() < r.unsafe_raw_value()));
+}
+
+template <typename EVP, bool EmptyFirst, typename O>
+bool ordered_less(const O& l, const O& r, std::integral_constant<raw_order_kind, by_sentinel>)
+{
+  typedef typename EVP::storage_type storage_type;
+  return sentinel_less<EVP, EmptyFirst>(l, r, std::integral_constant<bool, std::is_integral<storage_type>::value
+                                                                           && (sizeof(storage_type) < sizeof(std::uint64_t))>());
+}
+
+template <typename EVP, bool EmptyFirst, typename O>
+bool ordered_less(const O& l, const O& r, std::integral_constant<raw_order_kind, by_value>)
+{
+  if (!l.has_value() || !r.has_value())
+    return EmptyFirst ? (!l.has_value() && r.has_value()) : (l.has_value() && !r.has_value());
+  return l.value() < r.value();
+}
+
+template <typename O>
+bool empty_equal(const O& l, const O& r, std::true_type)
+{
+  return l.unsafe_raw_value() == r.unsafe_raw_value();
+}
+
+template <typename O>
+bool empty_equal(const O& l, const O& r, std::false_type)
+{
+  return l.has_value() == r.has_value() && (!l.has_value() || l.value() == r.value());
+}
+
+} // namespace detail_
+
+// Strict weak orderings in which the empty value precedes (follows) all the
+// other values; the other values are compared with `<`.
+struct empty_first_less
+{
+  template <typename N, typename Tag>
+  bool operator()(const compact_optional<N, Tag>& l, const compact_optional<N, Tag>& r) const
+  {
+    typedef typename detail_::policy_of<N>::type policy;
+    return detail_::ordered_less<policy, true>(l, r, typename detail_::raw_order<policy, true>::type());
+  }
+};
+
+struct empty_last_less
+{
+  template <typename N, typename Tag>
+  bool operator()(const compact_optional<N, Tag>& l, const compact_optional<N, Tag>& r) const
+  {
+    typedef typename detail_::policy_of<N>::type policy;
+    return detail_::ordered_less<policy, false>(l, r, typename detail_::raw_order<policy, false>::type());
+  }
+};
+
+// Equality in which two empty objects are equal, and an empty object is
+// not equal to any object with a value.
+struct empty_equal_to
+{
+  template <typename N, typename Tag>
+  bool operator()(const compact_optional<N, Tag>& l, const compact_optional<N, Tag>& r) const
+  {
+    typedef typename detail_::policy_of<N>::type policy;
+    return detail_::empty_equal(l, r, is_raw_comparable<policy>());
+  }
+};
+
+namespace detail_ {
+
+template <typename EVP, typename O>
+std::size_t hash_storage(const O& o, std::true_type)
+{
+  return std::hash<typename EVP::storage_type>()(o.unsafe_raw_value());
+}
+
+// several bit patterns may represent the empty value: hash them all alike
+template <typename EVP, typename O>
+std::size_t hash_storage(const O& o, std::false_type)
+{
+  typedef typename EVP::storage_type storage_type;
+  return o.has_value() ? std::hash<storage_type>()(o.unsafe_raw_value())
+                       : std::hash<storage_type>()(storage_type(EVP::empty_value()));
+}
+
+} // namespace detail_
+
+} // namespace compact_optional_ns
+
+using compact_optional_ns::is_raw_comparable;
+using compact_optional_ns::empty_first_less;
+using compact_optional_ns::empty_last_less;
+using compact_optional_ns::empty_equal_to;
+
+} // namespace ak_toolbox
+
+namespace std {
+
+// Hashes the raw storage, consistently with ak_toolbox::empty_equal_to.
+// Requires std::hash<storage_type>.
+template <typename N, typename Tag>
+struct hash< ak_toolbox::compact_optional<N, Tag> >
+{
+  typedef ak_toolbox::compact_optional<N, Tag> argument_type;
+  typedef std::size_t result_type;
+
+  std::size_t operator()(const argument_type& o) const
+  {
+    namespace co = ak_toolbox::compact_optional_ns;
+    typedef typename co::detail_::policy_of<N>::type policy;
+    return co::detail_::hash_storage<policy>(o, co::is_raw_comparable<policy>());
+  }
+};
+
+} // namespace std
+
+#endif //AK_TOOLBOX_COMPACT_OPTIONAL_ORDERING_HEADER_GUARD_
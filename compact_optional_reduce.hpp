@@ -0,0 +1,638 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef AK_TOOLBOX_COMPACT_OPTIONAL_REDUCE_HEADER_GUARD_
+#define AK_TOOLBOX_COMPACT_OPTIONAL_REDUCE_HEADER_GUARD_
+
+#include "compact_optional.hpp"
+#include "compact_optional_simd.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <vector>
+
+// Define AK_TOOLBOX_STD_EXECUTION to also get overloads that take a C++17
+// execution policy (std::execution::par, ...). It is opt-in, because some
+// standard libraries implement <execution> on top of a library (e.g. TBB)
+// that then has to be linked.
+#if defined AK_TOOLBOX_STD_EXECUTION
+#  include <execution>
+#  include <algorithm>
+#endif
+
+// Reductions over arrays of compact_optional that skip the empty objects:
+// count, sum, min, max and mean in one call.
+//
+// The input is cut into chunks of a fixed size (64K elements), which are
+// reduced independently, in parallel for large inputs, and the chunk results
+// are combined pairwise. A chunk is split in halves down to blocks of 128
+// elements; a block is reduced into 8 lanes (element i goes to lane i % 8)
+// with SSE2/AVX2 where available, and the lanes are again combined pairwise.
+// The order of the floating-point additions depends only on n: not on the
+// number of threads, nor on the instruction set, so the results are
+// reproducible, and the rounding error grows with O(log n) as in pairwise
+// summation. Integer sums are computed modulo 2^64 and are exact unless they
+// overflow the result type.
+
+namespace ak_toolbox {
+namespace compact_optional_ns {
+namespace detail_ {
+
+// supported policies: integral sentinels and NaN
+template <typename EVP, typename = void>
+struct reduce_traits
+{
+  static_assert(sizeof(EVP) == 0, "reductions require evp_int, empty_scalar_value or evp_fp_nan");
+};
+
+template <typename T, typename Sum, typename Accum>
+struct arithmetic_reduce_traits
+{
+  typedef T storage_type;
+  typedef Sum sum_type;     // the type of the result
+  typedef Accum accum_type; // the type in which it is computed
+
+  static T min_identity() { return std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity()
+                                                                        : std::numeric_limits<T>::max(); }
+  static T max_identity() { return std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity()
+                                                                        : std::numeric_limits<T>::lowest(); }
+};
+
+template <typename T>
+struct integral_reduce_traits
+  : arithmetic_reduce_traits<T, typename std::conditional<std::is_signed<T>::value, std::int64_t, std::uint64_t>::type,
+                             std::uint64_t> {};
+
+template <typename T, T Val>
+struct reduce_traits< evp_int<T, Val>, typename std::enable_if<std::is_integral<T>::value>::type >
+  : integral_reduce_traits<T> {};
+
+template <typename T, T Val>
+struct reduce_traits< empty_scalar_value<T, Val>, typename std::enable_if<std::is_integral<T>::value>::type >
+  : integral_reduce_traits<T> {};
+
+template <typename FPT>
+struct reduce_traits< evp_fp_nan<FPT> > : arithmetic_reduce_traits<FPT, FPT, FPT> {};
+
+template <typename T>
+struct reduce_traits< auto_evp<T> > : reduce_traits<typename niche_policy<T>::type> {};
+
+template <typename EVP>
+struct partial_aggregate
+{
+  typedef reduce_traits<EVP> traits;
+  typedef typename traits::storage_type storage_type;
+  typedef typename traits::accum_type accum_type;
+
+  std::size_t count;
+  accum_type sum;
+  storage_type min, max;
+
+  partial_aggregate() : count(0), sum(0), min(traits::min_identity()), max(traits::max_identity()) {}
+
+  void merge(const partial_aggregate& r)
+  {
+    count += r.count;
+    sum += r.sum;
+    min = min < r.min ? min : r.min;
+    max = max > r.max ? max : r.max;
+  }
+};
+
+const std::size_t reduce_lanes = 8;
+const std::size_t reduce_block = 128;
+const std::size_t reduce_chunk = std::size_t(1) << 16;
+// A thread is started for each call and joined before it returns; at tens
+// of microseconds, that only pays off with this many chunks per thread.
+const std::size_t reduce_chunks_per_thread = 16;
+
+// c ? a : b, without the branch compilers tend to make of it
+template <typename T>
+T select_value(bool c, T a, T b, std::true_type /*integral*/)
+{
+  typedef typename std::make_unsigned<T>::type U;
+  return T(U(b) ^ ((U(a) ^ U(b)) & U(-U(c))));
+}
+
+template <typename T>
+T select_value(bool c, T a, T b, std::false_type)
+{
+  return c ? a : b;
+}
+
+template <typename T>
+T select_value(bool c, T a, T b)
+{
+  return select_value(c, a, b, std::is_integral<T>());
+}
+
+// per-lane accumulators of one block; min and max select like _mm_min_ps
+// and _mm_max_ps, so that the scalar and SIMD code agree on signed zeros
+template <typename EVP>
+struct lane_aggregate
+{
+  typedef partial_aggregate<EVP> partial;
+  typedef typename partial::storage_type storage_type;
+  typedef typename partial::accum_type accum_type;
+
+  accum_type sum[reduce_lanes];
+  storage_type min[reduce_lanes], max[reduce_lanes];
+
+  lane_aggregate()
+  {
+    for (std::size_t j = 0; j != reduce_lanes; ++j)
+    {
+      sum[j] = 0;
+      min[j] = partial::traits::min_identity();
+      max[j] = partial::traits::max_identity();
+    }
+  }
+
+  void add(std::size_t j, storage_type v) // no branches: empty values are unpredictable
+  {
+    const bool engaged = !EVP::is_empty_value(v);
+    sum[j] += select_value(engaged, accum_type(v), accum_type(0));
+    const storage_type vmin = select_value(engaged, v, partial::traits::min_identity());
+    const storage_type vmax = select_value(engaged, v, partial::traits::max_identity());
+    min[j] = min[j] < vmin ? min[j] : vmin;
+    max[j] = max[j] > vmax ? max[j] : vmax;
+  }
+
+  partial combine()
+  {
+    for (std::size_t w = reduce_lanes / 2; w != 0; w /= 2)
+      for (std::size_t j = 0; j != w; ++j)
+      {
+        sum[j] += sum[j + w];
+        min[j] = min[j] < min[j + w] ? min[j] : min[j + w];
+        max[j] = max[j] > max[j + w] ? max[j] : max[j + w];
+      }
+    partial r;
+    r.sum = sum[0];
+    r.min = min[0];
+    r.max = max[0];
+    return r;
+  }
+};
+
+// Adds p[0..n), n a multiple of reduce_lanes, to the lanes.
+template <typename EVP, typename = void>
+struct lane_kernel
+{
+  static void run(const typename EVP::storage_type* p, std::size_t n, lane_aggregate<EVP>& l)
+  {
+    for (std::size_t i = 0; i != n; i += reduce_lanes)
+      for (std::size_t j = 0; j != reduce_lanes; ++j)
+        l.add(j, p[i + j]);
+  }
+};
+
+#if defined AK_TOOLBOX_SIMD_SSE2
+
+// NaN policies: empties add +0.0 and select the identities of min and max
+
+inline void nan_lane_kernel(const float* p, std::size_t n, float* sum, float* mn, float* mx)
+{
+#  if defined AK_TOOLBOX_SIMD_AVX2
+  const __m256 inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+  const __m256 ninf = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+  __m256 s = _mm256_loadu_ps(sum), a = _mm256_loadu_ps(mn), b = _mm256_loadu_ps(mx);
+  for (std::size_t i = 0; i != n; i += 8)
+  {
+    __m256 v = _mm256_loadu_ps(p + i);
+    __m256 e = _mm256_cmp_ps(v, v, _CMP_ORD_Q);
+    s = _mm256_add_ps(s, _mm256_and_ps(e, v));
+    a = _mm256_min_ps(a, _mm256_blendv_ps(inf, v, e));
+    b = _mm256_max_ps(b, _mm256_blendv_ps(ninf, v, e));
+  }
+  _mm256_storeu_ps(sum, s);
+  _mm256_storeu_ps(mn, a);
+  _mm256_storeu_ps(mx, b);
+#  else
+  const __m128 inf = _mm_set1_ps(std::numeric_limits<float>::infinity());
+  const __m128 ninf = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+  for (std::size_t h = 0; h != 8; h += 4) // lanes 0-3, then 4-7
+  {
+    __m128 s = _mm_loadu_ps(sum + h), a = _mm_loadu_ps(mn + h), b = _mm_loadu_ps(mx + h);
+    for (std::size_t i = h; i < n; i += 8)
+    {
+      __m128 v = _mm_loadu_ps(p + i);
+      __m128 e = _mm_cmpord_ps(v, v);
+      s = _mm_add_ps(s, _mm_and_ps(e, v));
+      a = _mm_min_ps(a, _mm_or_ps(_mm_and_ps(e, v), _mm_andnot_ps(e, inf)));
+      b = _mm_max_ps(b, _mm_or_ps(_mm_and_ps(e, v), _mm_andnot_ps(e, ninf)));
+    }
+    _mm_storeu_ps(sum + h, s);
+    _mm_storeu_ps(mn + h, a);
+    _mm_storeu_ps(mx + h, b);
+  }
+#  endif
+}
+
+inline void nan_lane_kernel(const double* p, std::size_t n, double* sum, double* mn, double* mx)
+{
+#  if defined AK_TOOLBOX_SIMD_AVX2
+  const __m256d inf = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+  const __m256d ninf = _mm256_set1_pd(-std::numeric_limits<double>::infinity());
+  for (std::size_t h = 0; h != 8; h += 4)
+  {
+    __m256d s = _mm256_loadu_pd(sum + h), a = _mm256_loadu_pd(mn + h), b = _mm256_loadu_pd(mx + h);
+    for (std::size_t i = h; i < n; i += 8)
+    {
+      __m256d v = _mm256_loadu_pd(p + i);
+      __m256d e = _mm256_cmp_pd(v, v, _CMP_ORD_Q);
+      s = _mm256_add_pd(s, _mm256_and_pd(e, v));
+      a = _mm256_min_pd(a, _mm256_blendv_pd(inf, v, e));
+      b = _mm256_max_pd(b, _mm256_blendv_pd(ninf, v, e));
+    }
+    _mm256_storeu_pd(sum + h, s);
+    _mm256_storeu_pd(mn + h, a);
+    _mm256_storeu_pd(mx + h, b);
+  }
+#  else
+  const __m128d inf = _mm_set1_pd(std::numeric_limits<double>::infinity());
+  const __m128d ninf = _mm_set1_pd(-std::numeric_limits<double>::infinity());
+  for (std::size_t h = 0; h != 8; h += 2)
+  {
+    __m128d s = _mm_loadu_pd(sum + h), a = _mm_loadu_pd(mn + h), b = _mm_loadu_pd(mx + h);
+    for (std::size_t i = h; i < n; i += 8)
+    {
+      __m128d v = _mm_loadu_pd(p + i);
+      __m128d e = _mm_cmpord_pd(v, v);
+      s = _mm_add_pd(s, _mm_and_pd(e, v));
+      a = _mm_min_pd(a, _mm_or_pd(_mm_and_pd(e, v), _mm_andnot_pd(e, inf)));
+      b = _mm_max_pd(b, _mm_or_pd(_mm_and_pd(e, v), _mm_andnot_pd(e, ninf)));
+    }
+    _mm_storeu_pd(sum + h, s);
+    _mm_storeu_pd(mn + h, a);
+    _mm_storeu_pd(mx + h, b);
+  }
+#  endif
+}
+
+template <typename FPT>
+struct lane_kernel< evp_fp_nan<FPT>, typename std::enable_if<std::is_same<FPT, float>::value
+                                                             || std::is_same<FPT, double>::value>::type >
+{
+  static void run(const FPT* p, std::size_t n, lane_aggregate< evp_fp_nan<FPT> >& l)
+  {
+    nan_lane_kernel(p, n, l.sum, l.min, l.max);
+  }
+};
+
+// Signed integer sentinels; the order of integer additions does not matter,
+// so these need not keep element i in lane i % 8.
+
+inline __m128i select_si128(__m128i mask, __m128i a, __m128i b) // mask ? a : b
+{
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+inline void sentinel_lane_kernel(const std::int32_t* p, std::size_t n, std::int32_t empty,
+                                 std::uint64_t* sum, std::int32_t* mn, std::int32_t* mx)
+{
+#  if defined AK_TOOLBOX_SIMD_AVX2
+  const __m256i sentinel = _mm256_set1_epi32(empty);
+  const __m256i hi = _mm256_set1_epi32(std::numeric_limits<std::int32_t>::max());
+  const __m256i lo = _mm256_set1_epi32(std::numeric_limits<std::int32_t>::min());
+  __m256i s0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sum));
+  __m256i s1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sum + 4));
+  __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mn));
+  __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mx));
+  for (std::size_t i = 0; i != n; i += 8)
+  {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+    __m256i e = _mm256_cmpeq_epi32(v, sentinel);
+    __m256i z = _mm256_andnot_si256(e, v);
+    s0 = _mm256_add_epi64(s0, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(z)));
+    s1 = _mm256_add_epi64(s1, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(z, 1)));
+    a = _mm256_min_epi32(a, _mm256_blendv_epi8(v, hi, e));
+    b = _mm256_max_epi32(b, _mm256_blendv_epi8(v, lo, e));
+  }
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(sum), s0);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(sum + 4), s1);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(mn), a);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(mx), b);
+#  else
+  // SSE2 has no 32-bit min, max or sign extension: compare and select,
+  // and interleave with the sign words
+  const __m128i sentinel = _mm_set1_epi32(empty);
+  const __m128i hi = _mm_set1_epi32(std::numeric_limits<std::int32_t>::max());
+  const __m128i lo = _mm_set1_epi32(std::numeric_limits<std::int32_t>::min());
+  for (std::size_t h = 0; h != 2; ++h)
+  {
+    __m128i s0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sum + 4 * h));
+    __m128i s1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sum + 4 * h + 2));
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mn + 4 * h));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mx + 4 * h));
+    for (std::size_t i = 4 * h; i < n; i += 8)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+      __m128i e = _mm_cmpeq_epi32(v, sentinel);
+      __m128i z = _mm_andnot_si128(e, v);
+      __m128i sign = _mm_srai_epi32(z, 31);
+      s0 = _mm_add_epi64(s0, _mm_unpacklo_epi32(z, sign));
+      s1 = _mm_add_epi64(s1, _mm_unpackhi_epi32(z, sign));
+      __m128i va = select_si128(e, hi, v);
+      a = select_si128(_mm_cmpgt_epi32(a, va), va, a);
+      __m128i vb = select_si128(e, lo, v);
+      b = select_si128(_mm_cmpgt_epi32(vb, b), vb, b);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(sum + 4 * h), s0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(sum + 4 * h + 2), s1);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(mn + 4 * h), a);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(mx + 4 * h), b);
+  }
+#  endif
+}
+
+#  if defined AK_TOOLBOX_SIMD_AVX2
+// (SSE2 has no 64-bit compare; there the scalar kernel is used)
+inline void sentinel_lane_kernel(const std::int64_t* p, std::size_t n, std::int64_t empty,
+                                 std::uint64_t* sum, std::int64_t* mn, std::int64_t* mx)
+{
+  const __m256i sentinel = _mm256_set1_epi64x(empty);
+  const __m256i hi = _mm256_set1_epi64x(std::numeric_limits<std::int64_t>::max());
+  const __m256i lo = _mm256_set1_epi64x(std::numeric_limits<std::int64_t>::min());
+  for (std::size_t h = 0; h != 8; h += 4)
+  {
+    __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sum + h));
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mn + h));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mx + h));
+    for (std::size_t i = h; i < n; i += 8)
+    {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+      __m256i e = _mm256_cmpeq_epi64(v, sentinel);
+      s = _mm256_add_epi64(s, _mm256_andnot_si256(e, v));
+      __m256i va = _mm256_blendv_epi8(v, hi, e);
+      a = _mm256_blendv_epi8(a, va, _mm256_cmpgt_epi64(a, va));
+      __m256i vb = _mm256_blendv_epi8(v, lo, e);
+      b = _mm256_blendv_epi8(b, vb, _mm256_cmpgt_epi64(vb, b));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(sum + h), s);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(mn + h), a);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(mx + h), b);
+  }
+}
+#  endif
+
+template <typename T, T Val, typename EVP>
+struct sentinel_lane_kernel_for
+{
+  typedef typename std::conditional<sizeof(T) == 4, std::int32_t, std::int64_t>::type int_type;
+
+  static void run(const T* p, std::size_t n, lane_aggregate<EVP>& l)
+  {
+    sentinel_lane_kernel(reinterpret_cast<const int_type*>(p), n, int_type(Val), l.sum,
+                         reinterpret_cast<int_type*>(l.min), reinterpret_cast<int_type*>(l.max));
+  }
+};
+
+template <typename T, T Val, typename = void>
+struct has_sentinel_lane_kernel : std::false_type {};
+
+template <typename T, T Val>
+struct has_sentinel_lane_kernel<T, Val, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type>
+#  if defined AK_TOOLBOX_SIMD_AVX2
+  : std::integral_constant<bool, sizeof(T) == 4 || sizeof(T) == 8> {};
+#  else
+  : std::integral_constant<bool, sizeof(T) == 4> {};
+#  endif
+
+template <typename T, T Val>
+struct lane_kernel< evp_int<T, Val>, typename std::enable_if<has_sentinel_lane_kernel<T, Val>::value>::type >
+  : sentinel_lane_kernel_for< T, Val, evp_int<T, Val> > {};
+
+template <typename T, T Val>
+struct lane_kernel< empty_scalar_value<T, Val>, typename std::enable_if<has_sentinel_lane_kernel<T, Val>::value>::type >
+  : sentinel_lane_kernel_for< T, Val, empty_scalar_value<T, Val> > {};
+
+#endif // AK_TOOLBOX_SIMD_SSE2
+
+template <typename T>
+struct lane_kernel< auto_evp<T> >
+{
+  typedef typename niche_policy<T>::type policy;
+
+  static void run(const T* p, std::size_t n, lane_aggregate< auto_evp<T> >& l)
+  {
+    lane_aggregate<policy> pl;
+    lane_kernel<policy>::run(p, n, pl);
+    for (std::size_t j = 0; j != reduce_lanes; ++j)
+    {
+      l.sum[j] += pl.sum[j];
+      l.min[j] = l.min[j] < pl.min[j] ? l.min[j] : pl.min[j];
+      l.max[j] = l.max[j] > pl.max[j] ? l.max[j] : pl.max[j];
+    }
+  }
+};
+
+// one block of at most reduce_block elements
+template <typename EVP>
+partial_aggregate<EVP> reduce_block_impl(const typename EVP::storage_type* p, std::size_t n)
+{
+  lane_aggregate<EVP> l;
+  const std::size_t full = n - n % reduce_lanes;
+  lane_kernel<EVP>::run(p, full, l);
+  for (std::size_t i = full; i != n; ++i)
+    l.add(i - full, p[i]);
+
+  partial_aggregate<EVP> r = l.combine();
+  r.count = count_engaged<EVP>(p, n);
+  return r;
+}
+
+// pairwise over blocks
+template <typename EVP>
+partial_aggregate<EVP> reduce_range(const typename EVP::storage_type* p, std::size_t n)
+{
+  if (n <= reduce_block)
+    return reduce_block_impl<EVP>(p, n);
+
+  const std::size_t blocks = (n + reduce_block - 1) / reduce_block;
+  const std::size_t half = (blocks / 2) * reduce_block;
+  partial_aggregate<EVP> r = reduce_range<EVP>(p, half);
+  r.merge(reduce_range<EVP>(p + half, n - half));
+  return r;
+}
+
+// pairwise over the chunk results
+template <typename EVP>
+partial_aggregate<EVP> combine_pairwise(const partial_aggregate<EVP>* first, std::size_t n)
+{
+  if (n == 1)
+    return *first;
+  partial_aggregate<EVP> r = combine_pairwise(first, n / 2);
+  r.merge(combine_pairwise(first + n / 2, n - n / 2));
+  return r;
+}
+
+// Calls f(i) for every i in [0, count) on up to `threads` threads (the
+// calling one included), which take the indices in turn. There is no pool:
+// the other threads are started here and joined before returning, so each
+// of them gets at least `min_per_thread` indices.
+template <typename F>
+void parallel_for_each_index(std::size_t count, unsigned threads, std::size_t min_per_thread, F f)
+{
+  if (threads > count / min_per_thread)
+    threads = static_cast<unsigned>(count / min_per_thread);
+
+  std::atomic<std::size_t> next (0);
+  auto work = [&] {
+    for (std::size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count; )
+      f(i);
+  };
+
+  std::vector<std::thread> helpers;
+  for (unsigned t = 1; t < threads; ++t)
+    helpers.emplace_back(work);
+  work();
+  for (std::size_t t = 0; t != helpers.size(); ++t)
+    helpers[t].join();
+}
+
+inline unsigned default_reduce_threads()
+{
+  unsigned t = std::thread::hardware_concurrency();
+  return t == 0 ? 1 : t;
+}
+
+} // namespace detail_
+
+// The result of aggregate_engaged: empty min and max when count == 0.
+template <typename EVP>
+struct engaged_aggregate
+{
+  typedef typename detail_::reduce_traits<EVP>::sum_type sum_type;
+
+  std::size_t count;
+  sum_type sum;
+  compact_optional<EVP> min;
+  compact_optional<EVP> max;
+
+  // NaN when there are no values
+  double mean() const
+  {
+    return count == 0 ? std::numeric_limits<double>::quiet_NaN() : double(sum) / double(count);
+  }
+};
+
+namespace detail_ {
+
+template <typename EVP>
+engaged_aggregate<EVP> make_aggregate(const partial_aggregate<EVP>& p)
+{
+  engaged_aggregate<EVP> r;
+  r.count = p.count;
+  r.sum = static_cast<typename engaged_aggregate<EVP>::sum_type>(p.sum);
+  if (p.count != 0)
+  {
+    r.min = compact_optional<EVP>(EVP::access_value(p.min));
+    r.max = compact_optional<EVP>(EVP::access_value(p.max));
+  }
+  return r;
+}
+
+template <typename EVP, typename Tag>
+const typename EVP::storage_type* reduce_input(const compact_optional<EVP, Tag>* first)
+{
+  typedef compact_optional<EVP, Tag> opt_t;
+  static_assert(sizeof(opt_t) == sizeof(typename EVP::storage_type) && std::is_standard_layout<opt_t>::value,
+                "compact_optional must have the layout of its storage_type");
+  return reinterpret_cast<const typename EVP::storage_type*>(first);
+}
+
+inline std::size_t reduce_chunk_length(std::size_t n, std::size_t c)
+{
+  const std::size_t begin = c * reduce_chunk;
+  return n - begin < reduce_chunk ? n - begin : reduce_chunk;
+}
+
+} // namespace detail_
+
+// Aggregates the values of the n objects at first, skipping the empty ones.
+// Large inputs are spread over up to `threads` threads (0: one per hardware
+// thread), started by this call, with at least 16 chunks (1M elements) for
+// each; the result does not depend on their number.
+template <typename EVP, typename Tag>
+engaged_aggregate<EVP> aggregate_engaged(const compact_optional<EVP, Tag>* first, std::size_t n, unsigned threads = 0)
+{
+  typedef detail_::partial_aggregate<EVP> partial;
+  const typename EVP::storage_type* p = detail_::reduce_input(first);
+  const std::size_t chunks = (n + detail_::reduce_chunk - 1) / detail_::reduce_chunk;
+  if (chunks <= 1)
+    return detail_::make_aggregate(detail_::reduce_range<EVP>(p, n));
+
+  std::vector<partial> parts (chunks);
+  detail_::parallel_for_each_index(chunks, threads == 0 ? detail_::default_reduce_threads() : threads,
+                                   detail_::reduce_chunks_per_thread, [&](std::size_t c) {
+      parts[c] = detail_::reduce_range<EVP>(p + c * detail_::reduce_chunk, detail_::reduce_chunk_length(n, c));
+    });
+  return detail_::make_aggregate(detail_::combine_pairwise(parts.data(), chunks));
+}
+
+#if defined AK_TOOLBOX_STD_EXECUTION
+// As above, with the chunks distributed by a standard execution policy.
+template <typename ExecutionPolicy, typename EVP, typename Tag,
+          typename = typename std::enable_if<std::is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value>::type>
+engaged_aggregate<EVP> aggregate_engaged(ExecutionPolicy&& policy, const compact_optional<EVP, Tag>* first, std::size_t n)
+{
+  typedef detail_::partial_aggregate<EVP> partial;
+  const typename EVP::storage_type* p = detail_::reduce_input(first);
+  const std::size_t chunks = (n + detail_::reduce_chunk - 1) / detail_::reduce_chunk;
+  if (chunks <= 1)
+    return detail_::make_aggregate(detail_::reduce_range<EVP>(p, n));
+
+  std::vector<partial> parts (chunks);
+  std::for_each(std::forward<ExecutionPolicy>(policy), parts.begin(), parts.end(), [&](partial& part) {
+    const std::size_t c = &part - parts.data();
+    part = detail_::reduce_range<EVP>(p + c * detail_::reduce_chunk, detail_::reduce_chunk_length(n, c));
+  });
+  return detail_::make_aggregate(detail_::combine_pairwise(parts.data(), chunks));
+}
+#endif // AK_TOOLBOX_STD_EXECUTION
+
+// shorthands
+
+template <typename EVP, typename Tag>
+typename engaged_aggregate<EVP>::sum_type sum_engaged(const compact_optional<EVP, Tag>* first, std::size_t n,
+                                                      unsigned threads = 0)
+{
+  return aggregate_engaged(first, n, threads).sum;
+}
+
+template <typename EVP, typename Tag>
+double mean_engaged(const compact_optional<EVP, Tag>* first, std::size_t n, unsigned threads = 0)
+{
+  return aggregate_engaged(first, n, threads).mean();
+}
+
+template <typename EVP, typename Tag>
+compact_optional<EVP> min_engaged(const compact_optional<EVP, Tag>* first, std::size_t n, unsigned threads = 0)
+{
+  return aggregate_engaged(first, n, threads).min;
+}
+
+template <typename EVP, typename Tag>
+compact_optional<EVP> max_engaged(const compact_optional<EVP, Tag>* first, std::size_t n, unsigned threads = 0)
+{
+  return aggregate_engaged(first, n, threads).max;
+}
+
+} // namespace compact_optional_ns
+
+using compact_optional_ns::engaged_aggregate;
+using compact_optional_ns::aggregate_engaged;
+using compact_optional_ns::sum_engaged;
+using compact_optional_ns::mean_engaged;
+using compact_optional_ns::min_engaged;
+using compact_optional_ns::max_engaged;
+
+} // namespace ak_toolbox
+
+#endif //AK_TOOLBOX_COMPACT_OPTIONAL_REDUCE_HEADER_GUARD_
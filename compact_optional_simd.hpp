@@ -0,0 +1,693 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef AK_TOOLBOX_COMPACT_OPTIONAL_SIMD_HEADER_GUARD_
+#define AK_TOOLBOX_COMPACT_OPTIONAL_SIMD_HEADER_GUARD_
+
+#include "compact_optional.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if !defined AK_TOOLBOX_NO_SIMD && (defined __SSE2__ || defined _M_X64)
+#  define AK_TOOLBOX_SIMD_SSE2
+#  include <emmintrin.h>
+#endif
+
+#if !defined AK_TOOLBOX_NO_SIMD && defined __AVX2__
+#  define AK_TOOLBOX_SIMD_AVX2
+#  include <immintrin.h>
+#endif
+
+namespace ak_toolbox {
+namespace compact_optional_ns {
+namespace detail_ {
+
+// Bulk engaged-state scans over contiguous arrays of storage_type.
+// The building block is mask64(p, n): for n <= 64 elements it returns a word
+// whose bit i is set iff p[i] holds a value. Everything else (counting,
+// searching, validity bitmaps) is expressed in terms of these words, except
+// where a policy or a shipped kernel provides something faster.
+//
+// Optional policy hooks, for policies whose emptiness test or empty value
+// can be applied to a whole array at once:
+//
+//   static std::size_t count_empty(const storage_type* p, std::size_t n);
+//   static void fill_empty(storage_type* p, std::size_t n);
+//   static void mask_empty(const storage_type* p, std::size_t n, std::uint64_t* out);
+//
+// mask_empty writes (n + 63) / 64 words; bit i % 64 of word i / 64 is set
+// iff p[i] is empty, and the bits past n are clear. A policy may provide
+// any subset: the scans below use mask_empty where there is no mask64 kernel
+// for the policy, and count_empty and fill_empty take precedence over the
+// kernels.
+
+template <typename EVP, typename = void>
+struct has_count_empty : std::false_type {};
+
+template <typename EVP>
+struct has_count_empty<EVP, typename void_t_<decltype(EVP::count_empty(
+  std::declval<const typename EVP::storage_type*>(), std::size_t()))>::type> : std::true_type {};
+
+template <typename EVP, typename = void>
+struct has_fill_empty : std::false_type {};
+
+template <typename EVP>
+struct has_fill_empty<EVP, typename void_t_<decltype(EVP::fill_empty(
+  std::declval<typename EVP::storage_type*>(), std::size_t()))>::type> : std::true_type {};
+
+template <typename EVP, typename = void>
+struct has_mask_empty : std::false_type {};
+
+template <typename EVP>
+struct has_mask_empty<EVP, typename void_t_<decltype(EVP::mask_empty(
+  std::declval<const typename EVP::storage_type*>(), std::size_t(), std::declval<std::uint64_t*>()))>::type>
+  : std::true_type {};
+
+inline std::size_t popcount64(std::uint64_t w)
+{
+#if defined __GNUC__ || defined __clang__
+  return static_cast<std::size_t>(__builtin_popcountll(w));
+#else
+  std::size_t c = 0;
+  for (; w; w &= w - 1) ++c;
+  return c;
+#endif
+}
+
+inline std::size_t lowest_bit64(std::uint64_t w) // requires w != 0
+{
+#if defined __GNUC__ || defined __clang__
+  return static_cast<std::size_t>(__builtin_ctzll(w));
+#else
+  std::size_t i = 0;
+  for (; !(w & 1u); w >>= 1) ++i;
+  return i;
+#endif
+}
+
+inline std::uint64_t low_bits64(std::size_t n) // n <= 64
+{
+  return n >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << n) - 1;
+}
+
+// counting and filling in terms of Scan::mask64 and the policy's empty value
+template <typename EVP, typename Scan>
+struct scan_defaults
+{
+  typedef typename EVP::storage_type storage_type;
+
+  static std::size_t count_empty(const storage_type* p, std::size_t n)
+  {
+    std::size_t c = 0;
+    for (std::size_t i = 0; i < n; i += 64)
+      c += popcount64(Scan::mask64(p + i, n - i < 64 ? n - i : 64));
+    return n - c;
+  }
+
+  static void fill_empty(storage_type* p, std::size_t n)
+  {
+    for (std::size_t i = 0; i != n; ++i)
+      fill_empty_value<EVP>(p[i]);
+  }
+};
+
+// scalar fallback, used for user-defined policies and for SIMD tails
+template <typename EVP>
+struct generic_engaged_scan : scan_defaults< EVP, generic_engaged_scan<EVP> >
+{
+  typedef typename EVP::storage_type storage_type;
+
+  static std::uint64_t mask64(const storage_type* p, std::size_t n)
+  {
+    std::uint64_t m = 0;
+    for (std::size_t i = 0; i != n; ++i)
+      m |= std::uint64_t(!EVP::is_empty_value(p[i])) << i;
+    return m;
+  }
+};
+
+// a user-defined policy with the mask_empty hook
+template <typename EVP>
+struct hooked_engaged_scan : scan_defaults< EVP, hooked_engaged_scan<EVP> >
+{
+  typedef typename EVP::storage_type storage_type;
+
+  static std::uint64_t mask64(const storage_type* p, std::size_t n)
+  {
+    std::uint64_t empty;
+    EVP::mask_empty(p, n, &empty);
+    return ~empty & low_bits64(n);
+  }
+};
+
+// returns bits set for elements equal to the sentinel
+template <typename T>
+std::uint64_t sentinel_equal_scalar(const T* p, std::size_t n, T s)
+{
+  std::uint64_t m = 0;
+  for (std::size_t i = 0; i != n; ++i)
+    m |= std::uint64_t(p[i] == s) << i;
+  return m;
+}
+
+template <typename T, std::size_t Size = sizeof(T)>
+struct sentinel_equal_scan
+{
+  static std::uint64_t mask64(const T* p, std::size_t n, T s)
+  {
+    return sentinel_equal_scalar(p, n, s);
+  }
+};
+
+#if defined AK_TOOLBOX_SIMD_SSE2
+
+template <typename T>
+struct sentinel_equal_scan<T, 1>
+{
+  static std::uint64_t mask64(const T* p, std::size_t n, T s)
+  {
+    std::uint64_t m = 0;
+    std::size_t i = 0;
+#  if defined AK_TOOLBOX_SIMD_AVX2
+    const __m256i ws = _mm256_set1_epi8(static_cast<char>(s));
+    for (; i + 32 <= n; i += 32)
+    {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+      m |= std::uint64_t(static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, ws)))) << i;
+    }
+#  endif
+    const __m128i vs = _mm_set1_epi8(static_cast<char>(s));
+    for (; i + 16 <= n; i += 16)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+      m |= std::uint64_t(static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, vs)))) << i;
+    }
+    if (i != n)
+      m |= sentinel_equal_scalar(p + i, n - i, s) << i;
+    return m;
+  }
+};
+
+template <typename T>
+struct sentinel_equal_scan<T, 2>
+{
+  static std::uint64_t mask64(const T* p, std::size_t n, T s)
+  {
+    std::uint64_t m = 0;
+    std::size_t i = 0;
+    const __m128i vs = _mm_set1_epi16(static_cast<short>(s));
+    for (; i + 8 <= n; i += 8)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+      __m128i e = _mm_packs_epi16(_mm_cmpeq_epi16(v, vs), _mm_setzero_si128());
+      m |= std::uint64_t(static_cast<unsigned>(_mm_movemask_epi8(e))) << i;
+    }
+    if (i != n)
+      m |= sentinel_equal_scalar(p + i, n - i, s) << i;
+    return m;
+  }
+};
+
+template <typename T>
+struct sentinel_equal_scan<T, 4>
+{
+  static std::uint64_t mask64(const T* p, std::size_t n, T s)
+  {
+    std::uint64_t m = 0;
+    std::size_t i = 0;
+#  if defined AK_TOOLBOX_SIMD_AVX2
+    const __m256i ws = _mm256_set1_epi32(static_cast<int>(s));
+    for (; i + 8 <= n; i += 8)
+    {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+      __m256 e = _mm256_castsi256_ps(_mm256_cmpeq_epi32(v, ws));
+      m |= std::uint64_t(static_cast<unsigned>(_mm256_movemask_ps(e))) << i;
+    }
+#  endif
+    const __m128i vs = _mm_set1_epi32(static_cast<int>(s));
+    for (; i + 4 <= n; i += 4)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+      __m128 e = _mm_castsi128_ps(_mm_cmpeq_epi32(v, vs));
+      m |= std::uint64_t(static_cast<unsigned>(_mm_movemask_ps(e))) << i;
+    }
+    if (i != n)
+      m |= sentinel_equal_scalar(p + i, n - i, s) << i;
+    return m;
+  }
+};
+
+template <typename T>
+struct sentinel_equal_scan<T, 8>
+{
+  static std::uint64_t mask64(const T* p, std::size_t n, T s)
+  {
+    std::uint64_t m = 0;
+    std::size_t i = 0;
+    long long ls;
+    std::memcpy(&ls, &s, sizeof(ls));
+#  if defined AK_TOOLBOX_SIMD_AVX2
+    const __m256i ws = _mm256_set1_epi64x(ls);
+    for (; i + 4 <= n; i += 4)
+    {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+      __m256d e = _mm256_castsi256_pd(_mm256_cmpeq_epi64(v, ws));
+      m |= std::uint64_t(static_cast<unsigned>(_mm256_movemask_pd(e))) << i;
+    }
+#  endif
+    // SSE2 has no 64-bit compare: AND the two 32-bit halves
+    const __m128i vs = _mm_set1_epi64x(ls);
+    for (; i + 2 <= n; i += 2)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+      __m128i e = _mm_cmpeq_epi32(v, vs);
+      e = _mm_and_si128(e, _mm_shuffle_epi32(e, _MM_SHUFFLE(2, 3, 0, 1)));
+      m |= std::uint64_t(static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(e)))) << i;
+    }
+    if (i != n)
+      m |= sentinel_equal_scalar(p + i, n - i, s) << i;
+    return m;
+  }
+};
+
+#endif // AK_TOOLBOX_SIMD_SSE2
+
+// returns bits set for NaN elements
+template <typename FPT>
+std::uint64_t nan_scalar(const FPT* p, std::size_t n)
+{
+  std::uint64_t m = 0;
+  for (std::size_t i = 0; i != n; ++i)
+    m |= std::uint64_t(p[i] != p[i]) << i;
+  return m;
+}
+
+template <typename FPT>
+struct nan_scan
+{
+  static std::uint64_t mask64(const FPT* p, std::size_t n)
+  {
+    return nan_scalar(p, n);
+  }
+};
+
+#if defined AK_TOOLBOX_SIMD_SSE2
+
+template <>
+struct nan_scan<float>
+{
+  static std::uint64_t mask64(const float* p, std::size_t n)
+  {
+    std::uint64_t m = 0;
+    std::size_t i = 0;
+#  if defined AK_TOOLBOX_SIMD_AVX2
+    for (; i + 8 <= n; i += 8)
+    {
+      __m256 v = _mm256_loadu_ps(p + i);
+      m |= std::uint64_t(static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(v, v, _CMP_UNORD_Q)))) << i;
+    }
+#  endif
+    for (; i + 4 <= n; i += 4)
+    {
+      __m128 v = _mm_loadu_ps(p + i);
+      m |= std::uint64_t(static_cast<unsigned>(_mm_movemask_ps(_mm_cmpunord_ps(v, v)))) << i;
+    }
+    if (i != n)
+      m |= nan_scalar(p + i, n - i) << i;
+    return m;
+  }
+};
+
+template <>
+struct nan_scan<double>
+{
+  static std::uint64_t mask64(const double* p, std::size_t n)
+  {
+    std::uint64_t m = 0;
+    std::size_t i = 0;
+#  if defined AK_TOOLBOX_SIMD_AVX2
+    for (; i + 4 <= n; i += 4)
+    {
+      __m256d v = _mm256_loadu_pd(p + i);
+      m |= std::uint64_t(static_cast<unsigned>(_mm256_movemask_pd(_mm256_cmp_pd(v, v, _CMP_UNORD_Q)))) << i;
+    }
+#  endif
+    for (; i + 2 <= n; i += 2)
+    {
+      __m128d v = _mm_loadu_pd(p + i);
+      m |= std::uint64_t(static_cast<unsigned>(_mm_movemask_pd(_mm_cmpunord_pd(v, v)))) << i;
+    }
+    if (i != n)
+      m |= nan_scalar(p + i, n - i) << i;
+    return m;
+  }
+};
+
+#endif // AK_TOOLBOX_SIMD_SSE2
+
+// Counting kernels: the result of each compare (-1 in the lanes that match)
+// is subtracted from vector counters, which are summed before they could
+// overflow. Without a kernel, the mask64 words are counted.
+template <typename T>
+std::size_t sentinel_count_scalar(const T* p, std::size_t n, T s)
+{
+  std::size_t c = 0;
+  for (std::size_t i = 0; i != n; ++i)
+    c += p[i] == s;
+  return c;
+}
+
+template <typename T, std::size_t Size = sizeof(T)>
+struct sentinel_count
+{
+  static std::size_t count(const T* p, std::size_t n, T s)
+  {
+    std::size_t c = 0;
+    for (std::size_t i = 0; i < n; i += 64)
+      c += popcount64(sentinel_equal_scan<T>::mask64(p + i, n - i < 64 ? n - i : 64, s));
+    return c;
+  }
+};
+
+template <typename FPT>
+std::size_t nan_count_scalar(const FPT* p, std::size_t n)
+{
+  std::size_t c = 0;
+  for (std::size_t i = 0; i != n; ++i)
+    c += p[i] != p[i];
+  return c;
+}
+
+template <typename FPT>
+struct nan_count
+{
+  static std::size_t count(const FPT* p, std::size_t n)
+  {
+    std::size_t c = 0;
+    for (std::size_t i = 0; i < n; i += 64)
+      c += popcount64(nan_scan<FPT>::mask64(p + i, n - i < 64 ? n - i : 64));
+    return c;
+  }
+};
+
+#if defined AK_TOOLBOX_SIMD_SSE2
+
+inline std::size_t sum_epu8(__m128i acc)
+{
+  __m128i s = _mm_sad_epu8(acc, _mm_setzero_si128());
+  return std::size_t(_mm_cvtsi128_si32(s)) + std::size_t(_mm_cvtsi128_si32(_mm_srli_si128(s, 8)));
+}
+
+inline std::size_t sum_epu32(__m128i acc)
+{
+  std::uint32_t w[4];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(w), acc);
+  return std::size_t(w[0]) + w[1] + w[2] + w[3];
+}
+
+inline std::size_t sum_epu64(__m128i acc)
+{
+  std::uint64_t w[2];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(w), acc);
+  return std::size_t(w[0] + w[1]);
+}
+
+// Runs step(i, acc) over the 16-byte blocks of [p, p + n), restarting the
+// counters every `limit` blocks; returns the count and sets `i` to the tail.
+template <typename T, typename Step, typename Sum>
+std::size_t count_blocks(std::size_t n, std::size_t& i, std::size_t limit, Step step, Sum sum)
+{
+  const std::size_t per = 16 / sizeof(T);
+  std::size_t c = 0;
+  i = 0;
+  while (n - i >= per)
+  {
+    const std::size_t blocks = (n - i) / per < limit ? (n - i) / per : limit;
+    __m128i acc = _mm_setzero_si128();
+    for (std::size_t k = 0; k != blocks; ++k, i += per)
+      acc = step(i, acc);
+    c += sum(acc);
+  }
+  return c;
+}
+
+template <typename T>
+struct sentinel_count<T, 1>
+{
+  static std::size_t count(const T* p, std::size_t n, T s)
+  {
+    const __m128i vs = _mm_set1_epi8(static_cast<char>(s));
+    std::size_t i;
+    std::size_t c = count_blocks<T>(n, i, 255, [&](std::size_t j, __m128i acc) {
+      return _mm_sub_epi8(acc, _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + j)), vs));
+    }, sum_epu8);
+    return c + sentinel_count_scalar(p + i, n - i, s);
+  }
+};
+
+template <typename T>
+struct sentinel_count<T, 4>
+{
+  static std::size_t count(const T* p, std::size_t n, T s)
+  {
+    const __m128i vs = _mm_set1_epi32(static_cast<int>(s));
+    std::size_t i;
+    std::size_t c = count_blocks<T>(n, i, std::size_t(1) << 30, [&](std::size_t j, __m128i acc) {
+      return _mm_sub_epi32(acc, _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + j)), vs));
+    }, sum_epu32);
+    return c + sentinel_count_scalar(p + i, n - i, s);
+  }
+};
+
+template <typename T>
+struct sentinel_count<T, 8>
+{
+  static std::size_t count(const T* p, std::size_t n, T s)
+  {
+    const __m128i vs = _mm_set1_epi64x(static_cast<long long>(s));
+    std::size_t i;
+    std::size_t c = count_blocks<T>(n, i, ~std::size_t(0), [&](std::size_t j, __m128i acc) {
+      // SSE2 has no 64-bit compare: both 32-bit halves must match
+      __m128i e = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + j)), vs);
+      return _mm_sub_epi64(acc, _mm_and_si128(e, _mm_shuffle_epi32(e, _MM_SHUFFLE(2, 3, 0, 1))));
+    }, sum_epu64);
+    return c + sentinel_count_scalar(p + i, n - i, s);
+  }
+};
+
+template <>
+struct nan_count<float>
+{
+  static std::size_t count(const float* p, std::size_t n)
+  {
+    std::size_t i;
+    std::size_t c = count_blocks<float>(n, i, std::size_t(1) << 30, [&](std::size_t j, __m128i acc) {
+      __m128 v = _mm_loadu_ps(p + j);
+      return _mm_sub_epi32(acc, _mm_castps_si128(_mm_cmpunord_ps(v, v)));
+    }, sum_epu32);
+    return c + nan_count_scalar(p + i, n - i);
+  }
+};
+
+template <>
+struct nan_count<double>
+{
+  static std::size_t count(const double* p, std::size_t n)
+  {
+    std::size_t i;
+    std::size_t c = count_blocks<double>(n, i, ~std::size_t(0), [&](std::size_t j, __m128i acc) {
+      __m128d v = _mm_loadu_pd(p + j);
+      return _mm_sub_epi64(acc, _mm_castpd_si128(_mm_cmpunord_pd(v, v)));
+    }, sum_epu64);
+    return c + nan_count_scalar(p + i, n - i);
+  }
+};
+
+#endif // AK_TOOLBOX_SIMD_SSE2
+
+// stores s in p[0], ..., p[n - 1], 16 bytes at a time where sizeof(T) allows
+template <typename T>
+void broadcast_fill(T* p, std::size_t n, const T& s)
+{
+  std::size_t i = 0;
+#if defined AK_TOOLBOX_SIMD_SSE2
+  const std::size_t per = 16 / sizeof(T);
+  if (16 % sizeof(T) == 0)
+  {
+    unsigned char pattern[16];
+    for (std::size_t k = 0; k != per; ++k)
+      std::memcpy(pattern + k * sizeof(T), &s, sizeof(T));
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern));
+#  if defined AK_TOOLBOX_SIMD_AVX2
+    const __m256i w = _mm256_inserti128_si256(_mm256_castsi128_si256(v), v, 1);
+    for (; i + 2 * per <= n; i += 2 * per)
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(p + i), w);
+#  endif
+    for (; i + per <= n; i += per)
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(p + i), v);
+  }
+#endif // AK_TOOLBOX_SIMD_SSE2
+  std::fill(p + i, p + n, s);
+}
+
+template <typename T, T Val, bool = std::is_integral<T>::value>
+struct sentinel_engaged_scan
+{
+  static std::uint64_t mask64(const T* p, std::size_t n)
+  {
+    return ~sentinel_equal_scan<T>::mask64(p, n, Val) & low_bits64(n);
+  }
+
+  static std::size_t count_empty(const T* p, std::size_t n) { return sentinel_count<T>::count(p, n, Val); }
+  static void fill_empty(T* p, std::size_t n) { broadcast_fill(p, n, Val); }
+};
+
+template <typename T, T Val>
+struct sentinel_engaged_scan<T, Val, false> // e.g. pointers
+  : generic_engaged_scan< evp_int<T, Val> > {};
+
+// Selects the fastest scan for the policy; specialized for shipped policies.
+template <typename EVP>
+struct engaged_scan : std::conditional<has_mask_empty<EVP>::value,
+                                       hooked_engaged_scan<EVP>, generic_engaged_scan<EVP> >::type {};
+
+template <typename T, T Val>
+struct engaged_scan< evp_int<T, Val> > : sentinel_engaged_scan<T, Val> {};
+
+template <typename T, T Val>
+struct engaged_scan< empty_scalar_value<T, Val> > : sentinel_engaged_scan<T, Val> {};
+
+#ifndef AK_TOOLBOX_NO_UNDERLYING_TYPE
+template <typename Enum, typename std::underlying_type<Enum>::type Val>
+struct engaged_scan< evp_enum<Enum, Val> > : sentinel_engaged_scan<typename std::underlying_type<Enum>::type, Val> {};
+#else
+template <typename Enum, int Val>
+struct engaged_scan< evp_enum<Enum, Val> > : sentinel_engaged_scan<int, Val> {};
+#endif // AK_TOOLBOX_NO_UNDERLYING_TYPE
+
+template <>
+struct engaged_scan<evp_bool> : sentinel_engaged_scan<char, char(2)> {};
+
+template <typename FPT>
+struct engaged_scan< evp_fp_nan<FPT> >
+{
+  static std::uint64_t mask64(const FPT* p, std::size_t n)
+  {
+    return ~nan_scan<FPT>::mask64(p, n) & low_bits64(n);
+  }
+
+  static std::size_t count_empty(const FPT* p, std::size_t n) { return nan_count<FPT>::count(p, n); }
+  static void fill_empty(FPT* p, std::size_t n) { broadcast_fill(p, n, evp_fp_nan<FPT>::empty_value()); }
+};
+
+template <typename T>
+struct engaged_scan< auto_evp<T> > : engaged_scan<typename niche_policy<T>::type> {};
+
+// The batch operations: the policy's hook if it has one, else the kernel.
+
+template <typename EVP>
+std::size_t count_empty(const typename EVP::storage_type* p, std::size_t n, std::true_type)
+{
+  return EVP::count_empty(p, n);
+}
+
+template <typename EVP>
+std::size_t count_empty(const typename EVP::storage_type* p, std::size_t n, std::false_type)
+{
+  return engaged_scan<EVP>::count_empty(p, n);
+}
+
+template <typename EVP>
+std::size_t count_empty(const typename EVP::storage_type* p, std::size_t n)
+{
+  return count_empty<EVP>(p, n, has_count_empty<EVP>());
+}
+
+template <typename EVP>
+std::size_t count_engaged(const typename EVP::storage_type* p, std::size_t n)
+{
+  return n - count_empty<EVP>(p, n);
+}
+
+template <typename EVP>
+void fill_empty(typename EVP::storage_type* p, std::size_t n, std::true_type)
+{
+  EVP::fill_empty(p, n);
+}
+
+template <typename EVP>
+void fill_empty(typename EVP::storage_type* p, std::size_t n, std::false_type)
+{
+  engaged_scan<EVP>::fill_empty(p, n);
+}
+
+template <typename EVP>
+void fill_empty(typename EVP::storage_type* p, std::size_t n)
+{
+  fill_empty<EVP>(p, n, has_fill_empty<EVP>());
+}
+
+template <typename EVP>
+void mask_empty(const typename EVP::storage_type* p, std::size_t n, std::uint64_t* out, std::true_type)
+{
+  EVP::mask_empty(p, n, out);
+}
+
+template <typename EVP>
+void mask_empty(const typename EVP::storage_type* p, std::size_t n, std::uint64_t* out, std::false_type)
+{
+  for (std::size_t i = 0; i < n; i += 64)
+  {
+    const std::size_t k = n - i < 64 ? n - i : 64;
+    *out++ = ~engaged_scan<EVP>::mask64(p + i, k) & low_bits64(k);
+  }
+}
+
+template <typename EVP>
+void mask_empty(const typename EVP::storage_type* p, std::size_t n, std::uint64_t* out)
+{
+  mask_empty<EVP>(p, n, out, has_mask_empty<EVP>());
+}
+
+// returns the index of the first engaged element in [from, n), or n
+template <typename EVP>
+std::size_t find_engaged(const typename EVP::storage_type* p, std::size_t n, std::size_t from)
+{
+  for (std::size_t i = from; i < n; i += 64)
+  {
+    std::uint64_t m = engaged_scan<EVP>::mask64(p + i, n - i < 64 ? n - i : 64);
+    if (m)
+      return i + lowest_bit64(m);
+  }
+  return n;
+}
+
+// writes (n + 63) / 64 words; bit i % 64 of word i / 64 is set iff p[i] is engaged
+template <typename EVP>
+void engaged_mask(const typename EVP::storage_type* p, std::size_t n, std::uint64_t* out)
+{
+  for (std::size_t i = 0; i < n; i += 64)
+    *out++ = engaged_scan<EVP>::mask64(p + i, n - i < 64 ? n - i : 64);
+}
+
+// calls f(i) for each engaged index i, in increasing order
+template <typename EVP, typename F>
+void for_each_engaged(const typename EVP::storage_type* p, std::size_t n, F f)
+{
+  for (std::size_t i = 0; i < n; i += 64)
+  {
+    for (std::uint64_t m = engaged_scan<EVP>::mask64(p + i, n - i < 64 ? n - i : 64); m; m &= m - 1)
+      f(i + lowest_bit64(m));
+  }
+}
+
+} // namespace detail_
+} // namespace compact_optional_ns
+} // namespace ak_toolbox
+
+#endif //AK_TOOLBOX_COMPACT_OPTIONAL_SIMD_HEADER_GUARD_
@@ -0,0 +1,109 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef AK_TOOLBOX_COMPACT_OPTIONAL_VECTOR_HEADER_GUARD_
+#define AK_TOOLBOX_COMPACT_OPTIONAL_VECTOR_HEADER_GUARD_
+
+#include "compact_optional.hpp"
+#include "compact_optional_simd.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ak_toolbox {
+namespace compact_optional_ns {
+
+// A contiguous sequence of optional values that stores raw storage_type
+// objects, so that bulk queries on the engaged state can be performed
+// with word-at-a-time (SIMD where available) scans.
+template <typename EVP>
+class compact_optional_vector
+{
+public:
+  typedef compact_optional<EVP> optional_type;
+  typedef typename EVP::value_type value_type;
+  typedef typename EVP::storage_type storage_type;
+  typedef std::size_t size_type;
+
+#ifndef AK_TOOLBOX_NO_ARVANCED_CXX11
+  static_assert(std::is_trivially_copyable<storage_type>::value && std::is_trivially_copyable<value_type>::value,
+                "compact_optional_vector requires a policy with trivially copyable value and storage");
+#endif // AK_TOOLBOX_NO_ARVANCED_CXX11
+
+private:
+  std::vector<storage_type> data_;
+
+public:
+  compact_optional_vector() {}
+
+  explicit compact_optional_vector(size_type n) : data_(n, EVP::empty_value()) {}
+
+  size_type size() const { return data_.size(); }
+  bool empty() const { return data_.empty(); }
+  size_type capacity() const { return data_.capacity(); }
+  void reserve(size_type n) { data_.reserve(n); }
+  void resize(size_type n) { data_.resize(n, EVP::empty_value()); }
+  void clear() { data_.clear(); }
+
+  const storage_type* data() const { return data_.data(); }
+
+  void push_back(const optional_type& o) { data_.push_back(o.unsafe_raw_value()); }
+  void push_back(const value_type& v) { data_.push_back(EVP::store_value(v)); }
+  void push_back_empty() { data_.push_back(EVP::empty_value()); }
+
+  bool has_value(size_type i) const { return !EVP::is_empty_value(data_[i]); }
+
+  optional_type operator[](size_type i) const
+  {
+    return has_value(i) ? optional_type(EVP::access_value(data_[i])) : optional_type();
+  }
+
+  void set(size_type i, const optional_type& o) { data_[i] = o.unsafe_raw_value(); }
+  void set(size_type i, const value_type& v) { data_[i] = EVP::store_value(v); }
+  void reset(size_type i) { data_[i] = EVP::empty_value(); }
+
+  // bulk queries
+
+  size_type count_engaged() const
+  {
+    return detail_::count_engaged<EVP>(data_.data(), data_.size());
+  }
+
+  // returns the index of the first engaged element at or after `from`, or size()
+  size_type find_engaged(size_type from = 0) const
+  {
+    return detail_::find_engaged<EVP>(data_.data(), data_.size(), from);
+  }
+
+  // calls f(i) for every index i that holds a value, in increasing order
+  template <typename F>
+  void for_each_engaged(F f) const
+  {
+    detail_::for_each_engaged<EVP>(data_.data(), data_.size(), f);
+  }
+
+  // bit i % 64 of word i / 64 is set iff element i holds a value;
+  // `out` must have room for (size() + 63) / 64 words
+  void validity_mask(std::uint64_t* out) const
+  {
+    detail_::engaged_mask<EVP>(data_.data(), data_.size(), out);
+  }
+
+  std::vector<std::uint64_t> validity_mask() const
+  {
+    std::vector<std::uint64_t> ans((data_.size() + 63) / 64);
+    validity_mask(ans.data());
+    return ans;
+  }
+};
+
+} // namespace compact_optional_ns
+
+using compact_optional_ns::compact_optional_vector;
+
+} // namespace ak_toolbox
+
+#endif //AK_TOOLBOX_COMPACT_OPTIONAL_VECTOR_HEADER_GUARD_
@@ -0,0 +1,152 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "atomic_compact_optional.hpp"
+#include <atomic>
+#include <cassert>
+#include <thread>
+#include <vector>
+
+using namespace ak_toolbox;
+
+typedef atomic_compact_optional<evp_int<int, -1>> atomic_opt_int;
+typedef compact_optional<evp_int<int, -1>> opt_int;
+
+void test_single_thread()
+{
+  atomic_opt_int a;
+  assert (a.is_lock_free());
+  assert (!a.has_value());
+  assert (!a.load().has_value());
+
+  assert (a.try_publish(1));
+  assert (a.has_value());
+  assert (a.load().value() == 1);
+
+  opt_int current;
+  assert (!a.try_publish(2, current));
+  assert (current.value() == 1);
+
+  assert (a.exchange(opt_int(3)).value() == 1);
+  assert (a.reset().value() == 3);
+  assert (!a.has_value());
+
+  a.store(opt_int(4));
+  assert (a.get_or_compute([] { assert (false); return 0; }) == 4);
+  a.reset();
+  assert (a.get_or_compute([] { return 5; }) == 5);
+
+  atomic_compact_optional<evp_fp_nan<double>> d;
+  assert (!d.has_value());
+  assert (d.try_publish(0.5));
+  assert (d.load().value() == 0.5);
+
+  atomic_compact_optional<evp_bool> b;
+  assert (b.try_publish(false));
+  assert (b.load().value() == false);
+}
+
+struct evp_throwing : evp_int<int, -1>
+{
+  typedef check_throw collision_check;
+};
+
+// the empty value is never published, also with NDEBUG
+void test_publish_empty_value()
+{
+  atomic_opt_int a;
+  opt_int current (7);
+  bool published = a.try_publish(-1, current);
+  assert (!published);
+  assert (!current.has_value());
+  assert (!a.has_value());
+
+  assert (a.get_or_compute([] { return -1; }) == -1);
+  assert (!a.has_value());
+
+  published = a.try_publish(2);
+  assert (published);
+  published = a.try_publish(-1, current);
+  assert (!published);
+  assert (current.value() == 2);
+
+  atomic_compact_optional<evp_throwing> t;
+  bool thrown = false;
+  try { t.try_publish(-1); }
+  catch (const sentinel_collision&) { thrown = true; }
+  assert (thrown);
+  assert (!t.has_value());
+}
+
+// many threads race to publish into each slot: exactly one wins per slot,
+// and every thread observes the winner's value
+void test_publish_race()
+{
+  const int threads = 8, slots = 1000;
+  std::vector<atomic_opt_int> cache (slots);
+  std::atomic<int> wins (0);
+  std::vector<std::vector<int>> seen (threads, std::vector<int>(slots));
+
+  std::vector<std::thread> pool;
+  for (int t = 0; t != threads; ++t)
+    pool.emplace_back([&, t] {
+      for (int s = 0; s != slots; ++s)
+      {
+        opt_int current;
+        if (cache[s].try_publish(s * threads + t, current))
+        {
+          ++wins;
+          seen[t][s] = s * threads + t;
+        }
+        else
+        {
+          seen[t][s] = current.value();
+        }
+      }
+    });
+  for (std::thread& th : pool)
+    th.join();
+
+  assert (wins == slots);
+  for (int s = 0; s != slots; ++s)
+  {
+    int v = cache[s].load().value();
+    assert (v / threads == s);
+    for (int t = 0; t != threads; ++t)
+      assert (seen[t][s] == v);
+  }
+}
+
+void test_get_or_compute_race()
+{
+  const int threads = 8, rounds = 200;
+  for (int r = 0; r != rounds; ++r)
+  {
+    atomic_opt_int slot;
+    std::atomic<int> computations (0);
+    std::vector<int> results (threads);
+
+    std::vector<std::thread> pool;
+    for (int t = 0; t != threads; ++t)
+      pool.emplace_back([&, t] {
+        results[t] = slot.get_or_compute([&] { ++computations; return 100 + t; });
+      });
+    for (std::thread& th : pool)
+      th.join();
+
+    assert (computations >= 1 && computations <= threads);
+    for (int t = 0; t != threads; ++t)
+      assert (results[t] == slot.load().value());
+  }
+}
+
+int main()
+{
+  test_single_thread();
+  test_publish_empty_value();
+  test_publish_race();
+  test_get_or_compute_race();
+}
@@ -0,0 +1,180 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "compact_hash_map.hpp"
+#include <cassert>
+#include <cstdint>
+#include <map>
+#include <string>
+
+using namespace ak_toolbox;
+
+void test_map_basics()
+{
+  typedef compact_hash_map<evp_int<std::uint64_t, 0>, std::string> map_t;
+  map_t m;
+  assert (m.empty());
+  assert (m.find(1) == nullptr);
+  assert (!m.contains(1));
+  bool erased = m.erase(1);
+  assert (!erased);
+
+  std::pair<std::string*, bool> r = m.insert(1, "one");
+  assert (r.second);
+  r = m.insert(1, "uno");
+  assert (!r.second);
+  assert (*r.first == "one");
+  m[2] = "two";
+  m[2] += "!";
+  assert (m.size() == 2);
+  assert (*m.find(1) == "one");
+  assert (*m.find(2) == "two!");
+  assert (m.count(2) == 1);
+  assert (m.count(3) == 0);
+
+  erased = m.erase(1);
+  assert (erased);
+  assert (!m.contains(1));
+  assert (m.size() == 1);
+
+  std::size_t visited = 0;
+  m.for_each([&](std::uint64_t k, const std::string& v) { assert (k == 2 && v == "two!"); ++visited; });
+  assert (visited == 1);
+
+  m.clear();
+  assert (m.empty());
+  assert (m.find(2) == nullptr);
+}
+
+// a deterministic mix of inserts and erases, checked against std::map
+void test_map_against_reference()
+{
+  typedef compact_hash_map<evp_int<int, -1>, int> map_t;
+  map_t m;
+  std::map<int, int> ref;
+
+  std::uint32_t state = 12345;
+  for (int step = 0; step != 20000; ++step)
+  {
+    state = state * 1103515245u + 12345u;
+    int key = int((state >> 8) % 2000);
+    if ((state >> 4) % 3 == 0)
+    {
+      const bool erased = m.erase(key);
+      const bool ref_erased = ref.erase(key) == 1;
+      assert (erased == ref_erased);
+    }
+    else
+    {
+      m[key] = step;
+      ref[key] = step;
+    }
+    assert (m.size() == ref.size());
+    assert (m.load_factor() <= m.max_load_factor());
+  }
+
+  for (int key = 0; key != 2000; ++key)
+  {
+    const map_t& cm = m;
+    std::map<int, int>::const_iterator it = ref.find(key);
+    if (it == ref.end())
+      assert (cm.find(key) == nullptr);
+    else
+      assert (cm.find(key) && *cm.find(key) == it->second);
+  }
+}
+
+void test_colliding_keys()
+{
+  // all keys hash to the same slot: exercises wrap-around and backward shift
+  struct same_hash { std::size_t operator()(int) const { return 7; } };
+  compact_hash_map<evp_int<int, -1>, int, same_hash> m;
+
+  for (int i = 0; i != 10; ++i)
+    m[i] = i * 10;
+  assert (m.probe_length(9) == 10);
+  bool erased = m.erase(0);
+  assert (erased);
+  assert (m.probe_length(9) == 9);
+  erased = m.erase(4);
+  assert (erased);
+  for (int i = 1; i != 10; ++i)
+    assert ((i == 4) != (m.find(i) && *m.find(i) == i * 10));
+}
+
+enum class Color { red, green, blue, none = -1 };
+
+struct color_hash { std::size_t operator()(Color c) const { return std::size_t(c); } };
+
+void test_set()
+{
+  compact_hash_set<evp_enum<Color, -1>, color_hash> s;
+  bool inserted = s.insert(Color::red);
+  assert (inserted);
+  inserted = s.insert(Color::blue);
+  assert (inserted);
+  inserted = s.insert(Color::red);
+  assert (!inserted);
+  assert (s.size() == 2);
+  assert (s.contains(Color::blue));
+  assert (!s.contains(Color::green));
+
+  int visited = 0;
+  s.for_each([&](Color c) { assert (c != Color::green); ++visited; });
+  assert (visited == 2);
+
+  s.reserve(1000);
+  assert (s.bucket_count() >= 1024);
+  assert (s.contains(Color::red));
+  const bool erased = s.erase(Color::red);
+  assert (erased);
+  assert (!s.contains(Color::red));
+}
+
+struct evp_throwing : evp_int<int, -1>
+{
+  typedef check_throw collision_check;
+};
+
+// the empty value is rejected at run time, leaving the table unchanged
+void test_empty_value_key()
+{
+  compact_hash_map<evp_int<int, -1>, int> m;
+  m[1] = 10;
+  const std::pair<int*, bool> r = m.insert(-1, 5);
+  assert (r.first == nullptr && !r.second);
+  assert (m.size() == 1);
+  assert (!m.contains(-1));
+
+  bool thrown = false;
+  try { m[-1] = 5; }
+  catch (const sentinel_collision&) { thrown = true; }
+  assert (thrown);
+  assert (m.size() == 1);
+  assert (*m.find(1) == 10);
+
+  compact_hash_set<evp_enum<Color, -1>, color_hash> s;
+  const bool inserted = s.insert(Color::none);
+  assert (!inserted);
+  assert (s.empty());
+
+  // with check_throw the insertion throws
+  compact_hash_set<evp_throwing> ts;
+  thrown = false;
+  try { ts.insert(-1); }
+  catch (const sentinel_collision&) { thrown = true; }
+  assert (thrown);
+  assert (ts.empty());
+}
+
+int main()
+{
+  test_map_basics();
+  test_map_against_reference();
+  test_colliding_keys();
+  test_set();
+  test_empty_value_key();
+}
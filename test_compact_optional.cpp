@@ -8,6 +8,11 @@
 #include <cassert>
 #include <utility>
 #include <string>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include <memory>
+#include <functional>
 
 
 
@@ -250,6 +255,8 @@ public:
     ++objects_created;
   }
   
+  minutes_since_midnight& operator=(minutes_since_midnight const&) = default;
+  
   int as_int() const
   {
     assert (invariant());
@@ -312,8 +319,139 @@ void test_evp_raw_storage()
     assert (ot_.value().as_int() == 1439);
     assert(objects_created == 7);
     assert(objects_destroyed == 2);
+    
+    ot_.reset();
+    assert (!ot_.has_value());
+    assert(objects_destroyed == 3);
+    
+    ot_.reset();
+    assert (!ot_.has_value());
+    assert(objects_destroyed == 3);
   }
   assert(objects_created == objects_destroyed);
+  
+  reset_globals();
+  {
+    typedef compact_optional<evp_minutes> opt_time;
+    opt_time ot (in_place, 10);
+    assert (ot.value().as_int() == 10);
+    assert(objects_created == 1);
+    
+    ot.emplace(20);
+    assert (ot.value().as_int() == 20);
+    assert(objects_created == 2);
+    assert(objects_destroyed == 1);
+    
+    const minutes_since_midnight t30 (30);
+    assert(objects_created == 3);
+    
+    ot = t30; // assigned to the contained value
+    assert (ot.value().as_int() == 30);
+    assert(objects_created == 3);
+    assert(objects_destroyed == 1);
+    
+    ot.reset();
+    ot = t30; // constructed in the storage
+    assert (ot.value().as_int() == 30);
+    assert(objects_created == 4);
+    assert(objects_destroyed == 2);
+  }
+  assert(objects_created == objects_destroyed);
+}
+
+// counts the constructions, copies and moves of a payload
+struct tracked
+{
+  static int constructed, copied, moved;
+  int len_;
+  
+  tracked() AK_TOOLBOX_NOEXCEPT : len_(0) { ++constructed; }
+  explicit tracked(int len) AK_TOOLBOX_NOEXCEPT : len_(len) { ++constructed; }
+  tracked(int len, int factor) : len_(len * factor) { ++constructed; } // may throw
+  tracked(const tracked& r) : len_(r.len_) { ++copied; }
+  tracked(tracked&& r) AK_TOOLBOX_NOEXCEPT : len_(r.len_) { ++moved; }
+  tracked& operator=(const tracked& r) { len_ = r.len_; ++copied; return *this; }
+  tracked& operator=(tracked&& r) AK_TOOLBOX_NOEXCEPT { len_ = r.len_; ++moved; return *this; }
+  
+  bool empty() const { return len_ == 0; }
+  
+  static void reset_counts() { constructed = copied = moved = 0; }
+};
+
+int tracked::constructed = 0;
+int tracked::copied = 0;
+int tracked::moved = 0;
+
+void test_in_place_and_emplace()
+{
+  {
+    typedef compact_optional<evp_stl_empty<tracked>> opt_t;
+    tracked::reset_counts();
+    
+    opt_t o (in_place, 3);
+    assert (o.value().len_ == 3);
+    assert (tracked::constructed == 1 && tracked::copied == 0 && tracked::moved == 0);
+    
+    o.emplace(5); // nothrow constructor: rebuilt in place
+    assert (o.value().len_ == 5);
+    assert (tracked::constructed == 2 && tracked::copied == 0 && tracked::moved == 0);
+    
+    o.emplace(2, 3); // may throw: built aside, then moved in
+    assert (o.value().len_ == 6);
+    assert (tracked::constructed == 3 && tracked::copied == 0 && tracked::moved == 1);
+    
+    const tracked t (7);
+    tracked::reset_counts();
+    o = t;
+    assert (o.value().len_ == 7);
+    assert (tracked::constructed == 0 && tracked::copied == 1 && tracked::moved == 0);
+    
+    o = tracked(8);
+    assert (o.value().len_ == 8);
+    assert (tracked::constructed == 1 && tracked::copied == 1 && tracked::moved == 1);
+    
+    o = {};
+    assert (!o.has_value());
+    
+    o.emplace(1);
+    o.reset();
+    assert (!o.has_value());
+  }
+  {
+    typedef compact_optional<evp_int<int, -1>> opt_int;
+    opt_int o (in_place, 4);
+    assert (o.value() == 4);
+    
+    o.emplace(6);
+    assert (o.value() == 6);
+    
+    o = 7;
+    assert (o.value() == 7);
+    
+    o = {}; // resets, rather than assigning int()
+    assert (!o.has_value());
+  }
+  {
+    typedef compact_optional<evp_stl_empty<std::string>> opt_str;
+    opt_str o (in_place, 3, 'a');
+    assert (o.value() == "aaa");
+    
+    o = std::string("bb");
+    assert (o.value() == "bb");
+    
+    o.emplace("cccc", 2);
+    assert (o.value() == "cc");
+    
+    o = {};
+    assert (!o.has_value());
+  }
+  {
+    typedef compact_optional<evp_bool> opt_bool;
+    opt_bool o (in_place, true);
+    assert (o.value() == true);
+    o.emplace(false);
+    assert (o.has_value() && o.value() == false);
+  }
 }
 
 enum class Dir { N, E, S, W };
@@ -333,6 +471,427 @@ void test_evp_enum()
   assert (o_.unsafe_raw_value() == -1);
   assert (oN.unsafe_raw_value() ==  0);
   assert (oW.unsafe_raw_value() ==  3);
+  
+  oW.reset();
+  assert (!oW.has_value());
+  assert (oW.unsafe_raw_value() == -1);
+}
+
+struct trivial_minutes
+{
+  int minutes_;
+  explicit trivial_minutes(int m) : minutes_(m) {}
+};
+
+struct evp_trivial_minutes : compact_optional_pod_storage_type<trivial_minutes, int>
+{
+  static storage_type empty_value() { return -1; }
+  static bool is_empty_value(const storage_type& v) { return v == -1; }
+};
+
+void test_trivially_copyable()
+{
+  static_assert (std::is_trivially_copyable<compact_optional<evp_int<int, -1>>>::value, "not trivial");
+  static_assert (std::is_trivially_copyable<compact_optional<empty_scalar_value<long, 0>>>::value, "not trivial");
+  static_assert (std::is_trivially_copyable<compact_optional<evp_fp_nan<float>>>::value, "not trivial");
+  static_assert (std::is_trivially_copyable<compact_optional<evp_fp_nan<double>>>::value, "not trivial");
+  static_assert (std::is_trivially_copyable<compact_optional<evp_value_init<int>>>::value, "not trivial");
+  static_assert (std::is_trivially_copyable<compact_optional<evp_bool>>::value, "not trivial");
+  static_assert (std::is_trivially_copyable<compact_optional<evp_enum<Dir, -1>>>::value, "not trivial");
+  static_assert (std::is_trivially_copyable<compact_optional<evp_trivial_minutes>>::value, "not trivial");
+  static_assert (!std::is_trivially_copyable<compact_optional<evp_minutes>>::value, "must manage life-time");
+  static_assert (!std::is_trivially_copyable<compact_optional<evp_stl_empty<std::string>>>::value, "must manage life-time");
+  
+  typedef compact_optional<evp_trivial_minutes> opt_time;
+  opt_time arr[3] = { opt_time(trivial_minutes(1)), opt_time(), opt_time(trivial_minutes(3)) };
+  opt_time cpy[3];
+  std::memcpy(cpy, arr, sizeof(arr));
+  
+  assert ( cpy[0].has_value());
+  assert (!cpy[1].has_value());
+  assert ( cpy[2].has_value());
+  assert (cpy[0].value().minutes_ == 1);
+  assert (cpy[2].value().minutes_ == 3);
+  
+  cpy[0] = {};
+  assert (!cpy[0].has_value());
+  swap(cpy[0], cpy[2]);
+  assert (cpy[0].value().minutes_ == 3);
+  assert (!cpy[2].has_value());
+}
+
+int copies = 0;
+int moves = 0;
+
+class counted_id
+{
+  int id_;
+  
+public:
+  explicit counted_id(int id) : id_(id) { assert (id_ >= 0); }
+  counted_id(const counted_id& rhs) : id_(rhs.id_) { ++copies; }
+  counted_id(counted_id&& rhs) noexcept : id_(rhs.id_) { ++moves; }
+  counted_id& operator=(const counted_id& rhs) { id_ = rhs.id_; ++copies; return *this; }
+  counted_id& operator=(counted_id&& rhs) noexcept { id_ = rhs.id_; ++moves; return *this; }
+  ~counted_id() {}
+  int get() const { return id_; }
+};
+
+struct evp_counted_id : compact_optional_pod_storage_type<counted_id, int>
+{
+  static storage_type empty_value() noexcept { return -1; }
+  static bool is_empty_value(const storage_type& v) { return v == -1; }
+};
+
+struct evp_relocatable_vector : evp_stl_empty<std::vector<int>>
+{
+  typedef std::true_type trivially_relocatable;
+};
+
+void test_noexcept_moves()
+{
+  typedef compact_optional<evp_counted_id> opt_id;
+  static_assert (std::is_nothrow_move_constructible<opt_id>::value, "throwing move");
+  static_assert (std::is_nothrow_move_assignable<opt_id>::value, "throwing move");
+  static_assert (noexcept(swap(std::declval<opt_id&>(), std::declval<opt_id&>())), "throwing swap");
+  static_assert (std::is_nothrow_move_constructible<compact_optional<string_empty_value>>::value, "throwing move");
+  static_assert (noexcept(swap(std::declval<compact_optional<string_empty_value>&>(),
+                               std::declval<compact_optional<string_empty_value>&>())), "throwing swap");
+  // empty_value() of evp_minutes is not declared noexcept
+  static_assert (!std::is_nothrow_move_constructible<compact_optional<evp_minutes>>::value, "noexcept too wide");
+  
+  copies = 0;
+  moves = 0;
+  {
+    std::vector<opt_id> v;
+    for (int i = 0; i != 100; ++i)
+      v.push_back(i % 3 ? opt_id(counted_id(i)) : opt_id());
+    
+    assert (copies == 0);
+    assert (moves > 2 * 67); // into the temporary, into the vector, and on growth
+    for (int i = 0; i != 100; ++i)
+      assert (v[i].has_value() == (i % 3 != 0));
+    assert (v[98].value().get() == 98);
+  }
+}
+
+// a large record, stored raw, whose first int is -1 when empty
+template <bool Trivial>
+struct record
+{
+  int id_;
+  char payload_[252];
+  explicit record(int id) : id_(id) {}
+};
+
+template <>
+struct record<false>
+{
+  int id_;
+  char payload_[252];
+  explicit record(int id) : id_(id) {}
+  record(const record& r) : id_(r.id_) {}
+  record& operator=(const record& r) { id_ = r.id_; return *this; }
+  ~record() {}
+};
+
+int full_empty_values = 0;
+int marked_empty = 0;
+
+template <bool Trivial>
+struct evp_record : compact_optional_pod_storage_type<record<Trivial>>
+{
+  typedef typename compact_optional_pod_storage_type<record<Trivial>>::storage_type storage_type;
+  static const int empty_id = -1;
+  
+  static storage_type empty_value() AK_TOOLBOX_NOEXCEPT
+  {
+    ++full_empty_values;
+    storage_type s = storage_type();
+    std::memcpy(&s, &empty_id, sizeof(int));
+    return s;
+  }
+  
+  static bool is_empty_value(const storage_type& s)
+  {
+    int id;
+    std::memcpy(&id, &s, sizeof(int));
+    return id == empty_id;
+  }
+  
+  static void mark_empty(storage_type& s) AK_TOOLBOX_NOEXCEPT
+  {
+    ++marked_empty;
+    std::memcpy(&s, &empty_id, sizeof(int));
+  }
+};
+
+template <bool Trivial>
+void check_mark_empty()
+{
+  typedef compact_optional<evp_record<Trivial>> opt_rec;
+  static_assert (std::is_nothrow_default_constructible<opt_rec>::value, "mark_empty is noexcept");
+  full_empty_values = 0;
+  marked_empty = 0;
+  
+  opt_rec o_;
+  assert (!o_.has_value());
+  assert (marked_empty == 1);
+  
+  opt_rec o1 (record<Trivial>(1));
+  assert (o1.value().id_ == 1);
+  o1.reset();
+  assert (!o1.has_value());
+  assert (marked_empty == 2);
+  
+  o1.emplace(2);
+  o1 = opt_rec(); // the temporary, then (for buffer storage) the destroyed value
+  assert (!o1.has_value());
+  assert (marked_empty == (Trivial ? 3 : 4));
+  assert (full_empty_values == 0);
+}
+
+void test_mark_empty()
+{
+  static_assert (compact_optional_ns::detail_::has_mark_empty<evp_record<true>>::value, "");
+  static_assert (!compact_optional_ns::detail_::has_mark_empty<evp_int<int, -1>>::value, "");
+  check_mark_empty<true>();  // member storage
+  check_mark_empty<false>(); // buffer storage
+}
+
+void test_relocation()
+{
+  static_assert ( is_trivially_relocatable<evp_int<int, -1>>::value, "");
+  static_assert ( is_trivially_relocatable<evp_relocatable_vector>::value, "");
+  static_assert (!is_trivially_relocatable<evp_stl_empty<std::vector<int>>>::value, "");
+  static_assert (!is_trivially_relocatable<evp_counted_id>::value, "");
+  
+  {
+    typedef compact_optional<evp_relocatable_vector> opt_vec;
+    typename std::aligned_storage<sizeof(opt_vec), alignof(opt_vec)>::type buf[3];
+    opt_vec* dst = reinterpret_cast<opt_vec*>(buf);
+    opt_vec src[3] = { opt_vec(std::vector<int>(2, 1)), opt_vec(), opt_vec(std::vector<int>(3, 2)) };
+    
+    opt_vec* src_copy = static_cast<opt_vec*>(::operator new(sizeof(src)));
+    for (int i = 0; i != 3; ++i)
+      ::new (static_cast<void*>(src_copy + i)) opt_vec(std::move(src[i]));
+    
+    assert (uninitialized_relocate(src_copy, src_copy + 3, dst) == dst + 3);
+    ::operator delete(src_copy);
+    
+    assert (dst[0].value().size() == 2);
+    assert (!dst[1].has_value());
+    assert (dst[2].value().size() == 3);
+    for (int i = 0; i != 3; ++i)
+      dst[i].~opt_vec();
+  }
+  {
+    typedef compact_optional<evp_counted_id> opt_id;
+    opt_id src[2] = { opt_id(counted_id(4)), opt_id() };
+    typename std::aligned_storage<sizeof(opt_id), alignof(opt_id)>::type buf[2];
+    opt_id* dst = reinterpret_cast<opt_id*>(buf);
+    
+    moves = 0;
+    uninitialized_relocate(src, src + 2, dst);
+    assert (moves == 1);
+    assert (dst[0].value().get() == 4);
+    assert (!dst[1].has_value());
+    // src objects are destroyed: bring them back to life for the scope exit
+    ::new (static_cast<void*>(src)) opt_id(std::move(dst[0]));
+    ::new (static_cast<void*>(src + 1)) opt_id(std::move(dst[1]));
+    dst[0].~opt_id();
+    dst[1].~opt_id();
+  }
+}
+
+void test_nested_optional()
+{
+  typedef compact_optional<evp_int_multi<int, -1, -2>> opt_int;
+  typedef compact_optional<opt_int> opt_opt_int;
+  static_assert (sizeof(opt_opt_int) == sizeof(int), "size waste");
+  static_assert (std::is_same<opt_opt_int::value_type, opt_int>::value, "");
+  
+  opt_int i_, i1(1), iN2(-2);
+  assert (!i_.has_value());
+  assert ( i1.has_value());
+  assert (!iN2.has_value()); // spare values are not values
+  
+  opt_opt_int oo_, oo_i_(i_), oo_i1(i1);
+  assert (!oo_.has_value());
+  assert (oo_.unsafe_raw_value() == -2);
+  
+  assert (oo_i_.has_value());
+  assert (!oo_i_.value().has_value());
+  assert (oo_i_.unsafe_raw_value() == -1);
+  
+  assert (oo_i1.has_value());
+  assert (oo_i1.value().has_value());
+  assert (oo_i1.value().value() == 1);
+  
+  swap(oo_, oo_i1);
+  assert (oo_.value().value() == 1);
+  assert (!oo_i1.has_value());
+  
+  typedef compact_optional<compact_optional<compact_optional<evp_int_multi<short, -1, -2, -3>>>> opt3;
+  static_assert (sizeof(opt3) == sizeof(short), "size waste");
+  opt3 o3_, o3_1((opt3::value_type()));
+  assert (!o3_.has_value());
+  assert (o3_.unsafe_raw_value() == -3);
+  assert (o3_1.has_value());
+  assert (!o3_1.value().has_value());
+  
+  // an inner optional made empty by a spare value is stored as the inner empty value
+  opt_int iSpare (-2);
+  assert (!iSpare.has_value());
+  opt_opt_int oo_spare (iSpare);
+  assert (oo_spare.has_value());
+  assert (!oo_spare.value().has_value());
+  assert (oo_spare.unsafe_raw_value() == -1);
+  
+  opt3 o3_spare ((opt3::value_type(compact_optional<evp_int_multi<short, -1, -2, -3>>(short(-3)))));
+  assert (o3_spare.has_value());
+  assert (o3_spare.value().has_value());
+  assert (!o3_spare.value().value().has_value());
+}
+
+void test_value_or()
+{
+  typedef compact_optional<evp_int<int, -1>> opt_int;
+  assert (opt_int().value_or(7) == 7);
+  assert (opt_int(3).value_or(7) == 3);
+  assert (opt_int().value_or(-1) == -1); // the default may be the empty value
+  assert (opt_int(3).value_or(2.9) == 3);
+  
+  compact_optional<evp_int<unsigned char, 0>> ouc_, ouc(200);
+  assert (ouc_.value_or(5) == 5);
+  assert (ouc.value_or(5) == 200);
+  
+  compact_optional<evp_fp_nan<double>> od_, od(-0.5);
+  assert (od_.value_or(1.5) == 1.5);
+  assert (od.value_or(1.5) == -0.5);
+  compact_optional<evp_fp_nan<float>> of_;
+  assert (of_.value_or(2) == 2.0f);
+  
+  compact_optional<evp_bool> ob_, obF(false);
+  assert (ob_.value_or(true) == true);
+  assert (obF.value_or(true) == false);
+  
+  compact_optional<evp_enum<Dir, -1>> odir_, odirW(Dir::W);
+  assert (odir_.value_or(Dir::S) == Dir::S);
+  assert (odirW.value_or(Dir::S) == Dir::W);
+  
+  static_assert (compact_optional_ns::detail_::is_select_policy<evp_int<int, -1>>::value, "");
+  static_assert (compact_optional_ns::detail_::is_select_policy<evp_fp_nan<double>>::value, "");
+  static_assert (!compact_optional_ns::detail_::is_select_policy<string_empty_value>::value, "");
+  
+  compact_optional<string_empty_value> os_, os (std::string("text"));
+  assert (os_.value_or("none") == "none");
+  assert (os.value_or("none") == "text");
+}
+
+void test_monadic()
+{
+  typedef compact_optional<evp_int<int, -1>> opt_int;
+  typedef compact_optional<evp_int<long, 0>> opt_long;
+  const opt_int i_, i3 (3);
+  
+  // by default the same type for the same value type, auto_evp otherwise
+  auto twice = [](int v) { return 2 * v; };
+  static_assert (std::is_same<decltype(i3.transform(twice)), opt_int>::value, "");
+  assert (i3.transform(twice).value() == 6);
+  assert (!i_.transform(twice).has_value());
+  
+  auto half = [](int v) { return v / 2.0; };
+  static_assert (std::is_same<decltype(i3.transform(half)), compact_optional<auto_evp<double>>>::value, "");
+  assert (i3.transform(half).value() == 1.5);
+  
+  // straight into another policy; a result equal to its empty value gives an empty object
+  typedef evp_int<long, 0> evp_long;
+  auto minus3 = [](int v) { return long(v - 3); };
+  static_assert (std::is_same<decltype(i3.transform<evp_long>(minus3)), opt_long>::value, "");
+  assert (!i3.transform<evp_long>(minus3).has_value());
+  assert (opt_int(5).transform<evp_long>(minus3).value() == 2);
+  
+  int calls = 0;
+  auto counted = [&](int v) { ++calls; return v; };
+  i_.transform(counted);
+  assert (calls == 0);
+  
+  auto positive = [](int v) { return v > 0 ? opt_long(v) : opt_long(); };
+  assert (i3.and_then(positive).value() == 3);
+  assert (!i_.and_then(positive).has_value());
+  assert (!opt_int(0).and_then(positive).has_value());
+  
+  assert (i_.or_else([] { return opt_int(9); }).value() == 9);
+  assert (i_.or_else([] { return 8; }).value() == 8);
+  assert (i3.or_else([] { return opt_int(9); }).value() == 3);
+  assert (!i_.or_else([] { return opt_int(); }).has_value());
+  
+  compact_optional<string_empty_value> os (std::string("abc"));
+  assert (os.transform([](const std::string& s) { return s + "d"; }).value() == "abcd");
+}
+
+void test_pointer_policies()
+{
+  {
+    typedef compact_optional<evp_nullptr<std::unique_ptr<int>>> opt_ptr;
+    static_assert (sizeof(opt_ptr) == sizeof(std::unique_ptr<int>), "size waste");
+    opt_ptr o_, o1 (std::unique_ptr<int>(new int(1)));
+    assert (!o_.has_value());
+    assert ( o1.has_value());
+    assert (*o1.value() == 1);
+    
+    o_ = std::move(o1);
+    assert (*o_.value() == 1);
+    assert (!o1.has_value());
+  }
+  {
+    typedef compact_optional<evp_nullptr<std::shared_ptr<int>>> opt_ptr;
+    std::shared_ptr<int> p = std::make_shared<int>(2);
+    opt_ptr o_, o1 (p), o2 = o1;
+    assert (!o_.has_value());
+    assert (o2.value() == p);
+    assert (p.use_count() == 3);
+  }
+  {
+    typedef compact_optional<evp_misaligned_ptr<int>> opt_ptr;
+    static_assert (sizeof(opt_ptr) == sizeof(int*), "size waste");
+    int i = 0;
+    opt_ptr o_, oN (nullptr), oI (&i);
+    assert (!o_.has_value());
+    assert ( oN.has_value());
+    assert (oN.value() == nullptr);
+    assert (oI.value() == &i);
+  }
+  {
+    typedef compact_optional<evp_reference_wrapper<const std::string>> opt_ref;
+    static_assert (sizeof(opt_ref) == sizeof(void*), "size waste");
+    const std::string s = "s";
+    opt_ref o_, oS (std::cref(s));
+    assert (!o_.has_value());
+    assert (&oS.value().get() == &s);
+  }
+}
+
+void test_auto_evp()
+{
+  static_assert (std::is_base_of<evp_bool, auto_evp<bool>>::value, "");
+  static_assert (std::is_base_of<evp_fp_nan<float>, auto_evp<float>>::value, "");
+  static_assert (std::is_base_of<evp_misaligned_ptr<int>, auto_evp<int*>>::value, "");
+  static_assert (std::is_base_of<evp_nullptr<char*>, auto_evp<char*>>::value, "");
+  static_assert (std::is_base_of<evp_nullptr<std::unique_ptr<int>>, auto_evp<std::unique_ptr<int>>>::value, "");
+  static_assert (std::is_base_of<evp_reference_wrapper<int>, auto_evp<std::reference_wrapper<int>>>::value, "");
+  
+  static_assert (sizeof(compact_optional<auto_evp<double>>) == sizeof(double), "size waste");
+  static_assert (sizeof(compact_optional<auto_evp<std::shared_ptr<int>>>) == sizeof(std::shared_ptr<int>), "size waste");
+  
+  compact_optional<auto_evp<double>> od_, od1 (1.0);
+  assert (!od_.has_value());
+  assert (od1.value() == 1.0);
+  
+  compact_optional<auto_evp<const long*>> op_, opN (nullptr);
+  assert (!op_.has_value());
+  assert ( opN.has_value());
 }
 
 #if defined AK_TOOLBOX_USING_BOOST
@@ -364,5 +923,15 @@ int main()
 #if defined AK_TOOLBOX_USING_BOOST
   test_optional_as_storage();
 #endif
+  test_in_place_and_emplace();
   test_evp_enum();
+  test_trivially_copyable();
+  test_noexcept_moves();
+  test_mark_empty();
+  test_relocation();
+  test_nested_optional();
+  test_pointer_policies();
+  test_auto_evp();
+  test_value_or();
+  test_monadic();
 }
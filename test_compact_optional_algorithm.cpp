@@ -0,0 +1,375 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "compact_optional_algorithm.hpp"
+#include "compact_optional_vector.hpp"
+#include "test_input.hpp"
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+using namespace ak_toolbox;
+using test_input::make_input;
+
+enum class Dir { N, E, S, W };
+
+template <typename O>
+std::vector<O> engaged_of(const std::vector<O>& v)
+{
+  std::vector<O> r;
+  for (std::size_t i = 0; i != v.size(); ++i)
+    if (v[i].has_value())
+      r.push_back(v[i]);
+  return r;
+}
+
+template <typename O>
+bool same_sequence(const std::vector<O>& a, const std::vector<O>& b)
+{
+  return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), empty_equal_to());
+}
+
+template <typename EVP, typename Gen>
+void check_partitions(Gen gen)
+{
+  typedef compact_optional<EVP> opt_t;
+  for (std::size_t n : {0, 1, 2, 3, 10, 1000})
+  {
+    const std::vector<opt_t> input = make_input<EVP>(n, gen);
+    std::vector<opt_t> engaged = engaged_of(input);
+    const std::size_t m = engaged.size();
+
+    for (int stable = 0; stable != 2; ++stable)
+      for (empty_placement where : {empties_first, empties_last})
+      {
+        std::vector<opt_t> v = input;
+        typename std::vector<opt_t>::iterator mid = stable ? stable_partition_engaged(v.begin(), v.end(), where)
+                                                           : partition_engaged(v.begin(), v.end(), where);
+        const std::size_t boundary = where == empties_last ? m : n - m;
+        assert (std::size_t(mid - v.begin()) == boundary);
+        for (std::size_t i = 0; i != n; ++i)
+          assert (v[i].has_value() == ((i < boundary) == (where == empties_last)));
+
+        std::vector<opt_t> got = engaged_of(v);
+        if (stable)
+        {
+          assert (same_sequence(got, engaged));
+        }
+        else
+        {
+          std::vector<opt_t> expected = engaged;
+          std::sort(got.begin(), got.end(), empty_first_less());
+          std::sort(expected.begin(), expected.end(), empty_first_less());
+          assert (same_sequence(got, expected));
+        }
+      }
+  }
+}
+
+void test_partitions()
+{
+  check_partitions< evp_int<int, -1> >([](std::uint64_t x) { return int(x % 1000); });
+  check_partitions< evp_fp_nan<double> >([](std::uint64_t x) { return double(x % 1000); });
+  check_partitions< evp_stl_empty<std::string> >([](std::uint64_t x) { return std::to_string(x % 1000); });
+}
+
+template <typename EVP, typename Gen>
+void check_radix_sort(Gen gen)
+{
+  typedef compact_optional<EVP> opt_t;
+  for (std::size_t n : {0, 1, 2, 5, 100, 10000})
+  {
+    const std::vector<opt_t> input = make_input<EVP>(n, gen);
+
+    std::vector<opt_t> v = input, expected = input;
+    radix_sort(v.data(), v.data() + n);
+    std::stable_sort(expected.begin(), expected.end(), empty_last_less());
+    assert (same_sequence(v, expected));
+
+    v = input;
+    expected = input;
+    radix_sort(v.data(), v.data() + n, empties_first);
+    std::stable_sort(expected.begin(), expected.end(), empty_first_less());
+    assert (same_sequence(v, expected));
+  }
+}
+
+const double fp_specials[] = { 0.0, -0.0, 1.0, -1.0, 1e-310, -1e-310, 1e300, -1e300,
+                               std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity() };
+
+void test_radix_sort()
+{
+  check_radix_sort< evp_int<int, -1> >([](std::uint64_t x) { return int(x) == -1 ? 0 : int(x); });
+  check_radix_sort< evp_int<int, INT_MIN> >([](std::uint64_t x) { return int(x % 100) - 50; }); // few distinct digits
+  check_radix_sort< evp_int<unsigned, 0> >([](std::uint64_t x) { return unsigned(x) | 1u; });
+  check_radix_sort< evp_int<std::int64_t, LLONG_MIN> >([](std::uint64_t x) { return std::int64_t(x >> 1) - (1ll << 62); });
+  check_radix_sort< evp_int<short, -1> >([](std::uint64_t x) { return short(x % 30000); });
+  check_radix_sort< evp_enum<Dir, -1> >([](std::uint64_t x) { return Dir(x % 4); });
+  check_radix_sort< evp_bool >([](std::uint64_t x) { return (x & 2) != 0; });
+  check_radix_sort< evp_fp_nan<double> >([](std::uint64_t x) {
+    return x % 3 == 0 ? fp_specials[x % 10] : double(std::int64_t(x)) / 1e9;
+  });
+  check_radix_sort< evp_fp_nan<float> >([](std::uint64_t x) { return float(std::int64_t(x % 2001) - 1000) / 7; });
+  check_radix_sort< auto_evp<double> >([](std::uint64_t x) { return double(x % 1000) - 500; });
+
+  {
+    // every NaN is empty; -0.0 precedes +0.0
+    typedef compact_optional<evp_fp_nan<double>> opt_double;
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    opt_double v[] = { opt_double(0.0), opt_double(-nan), opt_double(-0.0), opt_double(-2.0), opt_double(nan) };
+    radix_sort(v, v + 5, empties_first);
+    assert (!v[0].has_value() && !v[1].has_value());
+    assert (v[2].value() == -2.0);
+    assert (v[3].value() == 0.0 && std::signbit(v[3].value()));
+    assert (v[4].value() == 0.0 && !std::signbit(v[4].value()));
+  }
+}
+
+template <typename EVP, typename Gen>
+void check_batch(Gen gen)
+{
+  typedef compact_optional<EVP> opt_t;
+  const std::vector<opt_t> all = make_input<EVP>(600, gen);
+  const std::size_t sizes[] = { 0, 1, 15, 16, 17, 63, 64, 65, 130, 597 };
+
+  for (std::size_t off = 0; off != 3; ++off) // unaligned starts
+    for (std::size_t n : sizes)
+    {
+      const opt_t* f = all.data() + off;
+      const opt_t* l = f + n;
+      const std::size_t empties = std::count_if(f, l, [](const opt_t& o) { return !o.has_value(); });
+      assert (count_empty(f, l) == empties);
+
+      const std::uint64_t untouched = 0xdeadbeef;
+      std::vector<std::uint64_t> mask ((n + 63) / 64 + 1, untouched);
+      mask_empty(f, l, mask.data());
+      for (std::size_t i = 0; i != n; ++i)
+        assert (((mask[i / 64] >> (i % 64)) & 1) == !f[i].has_value());
+      if (n % 64 != 0)
+        assert ((mask[n / 64] >> (n % 64)) == 0);
+      assert (mask.back() == untouched);
+
+      std::vector<opt_t> w (f, l);
+      w.push_back(opt_t(gen(5)));
+      fill_empty(w.data(), w.data() + n);
+      assert (std::none_of(w.begin(), w.begin() + n, [](const opt_t& o) { return o.has_value(); }));
+      assert (w.back().has_value());
+    }
+}
+
+void test_batch_kernels()
+{
+  check_batch< evp_int<int, -1> >([](std::uint64_t x) { return int(x % 100); });
+  check_batch< evp_int<std::int64_t, LLONG_MIN> >([](std::uint64_t x) { return std::int64_t(x); });
+  check_batch< evp_int<std::uint64_t, 0> >([](std::uint64_t x) { return x | 1; });
+  check_batch< evp_int<short, -1> >([](std::uint64_t x) { return short(x % 100); });
+  check_batch< evp_int<unsigned char, 255> >([](std::uint64_t x) { return (unsigned char)(x % 255); });
+  check_batch< evp_bool >([](std::uint64_t x) { return x % 2 == 0; });
+  check_batch< evp_enum<Dir, -1> >([](std::uint64_t x) { return Dir(x % 4); });
+  check_batch< evp_fp_nan<float> >([](std::uint64_t x) { return float(x % 1000) - 500; });
+  check_batch< evp_fp_nan<double> >([](std::uint64_t x) { return double(std::int64_t(x)); });
+  check_batch< auto_evp<double> >([](std::uint64_t x) { return double(x % 7); });
+
+  // more than 255 blocks of 8-bit counters, all empty
+  std::vector< compact_optional<evp_bool> > v (16 * 300 + 5);
+  assert (count_empty(v.data(), v.data() + v.size()) == v.size());
+}
+
+int count_calls = 0, fill_calls = 0, mask_calls = 0;
+
+// e.g. minutes since midnight, with batch hooks forwarding to the evp_int kernels
+struct evp_minutes : evp_int<int, -1>
+{
+  typedef compact_optional_ns::detail_::engaged_scan< evp_int<int, -1> > kernels;
+
+  static std::size_t count_empty(const int* p, std::size_t n) { ++count_calls; return kernels::count_empty(p, n); }
+  static void fill_empty(int* p, std::size_t n) { ++fill_calls; kernels::fill_empty(p, n); }
+};
+
+// only mask_empty: counting and searching go through it
+struct evp_masked : evp_int<int, -1>
+{
+  static void mask_empty(const int* p, std::size_t n, std::uint64_t* out)
+  {
+    ++mask_calls;
+    for (std::size_t i = 0; i < n; i += 64)
+    {
+      std::uint64_t m = 0;
+      for (std::size_t j = i; j != n && j != i + 64; ++j)
+        m |= std::uint64_t(p[j] == -1) << (j - i);
+      *out++ = m;
+    }
+  }
+};
+
+void test_batch_hooks()
+{
+  namespace d = compact_optional_ns::detail_;
+  static_assert(d::has_count_empty<evp_minutes>::value && d::has_fill_empty<evp_minutes>::value, "");
+  static_assert(!d::has_mask_empty<evp_minutes>::value && d::has_mask_empty<evp_masked>::value, "");
+  static_assert(!d::has_count_empty< evp_int<int, -1> >::value, "");
+
+  {
+    typedef compact_optional<evp_minutes> opt_t;
+    std::vector<opt_t> v = make_input<evp_minutes>(100, [](std::uint64_t x) { return int(x % 1440); });
+    const std::size_t empties = std::count_if(v.begin(), v.end(), [](const opt_t& o) { return !o.has_value(); });
+    assert (count_empty(v.data(), v.data() + v.size()) == empties);
+    assert (count_calls == 1);
+    const std::vector<opt_t> before = v;
+    fill_empty(v.data(), v.data() + 50);
+    assert (fill_calls == 1);
+    assert (std::equal(v.begin() + 50, v.end(), before.begin() + 50, empty_equal_to()));
+    assert (count_empty(v.data(), v.data() + 50) == 50);
+
+    compact_optional_vector<evp_minutes> cv (10);
+    assert (cv.count_engaged() == 0 && count_calls == 3);
+  }
+  {
+    compact_optional_vector<evp_masked> cv (100);
+    cv.set(70, 5);
+    cv.set(99, 6);
+    assert (cv.count_engaged() == 2);
+    assert (cv.find_engaged() == 70 && cv.find_engaged(71) == 99);
+    assert (mask_calls != 0);
+    std::vector<std::uint64_t> valid = cv.validity_mask();
+    assert (valid[0] == 0 && valid[1] == ((std::uint64_t(1) << 6) | (std::uint64_t(1) << 35)));
+  }
+}
+
+// scalar models of the gap-filling algorithms
+template <typename EVP>
+std::vector<compact_optional<EVP>> model_forward_fill(std::vector<compact_optional<EVP>> v)
+{
+  for (std::size_t i = 1; i < v.size(); ++i)
+    if (!v[i].has_value())
+      v[i] = v[i - 1];
+  return v;
+}
+
+template <typename EVP>
+std::vector<compact_optional<EVP>> model_backward_fill(std::vector<compact_optional<EVP>> v)
+{
+  for (std::size_t i = v.size(); i-- > 1; )
+    if (!v[i - 1].has_value())
+      v[i - 1] = v[i];
+  return v;
+}
+
+template <typename EVP>
+bool same(const std::vector<compact_optional<EVP>>& a, const std::vector<compact_optional<EVP>>& b)
+{
+  return std::equal(a.begin(), a.end(), b.begin(), [](const compact_optional<EVP>& x, const compact_optional<EVP>& y) {
+    return x.has_value() == y.has_value() && (!x.has_value() || x.value() == y.value());
+  });
+}
+
+template <typename EVP, typename Gen>
+void check_gap_fill(Gen gen)
+{
+  typedef compact_optional<EVP> opt_t;
+  // sizes around the 64-element words; long gaps, short gaps, and none
+  const std::size_t sizes[] = { 0, 1, 2, 63, 64, 65, 200, 1000 };
+  for (std::size_t n : sizes)
+  for (int density = 0; density != 4; ++density)
+  {
+    test_input::xorshift64 rnd;
+    std::vector<opt_t> v (n);
+    for (std::size_t i = 0; i != n; ++i)
+    {
+      const std::uint64_t x = rnd();
+      const bool engaged = density == 0 ? x % 50 == 0 : density == 1 ? x % 2 == 0 : density == 2 ? x % 50 != 0 : true;
+      if (engaged)
+        v[i] = opt_t(gen(x));
+    }
+
+    std::vector<opt_t> w = v;
+    forward_fill(w.data(), w.data() + n);
+    assert (same(w, model_forward_fill(v)));
+
+    w = v;
+    backward_fill(w.data(), w.data() + n);
+    assert (same(w, model_backward_fill(v)));
+
+    w = v;
+    replace_empty(w.data(), w.data() + n, gen(7));
+    for (std::size_t i = 0; i != n; ++i)
+      assert (w[i].value() == (v[i].has_value() ? v[i].value() : gen(7)));
+  }
+}
+
+template <typename EVP>
+std::vector<compact_optional<EVP>> series(std::initializer_list<double> xs)
+{
+  std::vector<compact_optional<EVP>> v;
+  for (double x : xs)
+    v.push_back(std::isnan(x) ? compact_optional<EVP>() : compact_optional<EVP>(typename EVP::value_type(x)));
+  return v;
+}
+
+void test_gap_fill()
+{
+  check_gap_fill< evp_fp_nan<double> >([](std::uint64_t x) { return double(x % 1000) / 4; });
+  check_gap_fill< evp_fp_nan<float> >([](std::uint64_t x) { return float(x % 1000); });
+  check_gap_fill< evp_int<int, -1> >([](std::uint64_t x) { return int(x % 1000); });
+  check_gap_fill< evp_int<std::int64_t, INT64_MIN> >([](std::uint64_t x) { return std::int64_t(x >> 3); });
+  check_gap_fill< evp_bool >([](std::uint64_t x) { return x % 3 == 0; });
+  check_gap_fill< evp_stl_empty<std::string> >([](std::uint64_t x) { return std::string(x % 40 + 1, 'a'); });
+
+  typedef evp_fp_nan<double> evp_d;
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  {
+    // gaps at the ends stay empty
+    std::vector<compact_optional<evp_d>> v = series<evp_d>({ nan, 1, nan, nan, nan, 5, 6, nan, 2, nan });
+    interpolate_linear(v.data(), v.data() + v.size());
+    assert (same(v, series<evp_d>({ nan, 1, 2, 3, 4, 5, 6, 4, 2, nan })));
+  }
+  {
+    // by position: samples at 0, 1, 3 and 4
+    std::vector<compact_optional<evp_d>> v = series<evp_d>({ 0, nan, nan, 8 });
+    const int at[] = { 0, 1, 3, 4 };
+    interpolate_linear(v.data(), v.data() + v.size(), at);
+    assert (same(v, series<evp_d>({ 0, 2, 6, 8 })));
+  }
+  {
+    // integers round to nearest
+    typedef evp_int<int, INT_MIN> evp_i;
+    std::vector<compact_optional<evp_i>> v = series<evp_i>({ 0, nan, nan, 1, nan, nan, nan, nan, nan, nan, -9 });
+    interpolate_linear(v.data(), v.data() + v.size());
+    assert (same(v, series<evp_i>({ 0, 0, 1, 1, 0, -2, -3, -5, -6, -8, -9 })));
+  }
+  {
+    // 64-bit integers keep their low bits, also above 2^63
+    typedef compact_optional< evp_int<long long, -1> > opt_ll;
+    std::vector<opt_ll> v (5);
+    v[0] = v[2] = opt_ll(7000000000000000003);
+    v[4] = opt_ll(7000000000000000007);
+    interpolate_linear(v.data(), v.data() + v.size());
+    assert (v[1].value() == 7000000000000000003);
+    assert (v[3].value() == 7000000000000000005);
+
+    typedef compact_optional< evp_int<std::uint64_t, 0> > opt_u64;
+    std::vector<opt_u64> u (4);
+    u[0] = opt_u64(UINT64_MAX - 1);
+    u[2] = opt_u64(UINT64_MAX - 1);
+    u[3] = opt_u64(1);
+    interpolate_linear(u.data(), u.data() + u.size());
+    assert (u[1].value() == UINT64_MAX - 1);
+  }
+}
+
+int main()
+{
+  test_partitions();
+  test_radix_sort();
+  test_batch_kernels();
+  test_batch_hooks();
+  test_gap_fill();
+}
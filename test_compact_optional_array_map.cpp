@@ -0,0 +1,189 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "compact_optional_array_map.hpp"
+#include "test_input.hpp"
+#include <cassert>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+using namespace ak_toolbox;
+
+template <typename Layout>
+void test_basics()
+{
+  typedef compact_optional_array_map<evp_int<int, -1>, Layout> map_t;
+  map_t m;
+  assert (m.empty());
+  assert (!m.contains(0));
+  assert (!m[5].has_value());
+  bool done = m.erase(5);
+  assert (!done);
+  assert (m.slot_count() == 0);
+
+  done = m.insert(3, 30);
+  assert (done);
+  done = m.insert(3, 31);
+  assert (!done);
+  assert (m[3].value() == 30);
+  m.set(3, 32);
+  m.set(100, 1000);
+  assert (m.size() == 2);
+  assert (m[3].value() == 32);
+  assert (m[100].value() == 1000);
+  assert (!m[4].has_value());
+  assert (!m[1000000].has_value()); // past the slots
+  assert (m.count(100) == 1);
+  assert (m.count(101) == 0);
+  assert (m.slot_count() > 100);
+
+  done = m.erase(3);
+  assert (done);
+  done = m.erase(3);
+  assert (!done);
+  assert (!m.contains(3));
+  assert (m.size() == 1);
+
+  std::size_t visited = 0;
+  m.for_each([&](std::size_t k, int v) { assert (k == 100 && v == 1000); ++visited; });
+  assert (visited == 1);
+
+  m.clear();
+  assert (m.empty());
+  assert (!m.contains(100));
+  m.set(100, 1);
+  assert (m[100].value() == 1);
+}
+
+template <typename Layout>
+void test_against_std_map()
+{
+  typedef compact_optional_array_map<evp_int<std::int64_t, 0>, Layout> map_t;
+  map_t m;
+  std::map<std::size_t, std::int64_t> ref;
+
+  test_input::xorshift64 rnd;
+  for (int i = 0; i != 20000; ++i)
+  {
+    const std::uint64_t x = rnd();
+    const std::size_t k = x % 5000 + (x % 3 == 0 ? 1000000 : 0);
+    const std::int64_t v = std::int64_t(x >> 20) + 1;
+    switch (x % 4)
+    {
+      case 0:
+      {
+        const bool inserted = m.insert(k, v);
+        const bool ref_inserted = ref.insert(std::make_pair(k, v)).second;
+        assert (inserted == ref_inserted);
+        break;
+      }
+      case 1: m.set(k, v); ref[k] = v; break;
+      case 2:
+      {
+        const bool erased = m.erase(k);
+        const bool ref_erased = ref.erase(k) == 1;
+        assert (erased == ref_erased);
+        break;
+      }
+      default: assert (m.contains(k) == (ref.count(k) == 1));
+    }
+  }
+  assert (m.size() == ref.size());
+
+  // in increasing order of keys
+  typedef std::vector< std::pair<std::size_t, std::int64_t> > pairs;
+  pairs seen;
+  m.for_each([&](std::size_t k, std::int64_t v) { seen.push_back(std::make_pair(k, v)); });
+  assert (seen == pairs(ref.begin(), ref.end()));
+}
+
+void test_dense_growth()
+{
+  compact_optional_array_map<evp_fp_nan<double>> m;
+  m.reserve(1000);
+  assert (m.slot_count() == 1000);
+  assert (m.memory_usage() >= 1000 * sizeof(double));
+  m.set(5000, 0.5);
+  assert (m.slot_count() > 5000);
+  assert (m[5000].value() == 0.5);
+  for (std::size_t i = 0; i != 5000; ++i)
+    assert (!m[i].has_value());
+}
+
+void test_paged_memory()
+{
+  typedef compact_optional_array_map<evp_int<int, -1>, array_map_paged> map_t;
+  static_assert(map_t::page_slots == 1024, "4 KB pages of ints");
+
+  map_t m;
+  m.set(100000000, 1);
+  m.set(100000001, 2);
+  assert (m.page_count() == 1);
+  assert (m.memory_usage() <= 4096 + 2 * (100000001 / 1024 + 1) * sizeof(void*)); // a page and the directory
+  assert (!m[99999999].has_value());
+  assert (!m[7].has_value()); // no page there
+
+  m.set(7, 7);
+  assert (m.page_count() == 2);
+
+  m.erase(100000000);
+  m.erase(100000001);
+  m.shrink_to_fit();
+  assert (m.page_count() == 1);
+  assert (m.slot_count() == map_t::page_slots);
+  assert (m[7].value() == 7);
+
+  m.clear();
+  assert (m.page_count() == 0);
+  assert (m.memory_usage() == 0);
+}
+
+// the empty value is rejected at run time, leaving the map unchanged
+template <typename Layout>
+void test_empty_value()
+{
+  compact_optional_array_map<evp_int<int, -1>, Layout> m;
+  bool done = m.set(4, -1);
+  assert (!done);
+  assert (m.empty());
+  assert (!m.contains(4));
+
+  m.set(4, 40);
+  done = m.set(4, -1);
+  assert (!done);
+  done = m.insert(5, -1);
+  assert (!done);
+  assert (m.size() == 1);
+  assert (m[4].value() == 40);
+  assert (!m.contains(5));
+
+}
+
+void test_key_too_large()
+{
+  // no dense array can have a slot for the largest key
+  compact_optional_array_map<evp_int<int, -1>> m;
+  bool thrown = false;
+  try { m.set(std::size_t(-1), 1); }
+  catch (const std::length_error&) { thrown = true; }
+  assert (thrown);
+  assert (m.empty());
+}
+
+int main()
+{
+  test_basics<array_map_dense>();
+  test_basics<array_map_paged>();
+  test_against_std_map<array_map_dense>();
+  test_against_std_map<array_map_paged>();
+  test_dense_growth();
+  test_paged_memory();
+  test_empty_value<array_map_dense>();
+  test_empty_value<array_map_paged>();
+  test_key_too_large();
+}
@@ -0,0 +1,90 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "compact_optional_arrow.hpp"
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+using namespace ak_toolbox;
+
+enum class Dir { N, E, S, W };
+
+template <typename EVP, typename Gen>
+void check_round_trip(std::size_t n, Gen gen)
+{
+  typedef compact_optional<EVP> opt_t;
+  typedef typename EVP::storage_type storage_type;
+
+  std::vector<opt_t> src;
+  for (std::size_t i = 0; i != n; ++i)
+    src.push_back(i % 3 == 1 ? opt_t() : opt_t(gen(i)));
+
+  // export: the values buffer is the array itself
+  const storage_type* values = arrow_values(src.data());
+  assert (static_cast<const void*>(values) == static_cast<const void*>(src.data()));
+
+  std::vector<std::uint8_t> bitmap ((n + 7) / 8, 0xAA);
+  std::size_t nulls = to_arrow_validity(src.data(), n, bitmap.data());
+  assert (nulls == (n + 1) / 3);
+  for (std::size_t i = 0; i != n; ++i)
+    assert (bool((bitmap[i / 8] >> (i % 8)) & 1u) == src[i].has_value());
+  if (n % 8 != 0)
+    assert ((bitmap.back() >> (n % 8)) == 0);
+
+  // import into fresh objects
+  std::vector<opt_t> dst (n);
+  assert (from_arrow(values, bitmap.data(), n, dst.data()) == n);
+  for (std::size_t i = 0; i != n; ++i)
+  {
+    assert (dst[i].has_value() == src[i].has_value());
+    if (src[i].has_value())
+      assert (dst[i].value() == src[i].value());
+  }
+}
+
+void test_round_trips()
+{
+  const std::size_t sizes[] = { 0, 1, 7, 8, 9, 63, 64, 65, 200 };
+  for (std::size_t n : sizes)
+  {
+    check_round_trip< evp_int<int, -1> >(n, [](std::size_t i) { return int(i); });
+    check_round_trip< evp_int<std::int64_t, -1> >(n, [](std::size_t i) { return std::int64_t(i) * 1000; });
+    check_round_trip< evp_fp_nan<double> >(n, [](std::size_t i) { return double(i) / 4; });
+    check_round_trip< evp_fp_nan<float> >(n, [](std::size_t i) { return float(i) / 4; });
+    check_round_trip< evp_enum<Dir, -1> >(n, [](std::size_t i) { return Dir(i % 4); });
+  }
+}
+
+void test_import_in_place_and_collisions()
+{
+  typedef compact_optional<evp_int<int, -1>> opt_int;
+
+  // an Arrow column: values with garbage under the null bits
+  std::vector<int> buffer = { 10, 777, 12, -1, 14, 15, 777, 17, 18 };
+  const std::uint8_t validity[] = { 0xBD, 0x01 }; // nulls at 1 and 6
+
+  opt_int* opts = reinterpret_cast<opt_int*>(buffer.data());
+  assert (from_arrow(buffer.data(), validity, buffer.size(), opts) == 3); // -1 is valid in Arrow
+  assert (opts[0].value() == 10);
+  assert (!opts[1].has_value());
+  assert (!opts[3].has_value());
+  assert (!opts[6].has_value());
+  assert (opts[8].value() == 18);
+  assert (buffer[1] == -1);
+
+  // an absent bitmap means no nulls
+  std::vector<int> all = { 1, 2, 3 };
+  std::vector<opt_int> out (3);
+  assert (from_arrow(all.data(), nullptr, all.size(), out.data()) == 3);
+  assert (out[2].value() == 3);
+}
+
+int main()
+{
+  test_round_trips();
+  test_import_in_place_and_collisions();
+}
@@ -0,0 +1,104 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "compact_optional_bitset.hpp"
+#include <cassert>
+#include <vector>
+
+using namespace ak_toolbox;
+
+typedef compact_optional<evp_bool> opt_bool;
+
+// element i cycles through empty, false, true
+opt_bool pattern(std::size_t i, std::size_t shift)
+{
+  switch ((i + shift) % 3)
+  {
+    case 0: return opt_bool();
+    case 1: return opt_bool(false);
+    default: return opt_bool(true);
+  }
+}
+
+bool same(opt_bool a, opt_bool b)
+{
+  return a.unsafe_raw_value() == b.unsafe_raw_value();
+}
+
+opt_bool kleene_and(opt_bool a, opt_bool b)
+{
+  if ((a.has_value() && !a.value()) || (b.has_value() && !b.value())) return opt_bool(false);
+  if (a.has_value() && b.has_value()) return opt_bool(true);
+  return opt_bool();
+}
+
+opt_bool kleene_or(opt_bool a, opt_bool b)
+{
+  if ((a.has_value() && a.value()) || (b.has_value() && b.value())) return opt_bool(true);
+  if (a.has_value() && b.has_value()) return opt_bool(false);
+  return opt_bool();
+}
+
+void test_access_and_counts()
+{
+  compact_optional_bitset b;
+  for (std::size_t i = 0; i != 200; ++i)
+    b.push_back(pattern(i, 0));
+
+  assert (b.size() == 200);
+  for (std::size_t i = 0; i != 200; ++i)
+    assert (same(b[i], pattern(i, 0)));
+
+  assert (b.count_empty() == 67);
+  assert (b.count_false() == 67);
+  assert (b.count_true() == 66);
+
+  b.set(0, true);
+  b.set(1, opt_bool());
+  b.reset(2);
+  assert (b[0].value() == true);
+  assert (!b[1].has_value());
+  assert (!b[2].has_value());
+  assert (b.count_empty() == 68);
+  assert (b.count_false() == 66);
+  assert (b.count_true() == 66);
+
+  b.resize(70);
+  b.resize(130);
+  assert (!b[100].has_value());
+  assert (b.count_empty() + b.count_false() + b.count_true() == 130);
+
+  compact_optional_bitset e (10);
+  assert (e.count_empty() == 10);
+}
+
+void test_three_valued_logic()
+{
+  const std::size_t n = 150;
+  compact_optional_bitset a, b;
+  for (std::size_t i = 0; i != n; ++i)
+  {
+    a.push_back(pattern(i, 0));
+    b.push_back(pattern(i / 3, 0)); // every combination of a and b occurs
+  }
+
+  compact_optional_bitset r_and = a & b, r_or = a | b, r_not = ~a;
+  for (std::size_t i = 0; i != n; ++i)
+  {
+    assert (same(r_and[i], kleene_and(a[i], b[i])));
+    assert (same(r_or[i], kleene_or(a[i], b[i])));
+    assert (r_not[i].has_value() == a[i].has_value());
+    if (a[i].has_value())
+      assert (r_not[i].value() == !a[i].value());
+  }
+  assert (r_not.count_true() == a.count_false());
+}
+
+int main()
+{
+  test_access_and_counts();
+  test_three_valued_logic();
+}
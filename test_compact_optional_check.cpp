@@ -0,0 +1,204 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// policies without their own collision_check throw
+#define AK_TOOLBOX_COLLISION_CHECK check_throw
+
+// value() on an empty object is to be counted here, not asserted
+#define NDEBUG
+#include "compact_optional_counters.hpp"
+#undef NDEBUG
+#include <cassert>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+using namespace ak_toolbox;
+
+typedef evp_int<int, -1> evp_throw;
+
+struct evp_ignore : evp_int<int, -1>
+{
+  typedef check_ignore collision_check;
+};
+
+struct evp_count : evp_int<int, -1>
+{
+  typedef check_count collision_check;
+};
+
+struct evp_count_string : evp_stl_empty<std::string>
+{
+  typedef check_count collision_check;
+};
+
+// a non-trivial type in POD storage (buffer_storage), -1 minutes reading as empty
+struct tracked_minutes
+{
+  static int live;
+  int minutes;
+  explicit tracked_minutes(int m) : minutes(m) { ++live; }
+  tracked_minutes(const tracked_minutes& r) : minutes(r.minutes) { ++live; }
+  tracked_minutes& operator=(const tracked_minutes& r) { minutes = r.minutes; return *this; }
+  ~tracked_minutes() { --live; }
+};
+int tracked_minutes::live = 0;
+
+struct evp_tracked_minutes : compact_optional_pod_storage_type<tracked_minutes, int>
+{
+  typedef check_throw collision_check;
+  static storage_type empty_value() { return -1; }
+  static bool is_empty_value(const storage_type& v) { return v == -1; }
+};
+
+namespace co = compact_optional_ns::detail_;
+
+void test_ignore_compiles_away()
+{
+  static_assert(!co::checks_collisions<evp_ignore>::value, "");
+  static_assert(std::is_same<co::counted_storage_of<evp_ignore>::type, co::member_storage<evp_ignore>>::value, "");
+  static_assert(std::is_trivially_copyable<compact_optional<evp_ignore>>::value, "");
+  static_assert(sizeof(compact_optional<evp_ignore>) == sizeof(int), "");
+
+  constexpr compact_optional<evp_ignore> c (-1);
+  static_assert(!c.has_value(), "");
+
+  compact_optional<evp_ignore> o (-1); // silently empty
+  assert (!o.has_value());
+}
+
+void test_throw()
+{
+  static_assert(std::is_trivially_copyable<compact_optional<evp_throw>>::value, "");
+  constexpr compact_optional<evp_throw> c (1); // no collision: still a constant expression
+  static_assert(c.value() == 1, "");
+
+  bool thrown = false;
+  try { compact_optional<evp_throw> o (-1); }
+  catch (const sentinel_collision&) { thrown = true; }
+  assert (thrown);
+
+  thrown = false;
+  compact_optional<evp_throw> o (2);
+  try { o.emplace(-1); }
+  catch (const sentinel_collision&) { thrown = true; }
+  assert (thrown);
+  assert (!o.has_value()); // left empty
+
+  thrown = false;
+  compact_optional<evp_stl_empty<std::string>> s (std::string("a"));
+  try { s = std::string(); }
+  catch (const sentinel_collision&) { thrown = true; }
+  assert (thrown);
+
+  thrown = false;
+  try { compact_optional<evp_fp_nan<double>> d (0.0 / 0.0); }
+  catch (const sentinel_collision&) { thrown = true; }
+  assert (thrown);
+
+  // buffer storage: the colliding value is destroyed, and the object left empty
+  typedef compact_optional<evp_tracked_minutes> opt_minutes;
+  static_assert(std::is_same<co::storage_destruction<evp_tracked_minutes>::type,
+                             co::buffer_storage<evp_tracked_minutes>>::value, "");
+  {
+    thrown = false;
+    try { opt_minutes m ((tracked_minutes(-1))); }
+    catch (const sentinel_collision&) { thrown = true; }
+    assert (thrown);
+    assert (tracked_minutes::live == 0);
+
+    opt_minutes m ((tracked_minutes(10)));
+    assert (tracked_minutes::live == 1);
+    thrown = false;
+    try { m.emplace(-1); }
+    catch (const sentinel_collision&) { thrown = true; }
+    assert (thrown);
+    assert (!m.has_value());
+    assert (tracked_minutes::live == 0);
+
+    m.emplace(20);
+    thrown = false;
+    try { m = tracked_minutes(-1); } // assigned to the contained value
+    catch (const sentinel_collision&) { thrown = true; }
+    assert (thrown);
+    assert (!m.has_value());
+    assert (tracked_minutes::live == 0);
+
+    m.emplace(30);
+    assert (m.value().minutes == 30);
+  }
+  assert (tracked_minutes::live == 0);
+
+  compact_optional<evp_throw> e; // the empty state itself is not a collision
+  e = compact_optional<evp_throw>();
+  e.reset();
+  assert (!e.has_value());
+}
+
+void test_count()
+{
+  static_assert(sizeof(compact_optional<evp_count>) == sizeof(int), "");
+  const compact_optional_counts before = compact_optional_counters<evp_count>();
+
+  {
+    compact_optional<evp_count> a (-1);  // construction, collision
+    compact_optional<evp_count> b (2);   // construction
+    compact_optional<evp_count> c (a);   // copy
+    compact_optional<evp_count> d (std::move(b)); // move
+    c = d;                               // copy
+    c = std::move(a);                    // move
+    d.emplace(-1);                       // collision
+    assert (a.value() == -1);            // empty access
+    assert (c.value() == -1);            // empty access
+    assert (b.value() == 2);
+  }
+
+  const compact_optional_counts after = compact_optional_counters<evp_count>();
+  assert (after.collisions - before.collisions == 2);
+  assert (after.empty_accesses - before.empty_accesses == 2);
+  assert (after.constructions - before.constructions == 2);
+  assert (after.copies - before.copies == 2);
+  assert (after.moves - before.moves == 2);
+
+  // other policies have their own counters
+  compact_optional<evp_count_string> s ((std::string()));
+  assert (compact_optional_counters<evp_count_string>().collisions == 1);
+  assert (compact_optional_counters<evp_count>().collisions == after.collisions);
+}
+
+void test_count_threads()
+{
+  const compact_optional_counts before = compact_optional_counters<evp_count>();
+  const int threads = 4, n = 10000;
+
+  {
+    // counts of finished threads are kept
+    std::vector<std::thread> ts;
+    for (int t = 0; t != threads; ++t)
+      ts.push_back(std::thread([] {
+        for (int i = 0; i != n; ++i)
+        {
+          compact_optional<evp_count> o (i % 10 - 1);
+          (void)o;
+        }
+      }));
+    for (std::thread& t : ts)
+      t.join();
+  }
+
+  const compact_optional_counts after = compact_optional_counters<evp_count>();
+  assert (after.constructions - before.constructions == std::uint64_t(threads) * n);
+  assert (after.collisions - before.collisions == std::uint64_t(threads) * n / 10);
+}
+
+int main()
+{
+  test_ignore_compiles_away();
+  test_throw();
+  test_count();
+  test_count_threads();
+}
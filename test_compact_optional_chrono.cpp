@@ -0,0 +1,121 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "compact_optional_chrono.hpp"
+#include "compact_optional_vector.hpp"
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+using namespace ak_toolbox;
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+
+typedef std::chrono::time_point<std::chrono::system_clock, milliseconds> sys_ms;
+typedef compact_optional< evp_duration<milliseconds> > opt_ms;
+typedef compact_optional< evp_time_point<sys_ms> > opt_time;
+
+void test_policies()
+{
+  static_assert(sizeof(opt_ms) == sizeof(milliseconds::rep), "");
+  static_assert(sizeof(opt_time) == sizeof(sys_ms::rep), "");
+  static_assert(std::is_trivially_copyable<opt_ms>::value, "");
+
+  constexpr opt_ms c (milliseconds(5));
+  static_assert(c.has_value(), "");
+  static_assert(c.value() == milliseconds(5), "");
+  static_assert(!opt_ms().has_value(), "");
+
+  opt_ms d (milliseconds(-3));
+  assert (d.has_value());
+  assert (d.value() == milliseconds(-3));
+  assert (!opt_ms(milliseconds::min()).has_value()); // the empty value
+
+  opt_time t (sys_ms(milliseconds(1500)));
+  assert (t.value().time_since_epoch() == milliseconds(1500));
+  assert (!opt_time().has_value());
+
+  compact_optional< evp_duration<seconds> > s (seconds(0)); // zero is a value
+  assert (s.has_value());
+}
+
+void test_batch()
+{
+  // the sentinel kernels of the rep type
+  typedef compact_optional_ns::detail_::engaged_scan< evp_duration<milliseconds> > scan;
+  typedef compact_optional_ns::detail_::sentinel_engaged_scan<milliseconds::rep, INT64_MIN> sentinel_scan;
+  static_assert(std::is_base_of<sentinel_scan, scan>::value, "");
+
+  std::vector<opt_time> v (100);
+  for (std::size_t i = 0; i < v.size(); i += 3)
+    v[i] = opt_time(sys_ms(milliseconds(i)));
+  assert (count_empty(v.data(), v.data() + v.size()) == 66);
+
+  compact_optional_vector< evp_duration<milliseconds> > cv (70);
+  cv.set(65, milliseconds(1));
+  assert (cv.count_engaged() == 1);
+  assert (cv.find_engaged() == 65);
+}
+
+void test_gap_fill()
+{
+  // timestamps with a missing sample, filled by forward fill
+  std::vector<opt_time> t (4);
+  t[0] = opt_time(sys_ms(milliseconds(1000)));
+  t[1] = opt_time(sys_ms(milliseconds(2000)));
+  t[3] = opt_time(sys_ms(milliseconds(4000)));
+  std::vector<opt_time> f = t;
+  forward_fill(f.data(), f.data() + f.size());
+  assert (f[2].value() == sys_ms(milliseconds(2000)));
+
+  // durations interpolate, rounding to the nearest tick
+  interpolate_linear(t.data(), t.data() + t.size());
+  assert (t[2].value() == sys_ms(milliseconds(3000)));
+
+  std::vector<opt_ms> d (5);
+  d[0] = opt_ms(milliseconds(0));
+  d[4] = opt_ms(milliseconds(10));
+  std::vector<opt_ms> e = d;
+  interpolate_linear(d.data(), d.data() + d.size());
+  assert (d[1].value() == milliseconds(3)); // 2.5 rounds away from zero
+  assert (d[2].value() == milliseconds(5));
+  assert (d[3].value() == milliseconds(8));
+
+  // doubles sampled at time points
+  typedef compact_optional< evp_fp_nan<double> > opt_d;
+  std::vector<opt_d> m (4);
+  m[0] = opt_d(1.0);
+  m[3] = opt_d(4.0);
+  const sys_ms at[] = { sys_ms(seconds(10)), sys_ms(seconds(11)), sys_ms(seconds(13)), sys_ms(seconds(16)) };
+  interpolate_linear(m.data(), m.data() + m.size(), at);
+  assert (m[1].value() == 1.5);
+  assert (m[2].value() == 2.5);
+
+  // nanosecond time points beyond 2^53 keep their low bits
+  typedef std::chrono::time_point<std::chrono::system_clock, std::chrono::nanoseconds> sys_ns;
+  typedef compact_optional< evp_time_point<sys_ns> > opt_ns;
+  const std::chrono::nanoseconds t0 (1700000000000000001);
+  std::vector<opt_ns> ns (6);
+  ns[0] = ns[2] = opt_ns(sys_ns(t0));
+  ns[5] = opt_ns(sys_ns(t0 + std::chrono::nanoseconds(3)));
+  interpolate_linear(ns.data(), ns.data() + ns.size());
+  assert (ns[1].value() == sys_ns(t0));
+  assert (ns[3].value() == sys_ns(t0 + std::chrono::nanoseconds(1)));
+  assert (ns[4].value() == sys_ns(t0 + std::chrono::nanoseconds(2)));
+
+  replace_empty(e.data(), e.data() + e.size(), milliseconds(-1));
+  assert (e[2].value() == milliseconds(-1));
+  assert (e[4].value() == milliseconds(10));
+}
+
+int main()
+{
+  test_policies();
+  test_batch();
+  test_gap_fill();
+}
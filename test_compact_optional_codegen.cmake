@@ -0,0 +1,36 @@
+# Compiles SOURCE to assembly with COMPILER and FLAGS, and fails if a
+# function whose name starts with codegen_ has a conditional jump or a call.
+# Usage: cmake -DCOMPILER=... -DFLAGS="..." -DSOURCE=... -P test_compact_optional_codegen.cmake
+
+separate_arguments(FLAGS)
+execute_process(COMMAND ${COMPILER} ${FLAGS} -S -o - ${SOURCE}
+                RESULT_VARIABLE result OUTPUT_VARIABLE asm ERROR_VARIABLE errors)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "compilation failed:\n${errors}")
+endif()
+
+string(REPLACE ";" "," asm "${asm}")
+string(REPLACE "\n" ";" lines "${asm}")
+
+set(function "")
+set(checked 0)
+set(failed "")
+foreach(line ${lines})
+  if(line MATCHES "^_?(codegen_[A-Za-z0-9_]+):")
+    set(function ${CMAKE_MATCH_1})
+    math(EXPR checked "${checked} + 1")
+  elseif(line MATCHES "^[ \t]*\\.cfi_endproc" OR line MATCHES "^[ \t]*\\.size")
+    set(function "")
+  elseif(function AND (line MATCHES "^[ \t]+j[a-z]+[ \t]" AND NOT line MATCHES "^[ \t]+jmp[ \t]"
+                       OR line MATCHES "^[ \t]+call"))
+    set(failed "${failed}\n  ${function}: ${line}")
+  endif()
+endforeach()
+
+if(checked EQUAL 0)
+  message(FATAL_ERROR "no codegen_ functions found in the assembly of ${SOURCE}")
+endif()
+if(failed)
+  message(FATAL_ERROR "branches or calls in branchless functions:${failed}")
+endif()
+message(STATUS "${checked} functions without conditional jumps or calls")
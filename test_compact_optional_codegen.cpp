@@ -0,0 +1,69 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// value_or for arithmetic and enum policies. Run as a test, and also
+// compiled to assembly by test_compact_optional_codegen.cmake, which checks
+// that the functions named codegen_* contain no conditional jump and no call.
+
+#include "compact_optional.hpp"
+#include <cassert>
+#include <cstdint>
+#include <limits>
+
+using namespace ak_toolbox;
+
+enum class level { low, mid, high };
+
+typedef compact_optional<evp_int<int, -1>> opt_int;
+typedef compact_optional<evp_int<std::uint8_t, 0xFF>> opt_u8;
+typedef compact_optional<evp_int<std::int64_t, INT64_MIN>> opt_i64;
+typedef compact_optional<evp_fp_nan<double>> opt_double;
+typedef compact_optional<evp_fp_nan<float>> opt_float;
+typedef compact_optional<evp_bool> opt_bool;
+typedef compact_optional<evp_enum<level, -1>> opt_level;
+
+extern "C" {
+
+int codegen_value_or_int(const opt_int* o, int d) { return o->value_or(d); }
+std::uint8_t codegen_value_or_u8(const opt_u8* o, std::uint8_t d) { return o->value_or(d); }
+std::int64_t codegen_value_or_i64(const opt_i64* o, std::int64_t d) { return o->value_or(d); }
+double codegen_value_or_double(const opt_double* o, double d) { return o->value_or(d); }
+float codegen_value_or_float(const opt_float* o, float d) { return o->value_or(d); }
+bool codegen_value_or_bool(const opt_bool* o, bool d) { return o->value_or(d); }
+level codegen_value_or_enum(const opt_level* o, level d) { return o->value_or(d); }
+
+} // extern "C"
+
+int main()
+{
+  const opt_int i_, i5 (5);
+  assert (codegen_value_or_int(&i_, 7) == 7);
+  assert (codegen_value_or_int(&i5, 7) == 5);
+
+  const opt_u8 u_, u9 (9);
+  assert (codegen_value_or_u8(&u_, 1) == 1);
+  assert (codegen_value_or_u8(&u9, 1) == 9);
+
+  const opt_i64 l_, lmax (INT64_MAX);
+  assert (codegen_value_or_i64(&l_, -3) == -3);
+  assert (codegen_value_or_i64(&lmax, -3) == INT64_MAX);
+
+  const opt_double d_, dinf (std::numeric_limits<double>::infinity());
+  assert (codegen_value_or_double(&d_, 0.25) == 0.25);
+  assert (codegen_value_or_double(&dinf, 0.25) == std::numeric_limits<double>::infinity());
+
+  const opt_float f_, fneg (-1.0f);
+  assert (codegen_value_or_float(&f_, 2.0f) == 2.0f);
+  assert (codegen_value_or_float(&fneg, 2.0f) == -1.0f);
+
+  const opt_bool b_, bT (true);
+  assert (codegen_value_or_bool(&b_, false) == false);
+  assert (codegen_value_or_bool(&bT, false) == true);
+
+  const opt_level e_, eHigh (level::high);
+  assert (codegen_value_or_enum(&e_, level::mid) == level::mid);
+  assert (codegen_value_or_enum(&eHigh, level::mid) == level::high);
+}
@@ -0,0 +1,131 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "compact_optional_column_file.hpp"
+#include <cassert>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace ak_toolbox;
+
+enum class Dir { N, E, S, W };
+
+std::string temp_path()
+{
+#if defined AK_TOOLBOX_MAPPED_FILE_POSIX
+  char path[] = "/tmp/test_compact_optional_column_fileXXXXXX";
+  int fd = mkstemp(path);
+  assert (fd >= 0);
+  ::close(fd);
+  return path;
+#else
+  return "test_compact_optional_column_file.tmp";
+#endif
+}
+
+template <typename EVP, typename Gen>
+void check_round_trip(std::size_t n, Gen gen)
+{
+  typedef compact_optional<EVP> opt_t;
+  std::vector<opt_t> v;
+  for (std::size_t i = 0; i != n; ++i)
+    v.push_back(i % 3 == 0 ? opt_t() : opt_t(gen(i)));
+
+  const std::string path = temp_path();
+  assert (write_column_file(path.c_str(), v.data(), v.size()) == column_file_ok);
+  {
+    column_file<EVP> f (path.c_str());
+    assert (f.error() == column_file_ok);
+    assert (f.verify() == column_file_ok);
+    assert (f.size() == n);
+    assert (f.empty() == (n == 0));
+    for (std::size_t i = 0; i != n; ++i)
+    {
+      assert (f[i].has_value() == v[i].has_value());
+      if (v[i].has_value())
+        assert (f[i].value() == v[i].value());
+    }
+    assert (std::size_t(f.end() - f.begin()) == n);
+  }
+  std::remove(path.c_str());
+}
+
+void test_round_trip()
+{
+  check_round_trip< evp_int<int, -1> >(1000, [](std::size_t i) { return int(i); });
+  check_round_trip< evp_int<int, -1> >(0, [](std::size_t i) { return int(i); });
+  check_round_trip< evp_int<short, -1> >(77, [](std::size_t i) { return short(i); }); // tail bytes in the checksum
+  check_round_trip< evp_fp_nan<double> >(1000, [](std::size_t i) { return double(i) / 3; });
+  check_round_trip< evp_bool >(100, [](std::size_t i) { return i % 2 == 0; });
+  check_round_trip< evp_enum<Dir, -1> >(100, [](std::size_t i) { return Dir(i % 4); });
+  check_round_trip< auto_evp<float> >(100, [](std::size_t i) { return float(i); });
+}
+
+void rewrite_byte(const std::string& path, long offset, unsigned char xor_mask)
+{
+  std::FILE* f = std::fopen(path.c_str(), "r+b");
+  assert (f);
+  std::fseek(f, offset, SEEK_SET);
+  int c = std::fgetc(f);
+  std::fseek(f, offset, SEEK_SET);
+  std::fputc(c ^ xor_mask, f);
+  std::fclose(f);
+}
+
+void test_mismatches()
+{
+  typedef compact_optional< evp_int<int, -1> > opt_int;
+  std::vector<opt_int> v (100, opt_int(7));
+  v[5] = opt_int();
+  const std::string path = temp_path();
+  assert (write_column_file(path.c_str(), v.data(), v.size()) == column_file_ok);
+
+  // the sentinel compiled into this program must match the file's
+  assert ((column_file< evp_int<int, 0> >(path.c_str()).error() == column_file_sentinel_mismatch));
+  assert ((column_file< evp_int<unsigned, unsigned(-1)> >(path.c_str()).error() == column_file_policy_mismatch));
+  assert ((column_file< evp_fp_nan<float> >(path.c_str()).error() == column_file_policy_mismatch));
+  assert ((column_file< evp_int<std::int64_t, -1> >(path.c_str()).error() == column_file_layout_mismatch));
+  assert ((column_file< evp_int<int, -1> >(path.c_str()).error() == column_file_ok));
+
+  // damaged data is found by verify()
+  rewrite_byte(path, 128 + 4 * 50, 1);
+  {
+    column_file< evp_int<int, -1> > f (path.c_str());
+    assert (f.error() == column_file_ok);
+    assert (f.verify() == column_file_bad_checksum);
+  }
+  rewrite_byte(path, 128 + 4 * 50, 1);
+  assert ((column_file< evp_int<int, -1> >(path.c_str()).verify() == column_file_ok));
+
+  // a damaged header is found on open
+  rewrite_byte(path, 32, 0x80); // element count
+  assert ((column_file< evp_int<int, -1> >(path.c_str()).error() == column_file_bad_header));
+  rewrite_byte(path, 32, 0x80);
+  rewrite_byte(path, 12, 0xff); // byte order
+  assert ((column_file< evp_int<int, -1> >(path.c_str()).error() == column_file_wrong_byte_order));
+  rewrite_byte(path, 12, 0xff);
+
+  // truncated
+  {
+    std::FILE* f = std::fopen(path.c_str(), "wb");
+    unsigned char header[128];
+    compact_optional_ns::detail_::make_column_header< evp_int<int, -1> >(header, 100, 0);
+    std::fwrite(header, 1, sizeof header, f);
+    std::fwrite(v.data(), sizeof(opt_int), 99, f);
+    std::fclose(f);
+    assert ((column_file< evp_int<int, -1> >(path.c_str()).error() == column_file_bad_header));
+  }
+
+  std::remove(path.c_str());
+  assert ((column_file< evp_int<int, -1> >(path.c_str()).error() == column_file_io_error));
+}
+
+int main()
+{
+  test_round_trip();
+  test_mismatches();
+}
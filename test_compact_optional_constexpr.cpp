@@ -0,0 +1,187 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Compile-time tables of compact_optional; built as C++14 and as C++17.
+// Almost every check is a static_assert.
+
+#include "compact_optional.hpp"
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#if __cplusplus >= 201703L
+# include <optional>
+#endif
+
+#if __cplusplus < 201402L
+# error this test requires C++14
+#endif
+
+using namespace ak_toolbox;
+
+typedef compact_optional<evp_int<int, -1>> opt_int;
+typedef compact_optional<evp_bool> opt_bool;
+
+enum class Dir { N, E, S, W };
+typedef compact_optional<evp_enum<Dir, -1>> opt_dir;
+
+typedef compact_optional<evp_int_multi<int, -1, -2>> opt_multi;
+typedef compact_optional<opt_multi> opt_opt;
+
+// construction
+
+constexpr opt_int ci_, ci1 (1);
+static_assert (!ci_.has_value(), "");
+static_assert ( ci1.has_value(), "");
+static_assert ( ci1.value() == 1, "");
+static_assert ( ci_.unsafe_raw_value() == -1, "");
+
+constexpr opt_dir cd_, cdW (Dir::W);
+static_assert (!cd_.has_value(), "");
+static_assert ( cdW.value() == Dir::W, "");
+static_assert ( cdW.unsafe_raw_value() == 3, "");
+
+constexpr opt_bool cb_, cbT (true);
+static_assert (!cb_.has_value(), "");
+static_assert ( cbT.value() == true, "");
+
+constexpr opt_opt co_, co_i_ (opt_multi{}), co2 (opt_multi(2));
+static_assert (!co_.has_value(), "");
+static_assert ( co_i_.has_value() && !co_i_.value().has_value(), "");
+static_assert ( co2.value().value() == 2, "");
+
+// mutation inside constant expressions
+
+constexpr opt_int assigned(opt_int o, int v)
+{
+  o = opt_int(v);
+  return o;
+}
+
+constexpr opt_int reset(opt_int o)
+{
+  o.reset();
+  return o;
+}
+
+constexpr std::pair<opt_int, opt_int> swapped(opt_int l, opt_int r)
+{
+  swap(l, r);
+  return std::pair<opt_int, opt_int>(l, r);
+}
+
+constexpr opt_int emplaced(opt_int o, int v)
+{
+  o.emplace(v);
+  return o;
+}
+
+constexpr opt_dir rotated(opt_dir o)
+{
+  if (o.has_value())
+    o = opt_dir(Dir((int(o.value()) + 1) % 4));
+  return o;
+}
+
+static_assert (assigned(ci_, 7).value() == 7, "");
+static_assert (assigned(ci1, 7).value() == 7, "");
+static_assert (!reset(ci1).has_value(), "");
+static_assert (!reset(ci_).has_value(), "");
+static_assert ( swapped(ci_, ci1).first.value() == 1, "");
+static_assert (!swapped(ci_, ci1).second.has_value(), "");
+static_assert (emplaced(ci1, 5).value() == 5, "");
+static_assert (opt_int(in_place, 9).value() == 9, "");
+static_assert ( rotated(cdW).value() == Dir::N, "");
+static_assert (!rotated(cd_).has_value(), "");
+
+// value_or and transform
+
+static_assert (ci_.value_or(4) == 4, "");
+static_assert (ci1.value_or(4) == 1, "");
+static_assert (cd_.value_or(Dir::E) == Dir::E, "");
+static_assert (cdW.value_or(Dir::E) == Dir::W, "");
+static_assert (cb_.value_or(true) && cbT.value_or(false), "");
+
+struct next_dir
+{
+  constexpr Dir operator()(Dir d) const { return Dir((int(d) + 1) % 4); }
+};
+
+struct dir_code
+{
+  constexpr int operator()(Dir d) const { return int(d) * 10; }
+};
+
+static_assert ( cdW.transform(next_dir()).value() == Dir::N, "");
+static_assert (!cd_.transform(next_dir()).has_value(), "");
+static_assert ( cdW.transform<evp_int<int, -1>>(dir_code()).value() == 30, "");
+
+// tables
+
+// protocol field code -> optional field width; -1 for unassigned codes
+constexpr opt_int field_width(std::size_t code)
+{
+  return code % 3 == 0 ? opt_int() : opt_int(int(code * 8));
+}
+
+template <std::size_t... I>
+constexpr std::array<opt_int, sizeof...(I)> make_widths(std::index_sequence<I...>)
+{
+  return std::array<opt_int, sizeof...(I)>{{ field_width(I)... }};
+}
+
+constexpr std::array<opt_int, 16> widths = make_widths(std::make_index_sequence<16>());
+static_assert (!widths[0].has_value(), "");
+static_assert ( widths[1].value() == 8, "");
+static_assert ( widths[14].value() == 112, "");
+static_assert (!widths[15].has_value(), "");
+
+// enum -> optional enum translation
+constexpr std::array<opt_dir, 4> opposite {{ opt_dir(Dir::S), opt_dir(Dir::W), opt_dir(), opt_dir(Dir::E) }};
+static_assert (opposite[std::size_t(Dir::N)].value() == Dir::S, "");
+static_assert (!opposite[std::size_t(Dir::S)].has_value(), "");
+
+constexpr std::array<opt_bool, 3> flags {{ opt_bool(), opt_bool(false), opt_bool(true) }};
+static_assert (!flags[0].has_value() && !flags[1].value() && flags[2].value(), "");
+
+#if __cplusplus >= 201703L
+// C++17: std::array is mutable in constant expressions, and std::optional is a literal type
+
+template <std::size_t N>
+constexpr std::array<opt_int, N> make_squares()
+{
+  std::array<opt_int, N> a {};
+  for (std::size_t i = 0; i != N; ++i)
+    if (i % 2 == 0)
+      a[i] = opt_int(int(i * i));
+  a[N - 2].reset();
+  swap(a[0], a[1]);
+  return a;
+}
+
+constexpr std::array<opt_int, 64> squares = make_squares<64>();
+static_assert (!squares[0].has_value(), "");
+static_assert ( squares[1].value() == 0, "");
+static_assert ( squares[4].value() == 16, "");
+static_assert (!squares[5].has_value(), "");
+static_assert (!squares[62].has_value(), "");
+
+typedef compact_optional<evp_optional<std::optional<int>>> opt_std;
+constexpr opt_std cs_, cs3 (3);
+static_assert (!cs_.has_value(), "");
+static_assert ( cs3.value() == 3, "");
+#endif
+
+int main()
+{
+  // the tables are usable at run time too
+  int sum = 0;
+  for (const opt_int& w : widths)
+    if (w.has_value())
+      sum += w.value();
+  assert (sum == 8 * (1 + 2 + 4 + 5 + 7 + 8 + 10 + 11 + 13 + 14));
+  assert (opposite[1].value() == Dir::W);
+}
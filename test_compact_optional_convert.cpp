@@ -0,0 +1,142 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "compact_optional_convert.hpp"
+#include "test_input.hpp"
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+
+using namespace ak_toolbox;
+
+enum class colour { red, green, blue, none = 255 };
+typedef std::chrono::time_point<std::chrono::system_clock, std::chrono::milliseconds> sys_ms;
+
+// a policy without kernels: takes the loop over elements
+struct evp_short : compact_optional_type<short>
+{
+  static short empty_value() { return -1; }
+  static bool is_empty_value(short v) { return v == -1; }
+};
+
+// optional values built from random bits: about a third empty, and some holding the empty value
+template <typename T, typename Gen>
+std::vector< std::optional<T> > make_input(std::size_t n, Gen gen)
+{
+  std::vector< std::optional<T> > v (n);
+  test_input::xorshift64 rnd;
+  for (std::size_t i = 0; i != n; ++i)
+  {
+    const std::uint64_t x = rnd();
+    if (x % 3 != 0)
+      v[i] = gen(x >> 8);
+  }
+  return v;
+}
+
+template <typename T>
+bool same(const std::optional<T>& a, const std::optional<T>& b)
+{
+  if (a.has_value() != b.has_value())
+    return false;
+  return !a || *a == *b || (*a != *a && *b != *b); // NaN converts to NaN
+}
+
+// converts both ways, to separate buffers and in place, comparing with conversions of single elements
+template <typename EVP, typename Gen>
+void check_policy(Gen gen)
+{
+  typedef typename EVP::value_type T;
+  typedef compact_optional<EVP> opt_t;
+  const std::size_t sizes[] = { 0, 1, 2, 3, 15, 16, 17, 33, 100, 1001 };
+  for (std::size_t n : sizes)
+  {
+    const std::vector< std::optional<T> > in = make_input<T>(n, gen);
+    std::size_t expected_collision = n;
+    for (std::size_t i = 0; i != n; ++i)
+      if (in[i] && EVP::is_empty_value(EVP::store_value(*in[i])))
+      {
+        expected_collision = i;
+        break;
+      }
+
+    std::vector<opt_t> c (n);
+    const std::optional<T>* r = to_compact(in.data(), in.data() + n, c.data());
+    assert (std::size_t(r - in.data()) == expected_collision);
+    for (std::size_t i = 0; i != n; ++i)
+    {
+      const bool engaged = in[i] && !EVP::is_empty_value(EVP::store_value(*in[i]));
+      assert (c[i].has_value() == engaged);
+      if (engaged)
+        assert (same(std::optional<T>(c[i].value()), in[i]));
+    }
+
+    std::vector< std::optional<T> > back (n);
+    assert (from_compact(c.data(), c.data() + n, back.data()) == back.data() + n);
+    for (std::size_t i = 0; i != n; ++i)
+      assert (same(back[i], c[i].has_value() ? std::optional<T>(c[i].value()) : std::nullopt));
+
+    // in place, there and back again
+    std::vector< std::optional<T> > buf = in;
+    opt_t* cp = reinterpret_cast<opt_t*>(buf.data());
+    assert (to_compact(buf.data(), buf.data() + n, cp) == buf.data() + expected_collision);
+    for (std::size_t i = 0; i != n; ++i)
+      assert (cp[i].has_value() == c[i].has_value() && (!c[i].has_value() || same(std::optional<T>(cp[i].value()), std::optional<T>(c[i].value()))));
+    from_compact(cp, cp + n, buf.data());
+    for (std::size_t i = 0; i != n; ++i)
+      assert (same(buf[i], back[i]));
+  }
+}
+
+void test_policies()
+{
+  check_policy< evp_int<int, -1> >([](std::uint64_t x) { return int(x % 1000) - 1; }); // -1 is the collision
+  check_policy< evp_int<unsigned, 0> >([](std::uint64_t x) { return unsigned(x % 500); });
+  check_policy< evp_int<std::int64_t, INT64_MIN> >([](std::uint64_t x) {
+    return x % 97 == 0 ? INT64_MIN : std::int64_t(x); });
+  check_policy< evp_int<signed char, -128> >([](std::uint64_t x) { return static_cast<signed char>(x); });
+  check_policy< evp_int<char, 'x'> >([](std::uint64_t x) { return char('a' + x % 26); });
+  check_policy<evp_bool>([](std::uint64_t x) { return x % 2 == 0; });
+  check_policy< evp_enum<colour, 255> >([](std::uint64_t x) { return x % 50 == 0 ? colour::none : colour(x % 3); });
+  check_policy< evp_fp_nan<float> >([](std::uint64_t x) {
+    return x % 61 == 0 ? std::numeric_limits<float>::quiet_NaN() : float(x % 1000) / 8; });
+  check_policy< evp_fp_nan<double> >([](std::uint64_t x) {
+    return x % 61 == 0 ? -std::numeric_limits<double>::quiet_NaN() : double(x % 1000) / 8; });
+  check_policy< evp_duration<std::chrono::milliseconds> >([](std::uint64_t x) {
+    return x % 40 == 0 ? std::chrono::milliseconds::min() : std::chrono::milliseconds(x % 100000); });
+  check_policy< evp_time_point<sys_ms> >([](std::uint64_t x) { return sys_ms(std::chrono::milliseconds(x >> 20)); });
+  check_policy<evp_short>([](std::uint64_t x) { return short(x % 300) - 1; });
+}
+
+void test_collision()
+{
+  // the first collision is reported; it and the later values are still converted
+  std::vector< std::optional<int> > in (41, 7);
+  in[3] = std::nullopt;
+  in[21] = -1;
+  in[30] = -1;
+  in[40] = -1;
+  std::vector< compact_optional< evp_int<int, -1> > > c (in.size());
+  assert (to_compact(in.data(), in.data() + in.size(), c.data()) == &in[21]);
+  assert (!c[3].has_value());
+  assert (!c[21].has_value());
+  assert (!c[40].has_value());
+  assert (c[39].value() == 7);
+
+  in[21] = in[30] = 5;
+  assert (to_compact(in.data(), in.data() + in.size(), c.data()) == &in[40]); // in the scalar tail
+  in[40] = 5;
+  assert (to_compact(in.data(), in.data() + in.size(), c.data()) == in.data() + in.size());
+}
+
+int main()
+{
+  test_policies();
+  test_collision();
+}
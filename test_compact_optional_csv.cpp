@@ -0,0 +1,263 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "compact_optional_csv.hpp"
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace ak_toolbox;
+
+enum class Dir { N, E, S, W };
+enum class Small : signed char { lo = -128, hi = 127 };
+
+// evp_enum needs int-sized enums under AK_TOOLBOX_NO_UNDERLYING_TYPE
+struct evp_small : compact_optional_type<Small, signed char, Small>
+{
+  static signed char empty_value() { return 0; }
+  static bool is_empty_value(signed char v) { return v == 0; }
+  static Small access_value(signed char v) { return static_cast<Small>(v); }
+  static signed char store_value(Small v) { return static_cast<signed char>(v); }
+};
+
+typedef evp_int<int, -1> evp_id;
+typedef evp_fp_nan<double> evp_price;
+typedef evp_int<std::int64_t, LLONG_MIN> evp_volume;
+typedef evp_stl_empty<std::string> evp_name;
+
+typedef compact_optional<evp_id> opt_id;
+typedef compact_optional<evp_price> opt_price;
+typedef compact_optional<evp_volume> opt_volume;
+typedef compact_optional<evp_name> opt_name;
+
+const char sample[] =
+  "id,price,volume,name\r\n"
+  "1,10.5,100,abc\r\n"
+  "2,,NULL,\n"
+  "\n"
+  "NULL,-0.25,-9223372036854775807,x y\n"
+  "4,1e300,9223372036854775807,NULL"; // no line break at the end
+
+struct table
+{
+  std::vector<opt_id> id;
+  std::vector<opt_price> price;
+  std::vector<opt_volume> volume;
+  std::vector<opt_name> name;
+
+  explicit table(std::size_t n) : id(n), price(n), volume(n), name(n) {}
+};
+
+typedef csv_column_reader<evp_id, evp_price, evp_volume, evp_name> reader_t;
+
+csv_options with_header()
+{
+  csv_options o;
+  o.header = true;
+  return o;
+}
+
+void check_sample(const table& t, std::size_t rows)
+{
+  assert (rows == 4);
+  assert (t.id[0].value() == 1 && t.price[0].value() == 10.5 && t.volume[0].value() == 100 && t.name[0].value() == "abc");
+  assert (t.id[1].value() == 2 && !t.price[1].has_value() && !t.volume[1].has_value() && !t.name[1].has_value());
+  assert (!t.id[2].has_value() && t.price[2].value() == -0.25);
+  assert (t.volume[2].value() == -LLONG_MAX && t.name[2].value() == "x y");
+  assert (t.id[3].value() == 4 && t.price[3].value() == 1e300 && t.volume[3].value() == LLONG_MAX);
+  assert (!t.name[3].has_value());
+}
+
+void test_chunks()
+{
+  const std::size_t len = std::strlen(sample);
+
+  {
+    table t (10);
+    reader_t r (with_header(), 10, t.id.data(), t.price.data(), t.volume.data(), t.name.data());
+    assert (r.feed(sample, len).ok());
+    assert (r.rows() == 3); // the last line waits for finish()
+    assert (r.finish().ok());
+    check_sample(t, r.rows());
+  }
+
+  // every split into chunks gives the same result
+  for (std::size_t chunk = 1; chunk <= len; ++chunk)
+  {
+    table t (10);
+    reader_t r (with_header(), 10, t.id.data(), t.price.data(), t.volume.data(), t.name.data());
+    for (std::size_t i = 0; i < len; i += chunk)
+      assert (r.feed(sample + i, std::min(chunk, len - i)).ok());
+    assert (r.finish().ok());
+    check_sample(t, r.rows());
+  }
+}
+
+template <typename EVP>
+csv_status parse_one(const char* text, compact_optional<EVP>& out)
+{
+  csv_column_reader<EVP> r (1, &out);
+  r.feed(text, std::strlen(text));
+  return r.finish();
+}
+
+void test_fields()
+{
+  {
+    compact_optional< evp_int<short, -1> > o;
+    assert (parse_one("32767", o).ok() && o.value() == 32767);
+    assert (parse_one("-32768", o).ok() && o.value() == -32768);
+    assert (parse_one("+7", o).ok() && o.value() == 7);
+    assert (parse_one("32768", o).error == csv_bad_value);
+    assert (parse_one("-32769", o).error == csv_bad_value);
+    assert (parse_one("1x", o).error == csv_bad_value);
+    assert (parse_one("-", o).error == csv_bad_value);
+    assert (parse_one(" 1", o).error == csv_bad_value);
+  }
+  {
+    compact_optional< evp_int<unsigned, 0> > o;
+    assert (parse_one("4294967295", o).ok() && o.value() == 4294967295u);
+    assert (parse_one("4294967296", o).error == csv_bad_value);
+    assert (parse_one("-1", o).error == csv_bad_value);
+  }
+  {
+    compact_optional< evp_fp_nan<float> > o;
+    assert (parse_one("1.5", o).ok() && o.value() == 1.5f);
+    assert (parse_one("+2", o).ok() && o.value() == 2.0f);
+    assert (parse_one("-inf", o).ok() && std::isinf(o.value()));
+    assert (parse_one("1.5.", o).error == csv_bad_value);
+    // the same syntax with and without from_chars
+    assert (parse_one(".5", o).ok() && o.value() == 0.5f);
+    assert (parse_one("1e3", o).ok() && o.value() == 1000.0f);
+    assert (parse_one("INF", o).ok() && std::isinf(o.value()));
+    assert (parse_one("nan(1)", o).error == csv_sentinel_collision);
+    assert (parse_one("0x1p3", o).error == csv_bad_value);
+    assert (parse_one(" 1", o).error == csv_bad_value);
+    assert (parse_one("1e", o).error == csv_bad_value);
+    assert (parse_one("1e40", o).error == csv_bad_value); // out of range for float
+  }
+  {
+    compact_optional< evp_fp_nan<double> > o;
+    assert (parse_one("1e300", o).ok() && o.value() == 1e300);
+    assert (parse_one("-1e400", o).error == csv_bad_value);
+  }
+  {
+    compact_optional<evp_bool> o;
+    assert (parse_one("true", o).ok() && o.value() == true);
+    assert (parse_one("0", o).ok() && o.value() == false);
+    assert (parse_one("yes", o).error == csv_bad_value);
+  }
+  {
+    compact_optional< evp_enum<Dir, -1> > o;
+    assert (parse_one("2", o).ok() && o.value() == Dir::S);
+  }
+  {
+    // read as the underlying type, so out-of-range values are errors
+    compact_optional<evp_small> o;
+    assert (parse_one("127", o).ok() && o.value() == Small::hi);
+    assert (parse_one("-128", o).ok() && o.value() == Small::lo);
+    assert (parse_one("257", o).error == csv_bad_value);
+    assert (parse_one("-129", o).error == csv_bad_value);
+  }
+}
+
+void test_errors()
+{
+  {
+    // a value equal to the sentinel is an error, not a missing value
+    compact_optional<evp_id> o;
+    csv_status s = parse_one("-1", o);
+    assert (s.error == csv_sentinel_collision && s.line == 1 && s.column == 0);
+
+    compact_optional<evp_price> p;
+    assert (parse_one("nan", p).error == csv_sentinel_collision);
+  }
+  {
+    const char text[] = "1,2\n3,4\n5,x\n7,8\n";
+    std::vector<opt_id> a (10), b (10);
+    csv_column_reader<evp_id, evp_id> r (10, a.data(), b.data());
+    csv_status s = r.feed(text, sizeof text - 1);
+    assert (s.error == csv_bad_value && s.line == 3 && s.column == 1);
+    assert (r.rows() == 2);
+    assert (r.feed("9,9\n", 4).error == csv_bad_value); // the error sticks
+    assert (r.finish().error == csv_bad_value);
+    assert (r.rows() == 2);
+  }
+  {
+    std::vector<opt_id> a (10), b (10);
+    csv_column_reader<evp_id, evp_id> r (10, a.data(), b.data());
+    csv_status s = r.feed("1,2\n3\n", 6);
+    assert (s.error == csv_too_few_fields && s.line == 2 && s.column == 1);
+  }
+  {
+    std::vector<opt_id> a (10), b (10);
+    csv_column_reader<evp_id, evp_id> r (10, a.data(), b.data());
+    csv_status s = r.feed("1,2,3\n", 6);
+    assert (s.error == csv_too_many_fields && s.line == 1 && s.column == 2);
+  }
+  {
+    std::vector<opt_id> a (2);
+    csv_column_reader<evp_id> r (2, a.data());
+    assert (r.feed("1\n2\n", 4).ok());
+    assert (r.feed("3\n", 2).error == csv_columns_full);
+    assert (r.rows() == 2);
+  }
+}
+
+void test_options()
+{
+  csv_options o;
+  o.delimiter = '\t';
+  o.null_token = "\\N";
+  std::vector<opt_id> a (4);
+  std::vector<opt_name> b (4);
+  csv_column_reader<evp_id, evp_name> r (o, 4, a.data(), b.data());
+  const char text[] = "1\tNULL\n\\N\ta,b\n";
+  assert (r.feed(text, sizeof text - 1).ok());
+  assert (r.rows() == 2);
+  assert (a[0].value() == 1 && b[0].value() == "NULL");
+  assert (!a[1].has_value() && b[1].value() == "a,b");
+}
+
+void test_file()
+{
+  char path[] = "/tmp/test_compact_optional_csvXXXXXX";
+  std::FILE* f = 0;
+#if defined AK_TOOLBOX_MAPPED_FILE_POSIX
+  int fd = mkstemp(path);
+  assert (fd >= 0);
+  f = fdopen(fd, "wb");
+#else
+  std::strcpy(path, "test_compact_optional_csv.tmp");
+  f = std::fopen(path, "wb");
+#endif
+  assert (f);
+  std::fwrite(sample, 1, std::strlen(sample), f);
+  std::fclose(f);
+
+  table t (10);
+  reader_t r (with_header(), 10, t.id.data(), t.price.data(), t.volume.data(), t.name.data());
+  assert (parse_csv_file(path, r).ok());
+  check_sample(t, r.rows());
+  std::remove(path);
+
+  reader_t r2 (10, t.id.data(), t.price.data(), t.volume.data(), t.name.data());
+  assert (parse_csv_file(path, r2).error == csv_file_error);
+}
+
+int main()
+{
+  test_chunks();
+  test_fields();
+  test_errors();
+  test_options();
+  test_file();
+}
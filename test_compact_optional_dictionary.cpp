@@ -0,0 +1,150 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "compact_optional_dictionary.hpp"
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace ak_toolbox;
+
+void test_dictionary()
+{
+  static_assert(sizeof(dictionary_id) == sizeof(std::uint32_t), "");
+
+  string_dictionary d (64);
+  assert (d.size() == 0);
+  assert (!d.find("a").has_value());
+
+  const string_dictionary::id_type a = d.intern("alpha");
+  const string_dictionary::id_type b = d.intern(std::string("beta"));
+  assert (a != b);
+  assert (d.intern("alpha") == a);
+  assert (d.size() == 2);
+  assert (d.find("beta").value() == b);
+  assert (!d.find("gamma").has_value());
+  assert (d[a] == "alpha");
+  assert (d[b] == "beta");
+
+  // the empty string and embedded nulls are ordinary strings
+  const string_dictionary::id_type e = d.intern("");
+  const string_dictionary::id_type z = d.intern(string_ref("\0\0", 2));
+  assert (e != z);
+  assert (d[e].size() == 0);
+  assert (d[z] == string_ref("\0\0", 2));
+
+  // strings over a quarter of a block get their own allocation
+  const std::string longer (100, 'x');
+  const string_dictionary::id_type l = d.intern(longer);
+  assert (std::string(d[l]) == longer);
+
+  // many strings: growing the index and spilling into new blocks keeps earlier views valid
+  const string_ref alpha = d[a];
+  std::vector<string_dictionary::id_type> ids;
+  for (int i = 0; i != 5000; ++i)
+    ids.push_back(d.intern(std::to_string(i)));
+  for (int i = 0; i != 5000; ++i)
+  {
+    assert (d.intern(std::to_string(i)) == ids[i]);
+    assert (std::string(d[ids[i]]) == std::to_string(i));
+  }
+  assert (alpha.data() == d[a].data());
+  assert (d.size() == 5005);
+
+  const std::size_t used = d.memory_usage();
+  d.reset();
+  assert (d.size() == 0);
+  assert (!d.find("alpha").has_value());
+  assert (d.intern("beta") == 0);
+  for (int i = 0; i != 5000; ++i)
+    d.intern(std::to_string(i));
+  assert (d.memory_usage() <= used); // the next batch reuses the blocks
+}
+
+void test_column()
+{
+  string_dictionary d;
+  dictionary_column c (d);
+  const char* words[] = { "red", "green", "red", "blue", "red" };
+  c.append(words, words + 5);
+  c.push_back_empty();
+  c.push_back(std::string("green"));
+  c.push_back(d.find("blue"));
+  assert (c.size() == 8);
+  assert (d.size() == 3);
+
+  assert (c[0].has_value());
+  assert (c[0].value() == "red");
+  assert (c[1].value() == "green");
+  assert (!c[5].has_value());
+  assert (!c.has_value(5));
+  assert (c.id(2).value() == c.id(0).value());
+  assert (c[7].value() == "blue");
+
+  assert (c.count_equal("red") == 3);
+  assert (c.count_equal("green") == 2);
+  assert (c.count_equal("purple") == 0);
+  assert (c.count_equal(dictionary_id()) == 0); // empty elements never match
+
+  std::vector<std::size_t> reds;
+  c.for_each_equal("red", [&](std::size_t i) { reds.push_back(i); });
+  assert (reds == std::vector<std::size_t>({ 0, 2, 4 }));
+
+  std::uint64_t mask = ~std::uint64_t(0);
+  c.mask_equal("green", &mask);
+  assert (mask == ((1u << 1) | (1u << 6)));
+  c.mask_equal("purple", &mask);
+  assert (mask == 0);
+
+  assert (c.memory_usage() == c.ids().capacity() * sizeof(std::uint32_t));
+  assert (c.memory_usage() >= 8 * sizeof(std::uint32_t));
+}
+
+void test_long_column()
+{
+  // crosses mask word boundaries
+  string_dictionary d;
+  dictionary_column c (d);
+  const std::size_t n = 1000;
+  for (std::size_t i = 0; i != n; ++i)
+  {
+    if (i % 7 == 0)
+      c.push_back_empty();
+    else
+      c.push_back(i % 3 == 0 ? "fizz" : "other");
+  }
+
+  std::size_t expected = 0;
+  for (std::size_t i = 0; i != n; ++i)
+    expected += i % 7 != 0 && i % 3 == 0;
+  assert (c.count_equal("fizz") == expected);
+
+  std::vector<std::uint64_t> mask ((n + 63) / 64);
+  c.mask_equal("fizz", mask.data());
+  for (std::size_t i = 0; i != n; ++i)
+    assert (((mask[i / 64] >> (i % 64)) & 1) == (i % 7 != 0 && i % 3 == 0));
+
+  // a shared dictionary: ids mean the same in every column
+  dictionary_column c2 (d);
+  c2.push_back("fizz");
+  assert (c2.id(0).value() == c.id(3).value());
+
+  // batch lifetime: reset the dictionary and the columns together
+  d.reset();
+  c.clear();
+  c2.clear();
+  c.push_back("next");
+  assert (c.count_equal("fizz") == 0);
+  assert (c[0].value() == "next");
+}
+
+int main()
+{
+  test_dictionary();
+  test_column();
+  test_long_column();
+}
@@ -0,0 +1,161 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "compact_optional_ordering.hpp"
+#include "test_input.hpp"
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+using namespace ak_toolbox;
+namespace detail_ = ak_toolbox::compact_optional_ns::detail_;
+
+enum class Dir { N, E, S, W };
+enum class Flags : unsigned { none = 0, all = 0xFFFFFFFF };
+enum Small : unsigned char { tiny = 0, huge = 255 };
+
+template <typename EVP, bool EmptyFirst>
+detail_::raw_order_kind kind()
+{
+  return detail_::raw_order<EVP, EmptyFirst>::value;
+}
+
+void test_order_selection()
+{
+  assert ((kind<evp_int<int, INT_MIN>, true>() == detail_::by_raw_value));
+  assert ((kind<evp_int<int, INT_MIN>, false>() == detail_::by_sentinel));
+  assert ((kind<evp_int<int, INT_MAX>, false>() == detail_::by_raw_value));
+  assert ((kind<evp_int<unsigned, 0>, true>() == detail_::by_raw_value));
+  assert ((kind<evp_int<int, -1>, true>() == detail_::by_sentinel));
+  assert ((kind<evp_bool, false>() == detail_::by_sentinel));
+  assert ((kind<evp_enum<Dir, INT_MIN>, true>() == detail_::by_raw_value));
+#ifdef AK_TOOLBOX_NO_UNDERLYING_TYPE
+  // stored as int: unsigned values above INT_MAX would not keep their order
+  assert ((kind<evp_enum<Flags, 0>, true>() == detail_::by_value));
+#else
+  assert ((kind<evp_enum<Flags, 0>, true>() == detail_::by_raw_value));
+#endif
+  static_assert(!detail_::enum_is_unsigned<Dir>::value, "");
+  static_assert(detail_::enum_is_unsigned<Flags>::value, "");
+  static_assert(std::is_same<detail_::enum_integer<Flags>::type, std::uint32_t>::value, "");
+  static_assert(sizeof(detail_::enum_integer<Small>::type) == 1, "");
+  assert ((kind<evp_fp_nan<double>, true>() == detail_::by_value));
+  assert ((kind<evp_stl_empty<std::string>, true>() == detail_::by_value));
+}
+
+// the obvious, branching orderings, as the reference
+template <typename O>
+bool reference_less(const O& l, const O& r, bool empty_first)
+{
+  if (l.has_value() != r.has_value())
+    return empty_first ? r.has_value() : l.has_value();
+  return l.has_value() && l.value() < r.value();
+}
+
+template <typename O>
+bool same_sequence(const std::vector<O>& a, const std::vector<O>& b)
+{
+  empty_equal_to eq;
+  return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), eq);
+}
+
+template <typename EVP, typename Gen>
+void check_orderings(Gen gen)
+{
+  typedef compact_optional<EVP> opt_t;
+  std::vector<opt_t> v = test_input::make_input<EVP>(1000, gen, 5);
+
+  for (int empty_first = 0; empty_first != 2; ++empty_first)
+  {
+    std::vector<opt_t> expected = v, actual = v;
+    std::stable_sort(expected.begin(), expected.end(),
+                     [&](const opt_t& l, const opt_t& r) { return reference_less(l, r, empty_first != 0); });
+    if (empty_first)
+      std::stable_sort(actual.begin(), actual.end(), empty_first_less());
+    else
+      std::stable_sort(actual.begin(), actual.end(), empty_last_less());
+    assert (same_sequence(actual, expected));
+
+    // irreflexive, and consistent with the reference on every pair of a sample
+    for (std::size_t i = 0; i != 50; ++i)
+      for (std::size_t j = 0; j != 50; ++j)
+      {
+        bool l = empty_first ? empty_first_less()(v[i], v[j]) : empty_last_less()(v[i], v[j]);
+        assert (l == reference_less(v[i], v[j], empty_first != 0));
+      }
+  }
+}
+
+void test_orderings()
+{
+  check_orderings< evp_int<int, INT_MIN> >([](std::uint64_t x) { return int(x % 2001) - 1000; });
+  check_orderings< evp_int<int, INT_MAX> >([](std::uint64_t x) { return int(x % 2001) - 1000; });
+  check_orderings< evp_int<int, -1> >([](std::uint64_t x) { return int(x % 2001) - 1000; });
+  check_orderings< evp_int<unsigned, 0> >([](std::uint64_t x) { return unsigned(x % 1000); });
+  check_orderings< evp_int<std::int64_t, LLONG_MIN> >([](std::uint64_t x) { return std::int64_t(x >> 1) - (1ll << 62); });
+  check_orderings< evp_bool >([](std::uint64_t x) { return (x & 2) != 0; });
+  check_orderings< evp_enum<Dir, -1> >([](std::uint64_t x) { return Dir(x % 4); });
+  check_orderings< evp_fp_nan<double> >([](std::uint64_t x) { return double(x % 1000) / 8 - 60; });
+  check_orderings< evp_stl_empty<std::string> >([](std::uint64_t x) { return std::to_string(x % 1000); });
+}
+
+double nan_with_payload(std::uint64_t payload)
+{
+  std::uint64_t bits = 0x7FF8000000000000ull | payload;
+  double d;
+  std::memcpy(&d, &bits, sizeof d);
+  return d;
+}
+
+void test_hash()
+{
+  {
+    typedef compact_optional<evp_int<int, -1>> opt_int;
+    std::hash<opt_int> h;
+    assert (h(opt_int(7)) == h(opt_int(7)));
+    assert (h(opt_int()) == h(opt_int(-1)));
+    assert (h(opt_int(7)) == std::hash<int>()(7)); // raw storage
+
+    std::unordered_set<opt_int, std::hash<opt_int>, empty_equal_to> s;
+    s.insert(opt_int(1));
+    s.insert(opt_int());
+    s.insert(opt_int(1));
+    s.insert(opt_int(-1));
+    assert (s.size() == 2);
+    assert (s.count(opt_int()) == 1);
+  }
+  {
+    // every NaN is the empty value: all of them are equal and hash alike
+    typedef compact_optional<evp_fp_nan<double>> opt_double;
+    opt_double n1 (nan_with_payload(1)), n2 (nan_with_payload(2)), z (0.0), mz (-0.0);
+    assert (!n1.has_value() && !n2.has_value());
+    assert (empty_equal_to()(n1, n2));
+    assert (std::hash<opt_double>()(n1) == std::hash<opt_double>()(n2));
+    assert (empty_equal_to()(z, mz));
+    assert (std::hash<opt_double>()(z) == std::hash<opt_double>()(mz));
+    assert (!empty_equal_to()(z, n1));
+  }
+  {
+    typedef compact_optional<evp_stl_empty<std::string>> opt_str;
+    std::unordered_set<opt_str, std::hash<opt_str>, empty_equal_to> s;
+    s.insert(opt_str(std::string("a")));
+    s.insert(opt_str());
+    s.insert(opt_str(std::string()));
+    assert (s.size() == 2);
+  }
+}
+
+int main()
+{
+  test_order_selection();
+  test_orderings();
+  test_hash();
+}
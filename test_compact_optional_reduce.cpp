@@ -0,0 +1,162 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "compact_optional_reduce.hpp"
+#include "compact_optional_ordering.hpp"
+#include "test_input.hpp"
+#include <cassert>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#if defined AK_TOOLBOX_STD_EXECUTION
+# include <execution>
+#endif
+
+using namespace ak_toolbox;
+using test_input::make_input;
+
+template <typename EVP>
+bool same_bits(const engaged_aggregate<EVP>& a, const engaged_aggregate<EVP>& b)
+{
+  return a.count == b.count && std::memcmp(&a.sum, &b.sum, sizeof a.sum) == 0
+      && empty_equal_to()(a.min, b.min) && empty_equal_to()(a.max, b.max);
+}
+
+template <typename EVP, typename Gen>
+void check_integral(Gen gen)
+{
+  typedef compact_optional<EVP> opt_t;
+  typedef typename engaged_aggregate<EVP>::sum_type sum_type;
+
+  for (std::size_t n : {0, 1, 7, 8, 9, 128, 129, 1000, 65536, 65537, 300000})
+  {
+    const std::vector<opt_t> v = make_input<EVP>(n, gen);
+
+    std::size_t count = 0;
+    sum_type sum = 0;
+    opt_t mn, mx;
+    for (std::size_t i = 0; i != n; ++i)
+      if (v[i].has_value())
+      {
+        ++count;
+        sum = sum_type(std::uint64_t(sum) + std::uint64_t(sum_type(v[i].value()))); // wraps
+        if (!mn.has_value() || v[i].value() < mn.value()) mn = v[i];
+        if (!mx.has_value() || mx.value() < v[i].value()) mx = v[i];
+      }
+
+    const engaged_aggregate<EVP> a = aggregate_engaged(v.data(), n, 1);
+    assert (a.count == count);
+    assert (a.sum == sum);
+    assert (empty_equal_to()(a.min, mn));
+    assert (empty_equal_to()(a.max, mx));
+    assert (count == 0 ? std::isnan(a.mean()) : a.mean() == double(sum) / double(count));
+
+    for (unsigned threads : {2u, 3u, 8u, 0u})
+      assert (same_bits(aggregate_engaged(v.data(), n, threads), a));
+
+    assert (sum_engaged(v.data(), n) == sum);
+    assert (empty_equal_to()(min_engaged(v.data(), n), mn));
+    assert (empty_equal_to()(max_engaged(v.data(), n), mx));
+  }
+}
+
+void test_integral()
+{
+  check_integral< evp_int<int, -1> >([](std::uint64_t x) { return int(x % 100000); });
+  check_integral< evp_int<int, INT_MIN> >([](std::uint64_t x) { return int(x >> 32); }); // negative values too
+  check_integral< evp_int<unsigned, 0> >([](std::uint64_t x) { return unsigned(x) | 1u; });
+  check_integral< evp_int<short, -1> >([](std::uint64_t x) { return short(x % 30000); });
+  check_integral< evp_int<std::int64_t, LLONG_MIN> >([](std::uint64_t x) { return std::int64_t(x >> 1) - (1ll << 62); });
+
+  {
+    // only empty objects
+    typedef compact_optional< evp_int<int, -1> > opt_int;
+    std::vector<opt_int> v (200000);
+    engaged_aggregate< evp_int<int, -1> > a = aggregate_engaged(v.data(), v.size());
+    assert (a.count == 0);
+    assert (a.sum == 0);
+    assert (!a.min.has_value());
+    assert (!a.max.has_value());
+    assert (std::isnan(a.mean()));
+  }
+}
+
+template <typename FPT>
+void check_floating_point()
+{
+  typedef evp_fp_nan<FPT> EVP;
+  typedef compact_optional<EVP> opt_t;
+
+  for (std::size_t n : {0, 1, 7, 129, 1000, 65537, 300000, 2100000}) // the last runs on two threads
+  {
+    const std::vector<opt_t> v = make_input<EVP>(n, [](std::uint64_t x) { return FPT(std::int64_t(x % 2000001) - 1000000) / 1000; });
+
+    std::size_t count = 0;
+    long double sum = 0;
+    opt_t mn, mx;
+    for (std::size_t i = 0; i != n; ++i)
+      if (v[i].has_value())
+      {
+        ++count;
+        sum += v[i].value();
+        if (!mn.has_value() || v[i].value() < mn.value()) mn = v[i];
+        if (!mx.has_value() || mx.value() < v[i].value()) mx = v[i];
+      }
+
+    const engaged_aggregate<EVP> a = aggregate_engaged(v.data(), n, 1);
+    assert (a.count == count);
+    assert (std::fabs(static_cast<long double>(a.sum) - sum) <= n * 1000 * std::numeric_limits<FPT>::epsilon() * 64);
+    assert (empty_equal_to()(a.min, mn));
+    assert (empty_equal_to()(a.max, mx));
+
+    // the order of additions does not depend on the number of threads
+    for (unsigned threads : {2u, 3u, 8u, 0u})
+      assert (same_bits(aggregate_engaged(v.data(), n, threads), a));
+
+#if defined AK_TOOLBOX_STD_EXECUTION
+    assert (same_bits(aggregate_engaged(std::execution::par, v.data(), n), a));
+    assert (same_bits(aggregate_engaged(std::execution::par_unseq, v.data(), n), a));
+    assert (same_bits(aggregate_engaged(std::execution::seq, v.data(), n), a));
+#endif
+  }
+
+  {
+    // infinities are values; NaNs are not
+    const FPT inf = std::numeric_limits<FPT>::infinity();
+    opt_t v[] = { opt_t(FPT(1)), opt_t(), opt_t(-inf), opt_t(FPT(2)) };
+    engaged_aggregate<EVP> a = aggregate_engaged(v, 4);
+    assert (a.count == 3);
+    assert (a.sum == -inf);
+    assert (a.min.value() == -inf);
+    assert (a.max.value() == FPT(2));
+  }
+}
+
+void test_floating_point()
+{
+  check_floating_point<double>();
+  check_floating_point<float>();
+
+  {
+    typedef compact_optional< auto_evp<double> > opt_double;
+    opt_double v[] = { opt_double(1.5), opt_double(), opt_double(-0.5) };
+    engaged_aggregate< auto_evp<double> > a = aggregate_engaged(v, 3);
+    assert (a.count == 2);
+    assert (a.sum == 1.0);
+    assert (a.mean() == 0.5);
+    assert (a.min.value() == -0.5);
+  }
+}
+
+int main()
+{
+  test_integral();
+  test_floating_point();
+}
@@ -0,0 +1,144 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "compact_optional_vector.hpp"
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+using namespace ak_toolbox;
+
+// fills a vector with an irregular engaged pattern, then checks every bulk
+// query against a naive element-by-element computation
+template <typename EVP, typename Gen>
+void check_bulk_queries(std::size_t n, Gen gen)
+{
+  compact_optional_vector<EVP> v;
+  std::vector<bool> expected;
+  for (std::size_t i = 0; i != n; ++i)
+  {
+    bool engaged = (i * 7 + i / 3) % 5 < 2;
+    if (engaged)
+      v.push_back(gen(i));
+    else
+      v.push_back_empty();
+    expected.push_back(engaged);
+  }
+  assert (v.size() == n);
+
+  std::size_t count = 0;
+  for (std::size_t i = 0; i != n; ++i)
+  {
+    assert (v.has_value(i) == expected[i]);
+    assert (v[i].has_value() == expected[i]);
+    if (expected[i])
+    {
+      assert (v[i].value() == gen(i));
+      ++count;
+    }
+  }
+  assert (v.count_engaged() == count);
+
+  std::size_t first = 0;
+  while (first != n && !expected[first]) ++first;
+  assert (v.find_engaged() == first);
+
+  std::vector<std::size_t> visited;
+  v.for_each_engaged([&](std::size_t i) { visited.push_back(i); });
+  assert (visited.size() == count);
+  for (std::size_t k = 0; k != visited.size(); ++k)
+  {
+    assert (expected[visited[k]]);
+    if (k + 1 != visited.size())
+      assert (v.find_engaged(visited[k] + 1) == visited[k + 1]);
+  }
+  if (!visited.empty())
+    assert (v.find_engaged(visited.back() + 1) == n);
+
+  std::vector<std::uint64_t> mask = v.validity_mask();
+  assert (mask.size() == (n + 63) / 64);
+  for (std::size_t i = 0; i != n; ++i)
+    assert (bool((mask[i / 64] >> (i % 64)) & 1u) == expected[i]);
+  if (n % 64 != 0)
+    assert ((mask.back() >> (n % 64)) == 0);
+}
+
+enum class Dir { N, E, S, W };
+
+struct evp_even : compact_optional_type<int> // user-defined policy: scalar path
+{
+  static int empty_value() { return 1; }
+  static bool is_empty_value(int v) { return v % 2 != 0; }
+};
+
+void test_bulk_queries()
+{
+  const std::size_t sizes[] = { 0, 1, 3, 15, 16, 31, 63, 64, 65, 130, 1000 };
+  for (std::size_t n : sizes)
+  {
+    check_bulk_queries< evp_int<int, -1> >(n, [](std::size_t i) { return int(i); });
+    check_bulk_queries< evp_int<std::int8_t, -1> >(n, [](std::size_t i) { return std::int8_t(i % 100); });
+    check_bulk_queries< evp_int<std::int16_t, -1> >(n, [](std::size_t i) { return std::int16_t(i); });
+    check_bulk_queries< evp_int<std::uint64_t, 0> >(n, [](std::size_t i) { return std::uint64_t(i) << 32 | 1u; });
+    check_bulk_queries< evp_fp_nan<float> >(n, [](std::size_t i) { return float(i) / 2; });
+    check_bulk_queries< evp_fp_nan<double> >(n, [](std::size_t i) { return double(i) / 2; });
+    check_bulk_queries< evp_enum<Dir, -1> >(n, [](std::size_t i) { return Dir(i % 4); });
+    check_bulk_queries< evp_bool >(n, [](std::size_t i) { return i % 3 == 0; });
+    check_bulk_queries< evp_even >(n, [](std::size_t i) { return int(i * 2); });
+  }
+}
+
+void test_sentinel_halves_are_not_confused()
+{
+  // 64-bit compare built from 32-bit lanes must require both halves to match
+  typedef evp_int<std::int64_t, -1> evp;
+  compact_optional_vector<evp> v;
+  v.push_back(std::int64_t(0xFFFFFFFF));
+  v.push_back(-std::int64_t(0x100000000));
+  v.push_back_empty();
+  v.push_back(std::int64_t(7));
+  assert (v.count_engaged() == 3);
+  assert (!v.has_value(2));
+}
+
+void test_element_access()
+{
+  typedef compact_optional_vector< evp_int<int, -1> > vec_t;
+  typedef vec_t::optional_type opt_int;
+
+  vec_t v (3);
+  assert (v.size() == 3);
+  assert (v.count_engaged() == 0);
+  assert (v.find_engaged() == 3);
+
+  v.set(1, 5);
+  v.set(2, opt_int{6});
+  assert (v.count_engaged() == 2);
+  assert (v.find_engaged() == 1);
+  assert (v[1].value() == 5);
+  assert (v[2].value() == 6);
+  assert (v.data()[0] == -1);
+
+  v.reset(1);
+  assert (!v[1].has_value());
+  assert (v.count_engaged() == 1);
+
+  v.resize(5);
+  assert (!v[4].has_value());
+  v.push_back(opt_int{});
+  assert (v.size() == 6);
+  assert (v.count_engaged() == 1);
+
+  v.clear();
+  assert (v.empty());
+}
+
+int main()
+{
+  test_bulk_queries();
+  test_sentinel_halves_are_not_confused();
+  test_element_access();
+}
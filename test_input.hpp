@@ -0,0 +1,41 @@
+// Copyright (C) 2015, Andrzej Krzemienski.
+//
+// Use, modification, and distribution is subject to the Boost Software
+// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Deterministic random input shared by the tests. The generator is the one
+// the benchmark programs use, so every test sees the same sequence.
+
+#ifndef AK_TOOLBOX_TEST_INPUT_HEADER_GUARD_
+#define AK_TOOLBOX_TEST_INPUT_HEADER_GUARD_
+
+#include "compact_optional.hpp"
+#include "benchmark.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace test_input {
+
+using bench::xorshift64;
+
+// n objects, each drawn from a random x: empty if x % empty_one_in == 0,
+// otherwise holding gen(x)
+template <typename EVP, typename Gen>
+std::vector< ak_toolbox::compact_optional<EVP> > make_input(std::size_t n, Gen gen, unsigned empty_one_in = 4)
+{
+  typedef ak_toolbox::compact_optional<EVP> opt_t;
+  std::vector<opt_t> v;
+  xorshift64 rnd;
+  for (std::size_t i = 0; i != n; ++i)
+  {
+    const std::uint64_t x = rnd();
+    v.push_back(x % empty_one_in == 0 ? opt_t() : opt_t(gen(x)));
+  }
+  return v;
+}
+
+} // namespace test_input
+
+#endif //AK_TOOLBOX_TEST_INPUT_HEADER_GUARD_